@@ -38,6 +38,7 @@
 AjaxServer::AjaxServer()
 {
 	_next_id = 1;
+	_bot_port = 0;
 	_socket.evt_connection_available.connect(sigc::mem_fun(*this,
 		&AjaxServer::connection_open));
 }
@@ -100,6 +101,25 @@ unsigned int AjaxServer::get_cheechd_port()
 }
 
 
+void AjaxServer::set_bot_host(Glib::ustring hostname, unsigned int port)
+{
+	_bot_hostname = hostname;
+	_bot_port = port;
+}
+
+
+Glib::ustring AjaxServer::get_bot_hostname()
+{
+	return _bot_hostname;
+}
+
+
+unsigned int AjaxServer::get_bot_port()
+{
+	return _bot_port;
+}
+
+
 AjaxServerConn* AjaxServer::get_client_by_id(unsigned int id)
 {
 	for (std::list<AjaxServerConn>::iterator i = _clients.begin();
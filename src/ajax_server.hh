@@ -43,6 +43,12 @@ public:
 	Glib::ustring get_cheechd_hostname();
 	unsigned int get_cheechd_port();
 
+	// Bots are hosted by a cheechbotd, rather than in this process, once
+	// its host is set
+	void set_bot_host(Glib::ustring hostname, unsigned int port);
+	Glib::ustring get_bot_hostname();
+	unsigned int get_bot_port();
+
 	void on_client_disconnect(AjaxServerConn *client);
 
 private:
@@ -63,6 +69,8 @@ private:
 
 	Glib::ustring						_cheechd_hostname;
 	unsigned int						_cheechd_port;
+	Glib::ustring						_bot_hostname;
+	unsigned int						_bot_port;
 	Gnet::Server						_socket;
 	std::list<AjaxServerConn>			_clients;
 	unsigned int						_next_id;
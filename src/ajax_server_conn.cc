@@ -20,14 +20,15 @@
  */
 
 #include <iostream>
-#include <sstream>
 //#include <sigc++/object.h>
 #include <sigc++/bind.h>
 #include <sigc++/bind_return.h>
 #include <glibmm.h>
 
 #include "ajax_server_conn.hh"
+#include "bot_base.hh"
 #include "utility.hh"
+#include "command_table.hh"
 #include "config.h"
 
 
@@ -40,7 +41,9 @@ AjaxServerConn::AjaxServerConn(GameClient *client,
 	:_game_client(client),
 	 _wait_conn(NULL),
 	 _id(id),
-	 _timeout_counter(0)
+	 _timeout_counter(0),
+	 _server_bots(false),
+	 _bot_host_conn(NULL)
 {
 }
 
@@ -160,7 +163,17 @@ void AjaxServerConn::on_disconnect()
 	_timeout.disconnect();
 	_disconnect.disconnect();
 
-	ajax_removebots();
+	ajax_removebots(StrView());
+
+	// Closing the control connection takes any bots left on cheechbotd
+	// out of the game too
+	if (_bot_host_conn)
+	{
+		// Cleared first, as deleting it closes it
+		Gnet::Conn *bot_host_conn = _bot_host_conn;
+		_bot_host_conn = NULL;
+		delete bot_host_conn;
+	}
 }
 
 
@@ -186,9 +199,8 @@ void AjaxServerConn::on_cmd_game_resync()
 
 void AjaxServerConn::send_board()
 {
-	// send the _game_client->get_board()'s holes
-	// use a stringstream (9=no hole)
-	std::ostringstream arg_stream(std::ostringstream::out);
+	// send the _game_client->get_board()'s holes (9=no hole)
+	std::string board = "board ";
 	for (unsigned int i = 0; i < GameBoard::SIZE; i++)
 	{
 		GameHole* hole = (*_game_client->get_board())[i];
@@ -201,9 +213,10 @@ void AjaxServerConn::send_board()
 		else
 			posn = 9;
 
-		arg_stream << util::to_str(posn) << " ";
+		util::append_uint(board, posn);
+		board += ' ';
 	}
-	send_cmd("board " + arg_stream.str());
+	send_cmd(board);
 
 	if (_game_client->is_spectator())
 		return;
@@ -270,11 +283,15 @@ void AjaxServerConn::on_cmd_game_turn(unsigned int posn,
 void AjaxServerConn::on_cmd_game_show_move(MoveList *move)
 {
 	// send the move to hilight
-	std::ostringstream arg_stream(std::ostringstream::out);
-	arg_stream << util::to_str(move->size()) << " ";
+	std::string args = "show ";
+	util::append_uint(args, move->size());
+	args += ' ';
 	for (unsigned int i = 0; i < move->size(); i++)
-		arg_stream << util::to_str((*move)[i]) << " ";
-	send_cmd("show " + arg_stream.str());
+	{
+		util::append_uint(args, (*move)[i]);
+		args += ' ';
+	}
+	send_cmd(args);
 }
 
 
@@ -310,81 +327,62 @@ void AjaxServerConn::on_cmd_choose_new_color(Glib::ustring name,
 void AjaxServerConn::on_cmd_game_make_move(MoveList *move)
 {
 	// send the move to make
-	std::ostringstream arg_stream(std::ostringstream::out);
-	arg_stream << util::to_str(move->size()) << " ";
+	std::string args = "move ";
+	util::append_uint(args, move->size());
+	args += ' ';
 	for (unsigned int i = 0; i < move->size(); i++)
-		arg_stream << util::to_str((*move)[i]) << " ";
-	send_cmd("move " + arg_stream.str());
+	{
+		util::append_uint(args, (*move)[i]);
+		args += ' ';
+	}
+	send_cmd(args);
 }
 
 
 void AjaxServerConn::handle_ajax_message(Glib::ustring message, Gnet::Conn *conn)
 {
-	Glib::ustring command;
-	Glib::ustring arguments;
-
-	int seperator = message.find_first_of(" ");
-
-	if (seperator < 0)
-		command = message;
-	else
-	{
-		command = message.substr(0, seperator);
-		arguments = message.substr(seperator+1, message.length()-seperator-1);
-
-	}
-	util::trim(command);
-	util::trim(arguments);
+	typedef void (AjaxServerConn::*Handler)(const StrView&);
+	typedef CommandTable<Handler> Commands;
+	static const Commands::Entry entries[] = {
+		{ "init", &AjaxServerConn::ajax_init },
+		{ "leave", &AjaxServerConn::ajax_leave },
+		{ "chat", &AjaxServerConn::ajax_chat },
+		{ "change_name", &AjaxServerConn::ajax_change_name },
+		{ "change_color", &AjaxServerConn::ajax_change_color },
+		{ "game_setup", &AjaxServerConn::ajax_game_setup },
+		{ "click", &AjaxServerConn::ajax_click },
+		{ "dblclick", &AjaxServerConn::ajax_dblclick },
+		{ "commit", &AjaxServerConn::ajax_commit },
+		{ "clear", &AjaxServerConn::ajax_clear },
+		{ "restart", &AjaxServerConn::ajax_restart },
+		{ "rotate", &AjaxServerConn::ajax_rotate },
+		{ "shuffle", &AjaxServerConn::ajax_shuffle },
+		{ "addbot", &AjaxServerConn::ajax_addbot },
+		{ "removebots", &AjaxServerConn::ajax_removebots },
+		{ "undo", &AjaxServerConn::ajax_undo },
+		{ "redo", &AjaxServerConn::ajax_redo }
+	};
+	static const Commands commands(entries);
+
+	StrView command, arguments;
+	StrView(message.raw()).split(' ', &command, &arguments);
+	command = command.trim();
+	arguments = arguments.trim();
 
 	close_conn();
 	_wait_conn = conn;
 
 	_timeout_counter = 0;
 
-	if (command == "init")
-		ajax_init(arguments);
-	else if (command == "leave")
-	{
-		ajax_leave();
-		close_conn();
-		return;
-	}
-	else if (command == "chat")
-		ajax_chat(arguments);
-	else if (command == "change_name")
-		ajax_change_name(arguments);
-	else if (command == "change_color")
-		ajax_change_color(arguments);
-	else if (command == "game_setup")
-		ajax_game_setup(arguments);
-	else if (command == "click")
-		ajax_click(arguments);
-	else if (command == "dblclick")
-		ajax_dblclick(arguments);
-	else if (command == "commit")
-		ajax_commit(arguments);
-	else if (command == "clear")
-		ajax_clear(arguments);
-	else if (command == "restart")
-		ajax_restart();
-	else if (command == "rotate")
-		ajax_rotate();
-	else if (command == "shuffle")
-		ajax_shuffle();
-	else if (command == "addbot")
-		ajax_addbot(arguments);
-	else if (command == "removebots")
-		ajax_removebots();
-	else if (command == "undo")
-		ajax_undo();
-	else if (command == "redo")
-		ajax_redo();
+	Handler handler = commands.find(command);
+	if (handler)
+		(this->*handler)(arguments);
 
 	ajax_push_one_msg_to_client();
 }
 
 
-void AjaxServerConn::ajax_init(Glib::ustring arguments)
+void AjaxServerConn::ajax_init(const StrView& arguments)
 {
 	_game_client = new GameClient();
 
@@ -426,12 +424,17 @@ void AjaxServerConn::ajax_init(Glib::ustring arguments)
 		sigc::mem_fun(*this, &AjaxServerConn::ping_client),
 		HEARTBEAT_TIME * 1000);
 
-	if (arguments.size() < 5)
-		arguments = "1 1 Nameless";
-
-	unsigned int color = util::from_str<unsigned int>(arguments.substr(0,1));
-	bool spectator = (bool)util::from_str<unsigned int>(arguments.substr(2,1));
-	Glib::ustring name = arguments.substr(4);
+	// "color spectator name", or a nameless spectator if it's not that
+	StrView rest = arguments;
+	unsigned int color, watching;
+	if (!rest.take_uint(&color) || !rest.take_uint(&watching) ||
+		rest.empty())
+	{
+		color = watching = 1;
+		rest = StrView("Nameless");
+	}
+	bool spectator = (watching != 0);
+	Glib::ustring name = util::to_text(rest);
 
 	_game_client->change_name(name);
 	_game_client->change_color(color);
@@ -443,44 +446,54 @@ void AjaxServerConn::ajax_init(Glib::ustring arguments)
 }
 
 
-void AjaxServerConn::ajax_leave()
+// Nothing's sent back, not even what's waiting
+void AjaxServerConn::ajax_leave(const StrView& arguments)
 {
 	_game_client->leave_game();
+	close_conn();
 }
 
 
-void AjaxServerConn::ajax_chat(Glib::ustring arguments)
+void AjaxServerConn::ajax_chat(const StrView& arguments)
 {
-	_game_client->chat(arguments);
+	_game_client->chat(util::to_text(arguments));
 }
 
 
-void AjaxServerConn::ajax_change_name(Glib::ustring arguments)
+void AjaxServerConn::ajax_change_name(const StrView& arguments)
 {
-	_game_client->change_name(arguments);
+	_game_client->change_name(util::to_text(arguments));
 }
 
 
-void AjaxServerConn::ajax_change_color(Glib::ustring arguments)
+void AjaxServerConn::ajax_change_color(const StrView& arguments)
 {
-	_game_client->change_color(util::from_str<unsigned int>(arguments));
+	unsigned int color;
+
+	if (arguments.to_uint(&color))
+		_game_client->change_color(color);
 }
 
 
-void AjaxServerConn::ajax_game_setup(Glib::ustring arguments)
+void AjaxServerConn::ajax_game_setup(const StrView& arguments)
 {
-	unsigned int num = util::from_str<unsigned int>(arguments);
-	unsigned int longs = util::from_str<unsigned int>(arguments.substr(2,1));
-	unsigned int hops = util::from_str<unsigned int>(arguments.substr(4,1));
-	unsigned int stops = util::from_str<unsigned int>(arguments.substr(6,1));
+	StrView rest = arguments;
+	unsigned int num, longs, hops, stops;
+
+	if (!rest.take_uint(&num) || !rest.take_uint(&longs) ||
+		!rest.take_uint(&hops) || !rest.take_uint(&stops))
+		return;
 
 	_game_client->reconfigure_game(num, longs, hops, stops);
 }
 
 
-void AjaxServerConn::ajax_click(Glib::ustring arguments)
+void AjaxServerConn::ajax_click(const StrView& arguments)
 {
-	unsigned int i = util::from_str<unsigned int>(arguments);
+	unsigned int i;
+
+	if (!arguments.to_uint(&i) || i >= GameBoard::SIZE)
+		return;
 
 	if (!move_list_contains(i))
 	{
@@ -516,18 +529,21 @@ void AjaxServerConn::ajax_click(Glib::ustring arguments)
 }
 
 
-void AjaxServerConn::ajax_dblclick(Glib::ustring arguments)
+void AjaxServerConn::ajax_dblclick(const StrView& arguments)
 {
-	unsigned int i = util::from_str<unsigned int>(arguments);
+	unsigned int i;
+
+	if (!arguments.to_uint(&i) || i >= GameBoard::SIZE)
+		return;
 
 	if (_move_list.back() != i)
 		_move_list.push_back(i);
 
-	ajax_commit("");
+	ajax_commit(StrView());
 }
 
 
-void AjaxServerConn::ajax_commit(Glib::ustring arguments)
+void AjaxServerConn::ajax_commit(const StrView& arguments)
 {
 	if (_move_list.size() > 1)
 		_game_client->make_move(&_move_list);
@@ -535,110 +551,142 @@ void AjaxServerConn::ajax_commit(Glib::ustring arguments)
 }
 
 
-void AjaxServerConn::ajax_clear(Glib::ustring arguments)
+void AjaxServerConn::ajax_clear(const StrView& arguments)
 {
 	_move_list.clear();
 	_game_client->hide_move();
 }
 
 
-void AjaxServerConn::ajax_restart()
+void AjaxServerConn::ajax_restart(const StrView& arguments)
 {
 	if (_game_client)
 	{
-		if (_game_client->is_spectator())
-		{
-			if (_bots.size() > 0 && _bots[0]->get_game_client())
-				_bots[0]->get_game_client()->restart_game();
-		}
-		else
-		{
+		if (!_game_client->is_spectator())
 			_game_client->restart_game();
-		}
 	}
 }
 
 
-void AjaxServerConn::ajax_rotate()
+void AjaxServerConn::ajax_rotate(const StrView& arguments)
 {
 	if (_game_client)
 	{
-		if (_game_client->is_spectator())
-		{
-			if (_bots.size() > 0 && _bots[0]->get_game_client())
-				_bots[0]->get_game_client()->rotate_players();
-		}
-		else
-		{
+		if (!_game_client->is_spectator())
 			_game_client->rotate_players();
-		}
 	}
 }
 
 
-void AjaxServerConn::ajax_shuffle()
+void AjaxServerConn::ajax_shuffle(const StrView& arguments)
 {
 	if (_game_client)
 	{
-		if (_game_client->is_spectator())
-		{
-			if (_bots.size() > 0 && _bots[0]->get_game_client())
-				_bots[0]->get_game_client()->shuffle_players();
-		}
-		else
-		{
+		if (!_game_client->is_spectator())
 			_game_client->shuffle_players();
-		}
 	}
 }
 
 
-void AjaxServerConn::ajax_addbot(Glib::ustring arguments)
+void AjaxServerConn::ajax_addbot(const StrView& arguments)
 {
-	BotBase *bot = BotBase::new_bot_of_type(arguments);
+	// The type goes on into a command line, so only one a bot can be
+	// made from is passed on, and then only as its short type
+	BotBase *bot = BotBase::new_bot_of_type(arguments.empty() ? "l3" :
+											util::to_text(arguments));
 	if (!bot)
-		bot = BotBase::new_bot_of_type("l3");
-	_bots.push_back(bot);
-	bot->join_game(_ajax_server->get_cheechd_hostname(),
-				   _ajax_server->get_cheechd_port());
-	bot->evt_disconnected.connect(sigc::bind(sigc::mem_fun(*this,
-		&AjaxServerConn::bot_disconnected), bot));
-}
+		return;
 
+	Glib::ustring bot_type = bot->get_type();
+	delete bot;
 
-void AjaxServerConn::ajax_removebots()
-{
-	BotBase *bot;
+	if (_ajax_server->get_bot_port())
+	{
+		send_bot_host("addbot " + bot_type + " " +
+					  _ajax_server->get_cheechd_hostname() + " " +
+					  util::to_str(_ajax_server->get_cheechd_port()));
+		return;
+	}
 
-	while (_bots.size() > 0)
+	// The server only takes bots from players
+	if (_game_client && !_game_client->is_spectator())
 	{
-		bot = _bots.back();
-		_bots.pop_back();
-		bot->leave_game();
+		_game_client->add_bot(bot_type);
+		_server_bots = true;
 	}
 }
 
 
-void AjaxServerConn::ajax_undo()
+void AjaxServerConn::ajax_removebots(const StrView& arguments)
+{
+	if (_bot_host_conn)
+		send_bot_host("removebots");
+
+	// The server takes out our bots itself once we've gone
+	if (_game_client && _server_bots)
+		_game_client->remove_bots();
+	_server_bots = false;
+}
+
+
+void AjaxServerConn::ajax_undo(const StrView& arguments)
 {
 	_game_client->undo_move();
 }
 
 
-void AjaxServerConn::ajax_redo()
+void AjaxServerConn::ajax_redo(const StrView& arguments)
 {
 	_game_client->redo_move();
 }
 
 
-void AjaxServerConn::bot_disconnected(BotBase *bot)
+// Commands wait until the connection to cheechbotd is up
+void AjaxServerConn::send_bot_host(Glib::ustring command)
+{
+	_bot_host_cmds.push(command);
+
+	if (!_bot_host_conn)
+	{
+		_bot_host_conn = new Gnet::ConnBuffered;
+		_bot_host_conn->evt_connected.connect(sigc::mem_fun(*this,
+			&AjaxServerConn::on_bot_host_connect));
+		// An error always ends in one of these, once it's closed
+		_bot_host_conn->evt_closed.connect(sigc::mem_fun(*this,
+			&AjaxServerConn::on_bot_host_closed));
+		_bot_host_conn->evt_cancelled.connect(sigc::mem_fun(*this,
+			&AjaxServerConn::on_bot_host_closed));
+		_bot_host_conn->connect(_ajax_server->get_bot_hostname(),
+								_ajax_server->get_bot_port());
+	}
+	else if (_bot_host_conn->get_status() == Gnet::Conn::statConnected)
+		on_bot_host_connect();
+}
+
+
+void AjaxServerConn::on_bot_host_connect()
 {
-	for (std::vector<BotBase*>::iterator b = _bots.begin();
-		b < _bots.end(); b++)
-			if (*b == bot)
-				_bots.erase(b);
+	while (!_bot_host_cmds.empty())
+	{
+		(*_bot_host_conn) << _bot_host_cmds.front() + "\n";
+		_bot_host_cmds.pop();
+	}
+}
+
+
+// The connection failed or cheechbotd went away, taking our bots with
+// it, so the next command starts a new connection
+void AjaxServerConn::on_bot_host_closed()
+{
+	if (!_bot_host_conn)
+		return;
+
+	Gnet::Conn *bot_host_conn = _bot_host_conn;
+	_bot_host_conn = NULL;
+	delete bot_host_conn;
 
-	// delete bot;
+	while (!_bot_host_cmds.empty())
+		_bot_host_cmds.pop();
 }
 
 
@@ -25,10 +25,10 @@
 #include <queue>
 #include <sigc++/sigc++.h>
 
+#include "str_view.hh"
 #include "ajax_server.hh"
 #include "game_client.hh"
 #include "gnet_conn.hh"
-#include "bot_base.hh"
 
 class AjaxServer;
 
@@ -70,25 +70,27 @@ public:
 
 	// Handle messages from Ajax Frontend to GameClient
 	void handle_ajax_message(Glib::ustring message, Gnet::Conn *conn);
-	void ajax_init(Glib::ustring arguments);
-	void ajax_leave();
-	void ajax_chat(Glib::ustring arguments);
-	void ajax_change_name(Glib::ustring arguments);
-	void ajax_change_color(Glib::ustring arguments);
-	void ajax_game_setup(Glib::ustring arguments);
-	void ajax_click(Glib::ustring arguments);
-	void ajax_dblclick(Glib::ustring arguments);
-	void ajax_commit(Glib::ustring arguments);
-	void ajax_clear(Glib::ustring arguments);
-	void ajax_restart();
-	void ajax_rotate();
-	void ajax_shuffle();
-	void ajax_addbot(Glib::ustring arguments);
-	void ajax_removebots();
-	void ajax_undo();
-	void ajax_redo();
+	void ajax_init(const StrView& arguments);
+	void ajax_leave(const StrView& arguments);
+	void ajax_chat(const StrView& arguments);
+	void ajax_change_name(const StrView& arguments);
+	void ajax_change_color(const StrView& arguments);
+	void ajax_game_setup(const StrView& arguments);
+	void ajax_click(const StrView& arguments);
+	void ajax_dblclick(const StrView& arguments);
+	void ajax_commit(const StrView& arguments);
+	void ajax_clear(const StrView& arguments);
+	void ajax_restart(const StrView& arguments);
+	void ajax_rotate(const StrView& arguments);
+	void ajax_shuffle(const StrView& arguments);
+	void ajax_addbot(const StrView& arguments);
+	void ajax_removebots(const StrView& arguments);
+	void ajax_undo(const StrView& arguments);
+	void ajax_redo(const StrView& arguments);
 
-	void bot_disconnected(BotBase *bot);
+	void send_bot_host(Glib::ustring command);
+	void on_bot_host_connect();
+	void on_bot_host_closed();
 	bool move_list_contains(unsigned int i);
 
 
@@ -102,7 +104,9 @@ private:
 	sigc::connection			_disconnect;
 	unsigned int				_timeout_counter;
 	std::queue<Glib::ustring>	_pending_cmds;
-	std::vector<BotBase*>		_bots;
+	bool						_server_bots;
+	Gnet::Conn					*_bot_host_conn;
+	std::queue<Glib::ustring>	_bot_host_cmds;
 	MoveList					_move_list;
 };
 
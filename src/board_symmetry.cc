@@ -0,0 +1,207 @@
+/*
+ *  Rotations and reflections of the board, used to map positions to a
+ *  canonical form so that symmetric positions can share table entries.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include <math.h>
+
+#include "board_symmetry.hh"
+#include "utility.hh"
+
+
+unsigned int BoardSymmetry::_holes[NUM_SYMMETRIES][GameBoard::SIZE];
+unsigned int BoardSymmetry::_players[NUM_SYMMETRIES][7][7];
+unsigned int BoardSymmetry::_inverse[NUM_SYMMETRIES];
+bool BoardSymmetry::_tables_ready = BoardSymmetry::init_tables();
+
+
+// Works out where every hole goes under each symmetry from the hole
+// locations, and from that which corner (and so which player) goes where.
+bool BoardSymmetry::init_tables()
+{
+	const unsigned int SIZE_X = GameBoard::SIZE_X;
+	const double row_height = sqrt(3.0) / 2.0;
+
+	// The center hole
+	const double cx = 6.0;
+	const double cy = 9.0 * row_height;
+
+	for (unsigned int sym = 0; sym < NUM_SYMMETRIES; sym++)
+	{
+		double angle = (sym % 6) * M_PI / 3.0;
+		double mirror = (sym < 6) ? 1.0 : -1.0;
+
+		for (unsigned int i = 0; i < GameBoard::SIZE; i++)
+		{
+			_holes[sym][i] = i;
+			if (GameBoard::BOARD_MAP[i] < 0)
+				continue;
+
+			unsigned int row = i / SIZE_X;
+			double dx = mirror * ((i % SIZE_X) +
+				(util::even(row) ? 0.5 : 0.0) - cx);
+			double dy = row * row_height - cy;
+
+			double y = cy + dx * sin(angle) + dy * cos(angle);
+			int new_row = (int)floor(y / row_height + 0.5);
+			double x = cx + dx * cos(angle) - dy * sin(angle) -
+				(util::even(new_row) ? 0.5 : 0.0);
+
+			_holes[sym][i] = new_row * SIZE_X + (int)floor(x + 0.5);
+		}
+
+		for (unsigned int n = 0; n <= 6; n++)
+			for (unsigned int p = 0; p <= 6; p++)
+				_players[sym][n][p] = 0;
+
+		// A player's goal point lies in the triangle whose end corner is
+		// their starting corner, so it shows where that corner goes.
+		for (unsigned int n = 1; n <= 6; n++)
+		{
+			int shift = -1;
+
+			for (unsigned int corner = 1; corner <= 6; corner++)
+			{
+				unsigned int player = GameBoard::START_MAP[n][corner];
+				if (!player)
+					continue;
+
+				unsigned int new_corner = GameBoard::BOARD_MAP[
+					_holes[sym][GameBoard::GOAL_MAP[corner]]] / 10;
+				unsigned int new_player = GameBoard::START_MAP[n][new_corner];
+
+				// Only keep symmetries that rotate the order of play
+				int this_shift = (new_player + n - player) % n;
+				if (!new_player || (shift >= 0 && this_shift != shift))
+				{
+					shift = -1;
+					break;
+				}
+				shift = this_shift;
+				_players[sym][n][player] = new_player;
+			}
+
+			if (shift < 0)
+				for (unsigned int p = 0; p <= 6; p++)
+					_players[sym][n][p] = 0;
+		}
+	}
+
+	for (unsigned int sym = 0; sym < NUM_SYMMETRIES; sym++)
+		for (unsigned int inv = 0; inv < NUM_SYMMETRIES; inv++)
+			if (_holes[inv][_holes[sym][GameBoard::GOAL_MAP[1]]] ==
+				GameBoard::GOAL_MAP[1] &&
+				_holes[inv][_holes[sym][GameBoard::GOAL_MAP[2]]] ==
+				GameBoard::GOAL_MAP[2])
+					_inverse[sym] = inv;
+
+	return true;
+}
+
+
+bool BoardSymmetry::is_valid(unsigned int sym, unsigned int num_players)
+{
+	return _players[sym][num_players][1] != 0;
+}
+
+
+unsigned int BoardSymmetry::get_inverse(unsigned int sym)
+{
+	return _inverse[sym];
+}
+
+
+unsigned int BoardSymmetry::map_hole(unsigned int sym, unsigned int hole)
+{
+	return _holes[sym][hole];
+}
+
+
+unsigned int BoardSymmetry::map_player(unsigned int sym,
+									   unsigned int num_players,
+									   unsigned int player)
+{
+	return _players[sym][num_players][player];
+}
+
+
+void BoardSymmetry::map_move(unsigned int sym, MoveList *move)
+{
+	for (MoveList::iterator i = move->begin(); i != move->end(); i++)
+		*i = _holes[sym][*i];
+}
+
+
+guint64 BoardSymmetry::get_hash(unsigned int sym, const GameBoard& board,
+								unsigned int to_move)
+{
+	unsigned int num_players = board.get_num_players();
+	const unsigned int *players = _players[sym][num_players];
+	guint64 hash = GameBoard::ZOBRIST_TURN[players[to_move]];
+
+	for (unsigned int player = 1; player <= num_players; player++)
+	{
+		const unsigned int *pegs = board.get_pegs(player);
+
+		for (unsigned int i = 0; i < 10; i++)
+			hash ^= GameBoard::ZOBRIST_KEYS[_holes[sym][pegs[i]]]
+				[players[player]];
+	}
+
+	return hash;
+}
+
+
+unsigned int BoardSymmetry::canonicalize(const GameBoard& board,
+										 unsigned int to_move,
+										 guint64 *canonical_hash)
+{
+	unsigned int best_sym = 0;
+	guint64 best_hash = board.get_hash(to_move);
+
+	for (unsigned int sym = 1; sym < NUM_SYMMETRIES; sym++)
+	{
+		if (!is_valid(sym, board.get_num_players()))
+			continue;
+
+		guint64 hash = get_hash(sym, board, to_move);
+		if (hash < best_hash)
+		{
+			best_hash = hash;
+			best_sym = sym;
+		}
+	}
+
+	*canonical_hash = best_hash;
+
+	return best_sym;
+}
+
+
+void BoardSymmetry::apply(unsigned int sym, const GameBoard& src,
+						  GameBoard *dest)
+{
+	unsigned int num_players = src.get_num_players();
+
+	for (unsigned int i = 0; i < GameBoard::SIZE; i++)
+		if (src[i])
+			(*dest)[_holes[sym][i]]->set_current_player(
+				_players[sym][num_players][src[i]->get_current_player()]);
+
+	dest->reset_peg_lists();
+}
@@ -0,0 +1,69 @@
+/*
+ *  Rotations and reflections of the board, used to map positions to a
+ *  canonical form so that symmetric positions can share table entries.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef INCL_BOARD_SYMMETRY_HH
+#define INCL_BOARD_SYMMETRY_HH
+
+#include "game_board.hh"
+
+
+// Symmetries 0-5 are rotations by that many sixths of a turn, and 6-11
+// are the same rotations applied after a left-right mirror.  Symmetry 0
+// is the identity.
+class BoardSymmetry
+{
+public:
+	const static unsigned int NUM_SYMMETRIES = 12;
+
+	// A symmetry is only usable for a game if it moves every seated
+	// player's corner onto another seated player's corner, and keeps
+	// the order of turns.
+	static bool is_valid(unsigned int sym, unsigned int num_players);
+
+	static unsigned int get_inverse(unsigned int sym);
+	static unsigned int map_hole(unsigned int sym, unsigned int hole);
+	static unsigned int map_player(unsigned int sym, unsigned int num_players,
+								   unsigned int player);
+	static void map_move(unsigned int sym, MoveList *move);
+
+	// Returns the hash of board with player to move after applying sym
+	static guint64 get_hash(unsigned int sym, const GameBoard& board,
+							unsigned int to_move);
+
+	// Finds the valid symmetry giving the smallest hash.  Mapping the
+	// position (and its moves) through that symmetry gives the canonical
+	// form, and mapping through get_inverse() of it maps back again.
+	static unsigned int canonicalize(const GameBoard& board,
+									 unsigned int to_move,
+									 guint64 *canonical_hash);
+
+	// Sets up dest as src with sym applied.  Both must be the same variant.
+	static void apply(unsigned int sym, const GameBoard& src, GameBoard *dest);
+
+private:
+	static unsigned int _holes[NUM_SYMMETRIES][GameBoard::SIZE];
+	static unsigned int _players[NUM_SYMMETRIES][7][7];
+	static unsigned int _inverse[NUM_SYMMETRIES];
+	static bool _tables_ready;
+
+	static bool init_tables();
+};
+
+#endif   // #ifndef INCL_BOARD_SYMMETRY_HH
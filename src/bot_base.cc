@@ -17,11 +17,15 @@
  *
  */
 
+#include <algorithm>
 #include <glibmm/random.h>
 #include <glibmm/main.h>
+#include <glibmm/timer.h>
 
 #include "bot_base.hh"
+#include "bot_pool.hh"
 #include "game_images.hh"
+#include "opening_book.hh"
 #include "utility.hh"
 
 #include "bot_random.hh"
@@ -36,7 +40,21 @@ BotBase::BotBase()
 	_think_delay = 0;
 	_move_step_delay = 400;
 	_move_done_delay = 600;
-	_abort = FALSE;
+	g_atomic_int_set(&_abort, FALSE);
+	_book = NULL;
+	_nodes = 0;
+	_node_limit = 0;
+	_node_budget = 0;
+	_out_of_nodes = FALSE;
+	_completed_depth = 0;
+	_analysis = NULL;
+	_analysis_moves = 3;
+	_pump_events = TRUE;
+	_pool = NULL;
+	_pool_game = 0;
+	_pool_priority = 0;
+	g_atomic_int_set(&_turn, 0);
+	_stats = NULL;
 
 	_client.change_color(5);
 }
@@ -107,9 +125,99 @@ void BotBase::set_move_delay(int delay, int done_delay)
 }
 
 
+void BotBase::set_opening_book(const OpeningBook *book)
+{
+	_book = book;
+}
+
+
+// Limits each search to about this many scored moves, instead of always
+// searching to full depth, so bots play the same on any machine.
+void BotBase::set_node_limit(unsigned long nodes)
+{
+	_node_limit = nodes;
+}
+
+
+void BotBase::set_analysis_moves(unsigned int num_moves)
+{
+	_analysis_moves = num_moves;
+}
+
+
+// Searching normally lets the main loop run now and then, which must be
+// turned off when searching outside the main thread.
+void BotBase::set_pump_events(bool pump)
+{
+	_pump_events = pump;
+}
+
+
+// Every search the bot makes is added to stats, which may be shared
+void BotBase::set_stats(SearchStats *stats)
+{
+	_stats = stats;
+}
+
+
+const SearchRecord& BotBase::get_last_search() const
+{
+	return _last_search;
+}
+
+
+// Bots in a pool search in its threads instead of on the main loop,
+// taking turns at the threads with the bots of other games
+void BotBase::set_pool(BotPool *pool, unsigned int game, int priority)
+{
+	_pool = pool;
+	_pool_game = game;
+	_pool_priority = priority;
+	_pump_events = (pool == NULL);
+}
+
+
+// Only bots with an evaluation to weight care about these
+void BotBase::set_weights(const EvalWeights& weights)
+{
+}
+
+
+void BotBase::get_weights(EvalWeights *weights) const
+{
+}
+
+
+// Bots that look ahead can score moves with eval instead of their usual
+// evaluation.  NULL goes back to the usual one.
+void BotBase::set_linear_eval(const LinearEval *eval)
+{
+}
+
+
+unsigned long BotBase::get_nodes() const
+{
+	return _nodes;
+}
+
+
+unsigned int BotBase::get_max_depth() const
+{
+	return 1;
+}
+
+
+// Which player the bot expects to move after player, when looking ahead
+unsigned int BotBase::get_reply_player(GameBoard *board,
+									   unsigned int player) const
+{
+	return player;
+}
+
+
 BotBase::~BotBase()
 {
-	_abort = TRUE;
+	g_atomic_int_set(&_abort, TRUE);
 	_client.leave_game();
 }
 
@@ -120,7 +228,8 @@ GameClient* BotBase::get_game_client()
 }
 
 
-void BotBase::join_game(Glib::ustring host, unsigned int port)
+void BotBase::join_game(Glib::ustring host, unsigned int port,
+						bool spectator)
 {
 	if (_client.get_my_name() == "")
 		_client.change_name(get_default_name());
@@ -140,34 +249,46 @@ void BotBase::join_game(Glib::ustring host, unsigned int port)
 	_client.cmd_game_turn.connect(sigc::mem_fun(*this,
 		&BotBase::on_cmd_game_turn));
 
-	_client.join_game(host, port, false);
+	_client.join_game(host, port, spectator);
 }
 
 
 void BotBase::leave_game()
 {
-	_abort = TRUE;
+	g_atomic_int_set(&_abort, TRUE);
 	_client.leave_game();
 }
 
 
+void BotBase::abort_search()
+{
+	g_atomic_int_set(&_abort, TRUE);
+}
+
+
+void BotBase::clear_abort()
+{
+	g_atomic_int_set(&_abort, FALSE);
+}
+
+
 void BotBase::on_connect()
 {
-	_abort = FALSE;
+	g_atomic_int_set(&_abort, FALSE);
 	evt_connected();
 }
 
 
 void BotBase::on_cancelled()
 {
-	_abort = TRUE;
+	g_atomic_int_set(&_abort, TRUE);
 	evt_cancelled();
 }
 
 
 void BotBase::on_disconnect()
 {
-	_abort = TRUE;
+	g_atomic_int_set(&_abort, TRUE);
 	evt_disconnected();
 }
 
@@ -217,14 +338,28 @@ void BotBase::on_cmd_game_turn(unsigned int posn,
 							   unsigned int move_count)
 {
 	// Work around a gnet bug by using a timeout
-	if (posn == _client.get_my_player_number())
+	if (_client.is_spectator())
+	{
+		g_atomic_int_set(&_abort, TRUE);
+		if (posn > 0 && status == GameServer::Playing)
+			Glib::signal_timeout().connect(sigc::bind_return(
+				sigc::mem_fun(this, &BotBase::analyze_turn), false), 1);
+	}
+	else if (posn == _client.get_my_player_number() && _pool)
+	{
+		g_atomic_int_set(&_abort, FALSE);
+		g_atomic_int_inc(&_turn);
+		search_in_pool();
+	}
+	else if (posn == _client.get_my_player_number())
 	{
-		_abort = FALSE;
+		g_atomic_int_set(&_abort, FALSE);
 		Glib::signal_timeout().connect(sigc::bind_return(sigc::mem_fun(this,
 			&BotBase::make_best_move), false), 1);
 	}
 	else {
-		_abort = TRUE;
+		g_atomic_int_set(&_abort, TRUE);
+		g_atomic_int_inc(&_turn);
 	}
 
 //	if (move_count % 50 == 0) {
@@ -235,20 +370,264 @@ void BotBase::on_cmd_game_turn(unsigned int posn,
 
 bool BotBase::is_still_my_turn()
 {
-	return (!_abort);
+	return (!g_atomic_int_get(&_abort) && !_out_of_nodes);
+}
+
+
+void BotBase::count_node()
+{
+	if (++_nodes >= _node_budget && _node_budget)
+		_out_of_nodes = TRUE;
 }
 
 
 void BotBase::make_best_move()
+{
+	GameBoard board(*_client.get_board());
+	MoveList move;
+
+	if (choose_move(&board, _client.get_my_player_number(), &move))
+		make_move(&move);
+}
+
+
+// Picks one of player's best moves on board.  Returns false if there is
+// no move to make.
+bool BotBase::choose_move(GameBoard *board, unsigned int player,
+						  MoveList *move)
 {
 	std::vector<MoveList> best_moves;
+	long best_score = LONG_MIN;
+
+	// Opening positions come straight out of the book, without searching
+	if (!_book || !_book->lookup(board, player, &best_moves))
+		think(board, player, &best_moves, &best_score);
+
+	if (best_moves.empty())
+		return false;
+
+	*move = best_moves[_rand.get_int_range(0, best_moves.size())];
+	return true;
+}
+
+
+// Pooled bots search in one of the pool's threads, and move when the pool
+// hands back the result.  Always returns false, for use as a timeout.
+bool BotBase::search_in_pool()
+{
 	GameBoard board(*_client.get_board());
+	unsigned int player = _client.get_my_player_number();
+	std::vector<MoveList> best_moves;
+
+	if (!is_still_my_turn() || player != _client.get_current_player())
+		return false;
+
+	if (_book && _book->lookup(&board, player, &best_moves))
+	{
+		on_search_done(g_atomic_int_get(&_turn), &best_moves);
+		return false;
+	}
+
+	if (_pool->submit(this, board, player, _pool_game, _pool_priority,
+					  g_atomic_int_get(&_turn)))
+		return false;
+
+	// The bot's last search is still finishing in the pool
+	if (_pool->is_busy(this))
+	{
+		Glib::signal_timeout().connect(sigc::mem_fun(this,
+			&BotBase::search_in_pool), 100);
+		return false;
+	}
+
+	// With the pool's queue full, a quick look one move ahead will do
+	long best_score = LONG_MIN;
+	unsigned long node_limit = _node_limit;
+
+	set_node_limit(1);
+	think(&board, player, &best_moves, &best_score);
+	set_node_limit(node_limit);
+
+	on_search_done(g_atomic_int_get(&_turn), &best_moves);
+	return false;
+}
+
+
+void BotBase::on_search_done(unsigned int turn,
+							 std::vector<MoveList> *best_moves)
+{
+	// Ignore searches from turns that have since been undone
+	if (turn != (unsigned int)g_atomic_int_get(&_turn) ||
+		!is_still_my_turn() || best_moves->empty())
+		return;
+
+	MoveList move = (*best_moves)[_rand.get_int_range(0, best_moves->size())];
+	make_move(&move);
+}
+
+
+void BotBase::think(GameBoard *board, unsigned int player,
+					std::vector<MoveList> *best_moves, long *best_score)
+{
+	Glib::Timer timer;
+
+	_last_search = SearchRecord();
+	search(board, player, best_moves, best_score);
+	timer.stop();
+
+	_last_search.depth = _completed_depth;
+	_last_search.nodes = _nodes;
+	_last_search.seconds = timer.elapsed();
+
+	if (_stats)
+		_stats->add(_last_search);
+}
+
+
+void BotBase::search(GameBoard *board, unsigned int player,
+					 std::vector<MoveList> *best_moves, long *best_score)
+{
+	std::vector<MoveAnalysis> *analysis = _analysis;
+
+	_nodes = 0;
+	_node_budget = 0;
+	_out_of_nodes = FALSE;
+	_completed_depth = 0;
+
+	if (!_node_limit)
+	{
+		start_search(get_max_depth());
+		find_best_move(board, player, best_moves, best_score);
+		_completed_depth = get_max_depth();
+		_last_search.passes = 1;
+		return;
+	}
+
+	// The first pass always runs to completion so there is a move to make,
+	// after that a pass that runs out of nodes is thrown away.
+	for (unsigned int depth = 1; depth <= get_max_depth(); depth++)
+	{
+		std::vector<MoveList> moves;
+		std::vector<MoveAnalysis> pass_analysis;
+		long score = LONG_MIN;
+
+		if (analysis)
+			_analysis = &pass_analysis;
+
+		start_search(depth);
+		find_best_move(board, player, &moves, &score);
+
+		if (!is_still_my_turn())
+			break;
+
+		if (_completed_depth && !moves.empty() &&
+			std::find(best_moves->begin(), best_moves->end(), moves[0]) ==
+			best_moves->end())
+			_last_search.best_move_changes++;
+		_last_search.passes++;
+
+		*best_moves = moves;
+		*best_score = score;
+		if (analysis)
+			analysis->swap(pass_analysis);
+		_completed_depth = depth;
+
+		_node_budget = _node_limit;
+		if (_nodes >= _node_limit)
+			break;
+	}
+
+	_analysis = analysis;
+	_out_of_nodes = FALSE;
+}
+
+
+static bool better_analysis(const BotBase::MoveAnalysis& a,
+							const BotBase::MoveAnalysis& b)
+{
+	return a.score > b.score;
+}
+
+
+void BotBase::analyze(GameBoard *board, unsigned int player,
+					  unsigned int num_moves,
+					  std::vector<MoveAnalysis> *analysis)
+{
+	std::vector<MoveList> best_moves;
 	long best_score = LONG_MIN;
 
-	find_best_move(&board, _client.get_my_player_number(),
-					&best_moves, &best_score);
+	analysis->clear();
+
+	// Every move scored at the top of the search gets recorded
+	_analysis = analysis;
+	think(board, player, &best_moves, &best_score);
+	_analysis = NULL;
+	_node_budget = 0;
+
+	if (!is_still_my_turn())
+	{
+		analysis->clear();
+		return;
+	}
+
+	std::stable_sort(analysis->begin(), analysis->end(), better_analysis);
+	if (analysis->size() > num_moves)
+		analysis->resize(num_moves);
+
+	// Follow each move with the replies the bot would pick, a move less
+	// deep each time, like the search it came from.  These get searched
+	// without the node limit, since they're smaller than the search was.
+	for (std::vector<MoveAnalysis>::iterator a = analysis->begin();
+		 a != analysis->end(); a++)
+	{
+		GameBoard pv_board(*board);
+		unsigned int mover = player;
+
+		pv_board.move_peg(a->move.front(), a->move.back());
+
+		for (unsigned int depth = _completed_depth - 1; depth > 0; depth--)
+		{
+			if (pv_board.game_finished())
+				break;
+
+			mover = get_reply_player(&pv_board, mover);
+			if (pv_board.player_finished(mover))
+				break;
+
+			std::vector<MoveList> replies;
+			long reply_score = LONG_MIN;
+
+			start_search(depth);
+			find_best_move(&pv_board, mover, &replies, &reply_score);
+
+			if (replies.empty() || !is_still_my_turn())
+				break;
+
+			a->pv.push_back(replies[0]);
+			pv_board.move_peg(replies[0].front(), replies[0].back());
+		}
+	}
+}
+
+
+// Analyzes the current position for a spectating bot
+void BotBase::analyze_turn()
+{
+	GameBoard board(*_client.get_board());
+	unsigned int player = _client.get_current_player();
+	std::vector<MoveAnalysis> analysis;
+
+	g_atomic_int_set(&_abort, FALSE);
+	analyze(&board, player, _analysis_moves, &analysis);
 
-	make_move(&(best_moves[_rand.get_int_range(0, best_moves.size())]));
+	if (is_still_my_turn() && !analysis.empty())
+		evt_analysis(player, &analysis);
+}
+
+
+void BotBase::start_search(unsigned int depth)
+{
+	_move_cache.reset();
 }
 
 
@@ -266,42 +645,76 @@ void BotBase::find_best_move(GameBoard *board, unsigned int player,
 }
 
 
+// Only pegs whose moves aren't in the cache need them found again
 void BotBase::find_better_move(GameBoard *board, unsigned int player,
 	MoveList *move,	std::vector<MoveList> *best_moves, long *best_score)
 {
-	unsigned int *pegs = board->get_pegs(player);
-	std::set<unsigned int> tos;
-
 	for (unsigned int i = 0; i < 10; i++)
 	{
-		move->push_back(pegs[i]);
-		tos.clear();
-		tos.insert(pegs[i]);
-		find_better_move_for_peg(board, player, move, best_moves,
-								 best_score, &tos);
+		if (!_move_cache.has_moves(player, i))
+			find_moves_for_peg(board, player, i);
+		else
+		{
+			_last_search.cache_hits++;
+#ifdef DEBUG_MOVE_CACHE
+			check_cached_moves(board, player, i);
+#endif
+		}
 
-		move->pop_back();
+		unsigned int num_moves;
+		unsigned int posn = _move_cache.get_moves(player, i, &num_moves);
 
-		// Abort if it's not my turn anymore (undo/etc)
-		if (!is_still_my_turn()) return;
+		for (unsigned int m = 0; m < num_moves; m++)
+		{
+			_move_cache.get_move(&posn, move);
+			consider_move(board, player, move, best_moves, best_score);
+
+			// Abort if it's not my turn anymore (undo/etc)
+			if (!is_still_my_turn()) return;
+		}
 	}
 }
 
 
-void BotBase::find_better_move_for_peg(GameBoard *board, unsigned int player,
-	MoveList *move,	std::vector<MoveList> *best_moves, long *best_score,
-	std::set<unsigned int> *tos)
+// Finds the moves of all of player's pegs that aren't already known
+void BotBase::fill_move_cache(GameBoard *board, unsigned int player)
+{
+	for (unsigned int i = 0; i < 10; i++)
+		if (!_move_cache.has_moves(player, i))
+			find_moves_for_peg(board, player, i);
+}
+
+
+void BotBase::find_moves_for_peg(GameBoard *board, unsigned int player,
+								 unsigned int peg)
+{
+	unsigned int hole = board->get_pegs(player)[peg];
+	MoveList move(1, hole);
+	bool tos[GameBoard::SIZE] = {false};
+
+	tos[hole] = true;
+	_last_search.cache_misses++;
+
+	_move_cache.start_peg(player, peg, hole);
+	find_moves_for_peg(board, player, &move, tos);
+	_move_cache.finish_peg();
+}
+
+
+// Adds each move of the peg at the front of move to the cache, where tos
+// marks the holes it has already reached
+void BotBase::find_moves_for_peg(GameBoard *board, unsigned int player,
+	MoveList *move, bool *tos)
 {
 	unsigned int from_hole = move->back();
 
+	_move_cache.add_lines(from_hole, board->get_long_jumps_allowed());
+
 	for (int dir = 0; dir < 6; dir++)
 	{
 		// Potential non-jumping move
 		if (move->size() == 1 && (*board)[from_hole]->get_neighbor(dir))
 		{
-			//if (move->size() == 1 && (from_hole == 70 || from_hole == 72)) {
-			//	printf("zing!\n");
-			//}
 			unsigned int to_hole =
 				(*board)[from_hole]->get_neighbor(dir)->get_id();
 
@@ -311,27 +724,9 @@ void BotBase::find_better_move_for_peg(GameBoard *board, unsigned int player,
 				!board->is_other_player_triangle(player, to_hole)))
 			{
 				move->push_back(to_hole);
-				long score = score_move(board, player, move);
-				if (score > *best_score)
-				{
-					*best_score = score;
-					best_moves->clear();
-					best_moves->push_back(*move);
-				}
-				else if (score == *best_score)
-				{
-					best_moves->push_back(*move);
-				}
-
-				if (_client.ready() && _think_delay)
-				{
-					_client.show_move(move);
-					//printf("%ld\n", score);
-					util::delay_ms(_think_delay);
-				}
-
+				_move_cache.add_move(*move);
 				move->pop_back();
-				tos->insert(to_hole);
+				tos[to_hole] = true;
 			}
 		}
 
@@ -339,46 +734,95 @@ void BotBase::find_better_move_for_peg(GameBoard *board, unsigned int player,
 		unsigned int to_hole = board->find_valid_jump(move->front(),
 													  from_hole, dir);
 
-		if (to_hole && tos->find(to_hole) == tos->end())
+		if (to_hole && !tos[to_hole])
 		{
 			move->push_back(to_hole);
 
 			if (board->get_stop_others_allowed() ||
 				!board->is_other_player_triangle(player, to_hole))
-			{
-				long score = score_move(board, player, move);
-				if (score > *best_score)
-				{
-					*best_score = score;
-					best_moves->clear();
-					best_moves->push_back(*move);
-				}
-				else if (score == *best_score)
-				{
-					best_moves->push_back(*move);
-				}
-
-				if (_client.ready() && _think_delay)
-				{
-					_client.show_move(move);
-					//printf("%ld\n", score);
-					util::delay_ms(_think_delay);
-				}
-			}
-			tos->insert(to_hole);
+				_move_cache.add_move(*move);
+			tos[to_hole] = true;
 
 			// Recurse
-			find_better_move_for_peg(board, player, move, best_moves,
-									 best_score, tos);
+			find_moves_for_peg(board, player, move, tos);
 			move->pop_back();
-
-			// Abort if it's not my turn anymore (undo/etc)
-			if (!is_still_my_turn()) return;
 		}
 	}
 }
 
 
+#ifdef DEBUG_MOVE_CACHE
+// Finds the peg's moves again, which replaces them in the cache, and
+// checks they're the same moves in the same order as were there
+void BotBase::check_cached_moves(GameBoard *board, unsigned int player,
+								 unsigned int peg)
+{
+	std::vector<MoveList> cached, found;
+	MoveList move;
+	unsigned int num_moves, posn;
+
+	posn = _move_cache.get_moves(player, peg, &num_moves);
+	for (unsigned int m = 0; m < num_moves; m++)
+	{
+		_move_cache.get_move(&posn, &move);
+		cached.push_back(move);
+	}
+
+	find_moves_for_peg(board, player, peg);
+
+	posn = _move_cache.get_moves(player, peg, &num_moves);
+	for (unsigned int m = 0; m < num_moves; m++)
+	{
+		_move_cache.get_move(&posn, &move);
+		found.push_back(move);
+	}
+
+	g_assert(cached == found);
+}
+#endif
+
+
+void BotBase::consider_move(GameBoard *board, unsigned int player,
+	MoveList *move,	std::vector<MoveList> *best_moves, long *best_score)
+{
+	// Only moves at the top of the search get recorded for analysis, not
+	// the ones scored inside score_move()
+	std::vector<MoveAnalysis> *analysis = _analysis;
+
+	count_node();
+
+	_analysis = NULL;
+	long score = score_move(board, player, move);
+	_analysis = analysis;
+
+	if (analysis && is_still_my_turn())
+	{
+		analysis->push_back(MoveAnalysis());
+		analysis->back().move = *move;
+		analysis->back().score = score;
+	}
+
+	if (score > *best_score)
+	{
+		*best_score = score;
+		best_moves->clear();
+		best_moves->push_back(*move);
+	}
+	else if (score == *best_score)
+	{
+		best_moves->push_back(*move);
+	}
+
+	// Only on the main loop, not in a pool's thread
+	if (_pump_events && _client.ready() && _think_delay)
+	{
+		_client.show_move(move);
+		//printf("%ld\n", score);
+		util::delay_ms(_think_delay);
+	}
+}
+
+
 void BotBase::make_move(MoveList *list)
 {
 	if (list->empty())
@@ -21,17 +21,32 @@
 #define _BOT_BASE_HH
 
 #include <vector>
-#include <set>
 #include <sigc++/sigc++.h>
 #include <glibmm/ustring.h>
 #include <glibmm/random.h>
 
 #include "game_client.hh"
+#include "eval_weights.hh"
+#include "move_cache.hh"
+#include "search_stats.hh"
 
+class OpeningBook;
+class LinearEval;
+class BotPool;
 
 class BotBase : public sigc::trackable
 {
 	public:
+		// One of the moves found by analyze(), with the moves the bot
+		// expects to follow it
+		class MoveAnalysis
+		{
+		public:
+			MoveList				move;
+			long					score;
+			std::vector<MoveList>	pv;
+		};
+
 		BotBase();
 		virtual ~BotBase();
 
@@ -41,15 +56,55 @@ class BotBase : public sigc::trackable
 		void set_color(unsigned int color);
 		void set_think_delay(int delay);
 		void set_move_delay(int delay, int done_delay);
+		void set_opening_book(const OpeningBook *book);
+		void set_node_limit(unsigned long nodes);
+		void set_analysis_moves(unsigned int num_moves);
+		void set_pump_events(bool pump);
+		void set_pool(BotPool *pool, unsigned int game, int priority = 0);
+		void set_stats(SearchStats *stats);
+		virtual void set_weights(const EvalWeights& weights);
+		virtual void get_weights(EvalWeights *weights) const;
+		virtual void set_linear_eval(const LinearEval *eval);
+		unsigned long get_nodes() const;
+		const SearchRecord& get_last_search() const;
 		GameClient *get_game_client();
 
 		sigc::signal<void, Glib::ustring> evt_message;
 		sigc::signal<void> evt_connected;
 		sigc::signal<void> evt_cancelled;
 		sigc::signal<void> evt_disconnected;
+		sigc::signal<void, unsigned int, std::vector<MoveAnalysis>*>
+			evt_analysis;
 
-		void join_game(Glib::ustring host, unsigned int port);
+		// Spectating bots analyze every turn instead of playing
+		void join_game(Glib::ustring host, unsigned int port,
+					   bool spectator = false);
 		void leave_game();
+		void abort_search();
+		// Lets the next search run after abort_search()
+		void clear_abort();
+
+		// Called by the bot's pool, back on the main loop
+		void on_search_done(unsigned int turn,
+							std::vector<MoveList> *best_moves);
+
+		// Searches board for player's best moves, without needing to be
+		// connected to a game.  With a node limit, searches deeper and
+		// deeper (up to get_max_depth()) until the limit is used up.
+		void think(GameBoard *board, unsigned int player,
+				   std::vector<MoveList> *best_moves, long *best_score);
+
+		// Picks the move to make from think()'s best moves, or the opening
+		// book.  Bots seated right in a GameServer move with this.
+		bool choose_move(GameBoard *board, unsigned int player,
+						 MoveList *move);
+
+		// Ranks player's num_moves best moves, each with its score and the
+		// line of play the bot expects after it.  Doesn't touch the main
+		// loop if event pumping is off, so it can run in another thread.
+		void analyze(GameBoard *board, unsigned int player,
+					 unsigned int num_moves,
+					 std::vector<MoveAnalysis> *analysis);
 
 		virtual void find_best_move(GameBoard *board, unsigned int player,
 									std::vector<MoveList> *best_moves,
@@ -58,6 +113,11 @@ class BotBase : public sigc::trackable
 								MoveList *move) = 0;
 
 		virtual Glib::ustring get_default_name() const = 0;
+		// The shortest type new_bot_of_type() takes for this bot, like "l5"
+		virtual Glib::ustring get_type() const = 0;
+		virtual unsigned int get_max_depth() const;
+		virtual unsigned int get_reply_player(GameBoard *board,
+											  unsigned int player) const;
 
 	protected:
 		void on_connect();
@@ -70,24 +130,56 @@ class BotBase : public sigc::trackable
 									  GameServer::GameStatus status,
 									  unsigned int move_count);
 
+		void search(GameBoard *board, unsigned int player,
+					std::vector<MoveList> *best_moves, long *best_score);
+		virtual void start_search(unsigned int depth);
+		void count_node();
 		bool is_still_my_turn();
 		bool is_blocking_pegs(GameBoard *board, unsigned int player);
 
 		void make_best_move();
+		bool search_in_pool();
 		void make_move(MoveList *list);
+		void analyze_turn();
 
 		void find_better_move(GameBoard *board, unsigned int player,
 			MoveList *move,	std::vector<MoveList> *best_moves, long *best_score);
-		void find_better_move_for_peg(GameBoard *board, unsigned int player,
-			MoveList *move,	std::vector<MoveList> *best_moves, long *best_score,
-			std::set<unsigned int> *tos);
+		void consider_move(GameBoard *board, unsigned int player,
+			MoveList *move,	std::vector<MoveList> *best_moves, long *best_score);
+		void fill_move_cache(GameBoard *board, unsigned int player);
+		void find_moves_for_peg(GameBoard *board, unsigned int player,
+								unsigned int peg);
+		void find_moves_for_peg(GameBoard *board, unsigned int player,
+			MoveList *move, bool *tos);
+#ifdef DEBUG_MOVE_CACHE
+		void check_cached_moves(GameBoard *board, unsigned int player,
+								unsigned int peg);
+#endif
 
 		GameClient 		_client;
 		int				_think_delay;
 		int				_move_step_delay;
 		int				_move_done_delay;
-		bool			_abort;
+		// Read by pool threads while the main loop changes them, so only
+		// through g_atomic_int_get() and g_atomic_int_set()
+		volatile gint	_abort;
+		volatile gint	_turn;
 		Glib::Rand		_rand;
+		const OpeningBook	*_book;
+		unsigned long	_nodes;
+		unsigned long	_node_limit;
+		unsigned long	_node_budget;
+		bool			_out_of_nodes;
+		unsigned int	_completed_depth;
+		std::vector<MoveAnalysis>	*_analysis;
+		unsigned int	_analysis_moves;
+		bool			_pump_events;
+		MoveCache		_move_cache;
+		BotPool			*_pool;
+		unsigned int	_pool_game;
+		int				_pool_priority;
+		SearchStats		*_stats;
+		SearchRecord	_last_search;
 };
 
 #endif // _BOT_BASE_HH
@@ -18,6 +18,7 @@
  */
  
 #include "bot_friendly.hh"
+#include "utility.hh"
 
 
 BotFriendly::BotFriendly(unsigned int depth) : BotLookAhead(depth)
@@ -34,9 +35,25 @@ void BotFriendly::set_self_penalty(int self_penalty)
 }
 
 
+void BotFriendly::set_weights(const EvalWeights& weights)
+{
+	BotLookAhead::set_weights(weights);
+
+	if (weights.get(EvalWeights::SelfPenalty) > 0)
+		_self_penalty = weights.get(EvalWeights::SelfPenalty);
+}
+
+
+void BotFriendly::get_weights(EvalWeights *weights) const
+{
+	BotLookAhead::get_weights(weights);
+	weights->set(EvalWeights::SelfPenalty, _self_penalty);
+}
+
+
 Glib::ustring BotFriendly::get_default_name() const
 {
-	switch (_depth)
+	switch (_max_depth)
 	{
 		case 1:
 			return "Bonk";
@@ -52,6 +69,20 @@ Glib::ustring BotFriendly::get_default_name() const
 }
 
 
+Glib::ustring BotFriendly::get_type() const
+{
+	return "f" + util::to_str(get_max_depth());
+}
+
+
+// Friendly bots look ahead at the other players' moves, not just their own
+unsigned int BotFriendly::get_reply_player(GameBoard *board,
+										   unsigned int player) const
+{
+	return board->get_next_player(player);
+}
+
+
 long BotFriendly::score_move_recurse(GameBoard *board, unsigned int player,
 									 MoveList *move)
 {
@@ -78,6 +109,11 @@ void BotFriendly::find_best_move(GameBoard *board, unsigned int player,
 							 std::vector<MoveList> *best_moves,
 							 long *best_score)
 {
+	// The other players' moves found at the top are good throughout
+	if (_current_depth == _depth)
+		for (unsigned int p = 1; p <= board->get_num_players(); p++)
+			fill_move_cache(board, p);
+
 	if (_current_depth < _depth)
 		player = board->get_next_player(player);
 
@@ -29,8 +29,13 @@ class BotFriendly : public BotLookAhead
 		BotFriendly(unsigned int depth);
 
 		void set_self_penalty(int self_penalty);
+		virtual void set_weights(const EvalWeights& weights);
+		virtual void get_weights(EvalWeights *weights) const;
 
 		virtual Glib::ustring get_default_name() const;
+		virtual Glib::ustring get_type() const;
+		virtual unsigned int get_reply_player(GameBoard *board,
+											  unsigned int player) const;
 
 	protected:
 		virtual long score_move_recurse(GameBoard *board, unsigned int player,
@@ -0,0 +1,287 @@
+/*
+ *  Hosts many bots in one process, taking commands to add and remove them
+ *  over a simple line-based control connection.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include <sstream>
+#include <sigc++/bind.h>
+#include <glibmm/main.h>
+
+#include "bot_host.hh"
+#include "bot_base.hh"
+#include "bot_pool.hh"
+#include "search_stats.hh"
+#include "utility.hh"
+
+
+BotHost::BotHost(BotPool *pool)
+	:_pool(pool),
+	 _node_limit(0),
+	 _book(NULL),
+	 _stats(NULL),
+	 _next_game(1)
+{
+	_socket.evt_connection_available.connect(sigc::mem_fun(*this,
+		&BotHost::connection_open));
+
+	Glib::signal_timeout().connect(sigc::mem_fun(*this,
+		&BotHost::delete_dead_bots), 500);
+}
+
+
+BotHost::~BotHost()
+{
+	_socket.close();
+
+	while (!_bots.empty())
+		remove_bot(_bots.front().bot);
+
+	// Leaving their games aborted any searches, which the pool hands back
+	// on the main loop
+	while (delete_dead_bots() && !_dead_bots.empty())
+		util::delay_ms(10);
+}
+
+
+bool BotHost::listen(unsigned int port)
+{
+	return _socket.listen(port, true);
+}
+
+
+void BotHost::set_node_limit(unsigned long nodes)
+{
+	_node_limit = nodes;
+}
+
+
+void BotHost::set_opening_book(const OpeningBook *book)
+{
+	_book = book;
+}
+
+
+void BotHost::set_stats(SearchStats *stats)
+{
+	_stats = stats;
+}
+
+
+unsigned int BotHost::get_num_bots() const
+{
+	return _bots.size();
+}
+
+
+void BotHost::connection_open(Gnet::Conn *conn)
+{
+	conn->evt_data_available.connect(sigc::bind(sigc::mem_fun(*this,
+		&BotHost::handle_command), conn));
+	conn->evt_closed.connect(sigc::bind(sigc::mem_fun(*this,
+		&BotHost::connection_closed), conn));
+}
+
+
+void BotHost::connection_closed(Gnet::Conn *conn)
+{
+	command_removebots(conn);
+	delete conn;
+}
+
+
+void BotHost::handle_command(Glib::ustring message, Gnet::Conn *conn)
+{
+	Glib::ustring command, arguments;
+
+	util::trim(message);
+
+	int seperator = message.find_first_of(" ");
+	if (seperator < 0)
+		command = message;
+	else
+	{
+		command = message.substr(0, seperator);
+		arguments = message.substr(seperator+1, message.length()-seperator-1);
+	}
+
+	if (command == "addbot")
+		command_addbot(conn, arguments);
+	else if (command == "removebots")
+	{
+		command_removebots(conn);
+		(*conn) << "OK\n";
+	}
+	else if (command == "status")
+		command_status(conn);
+	else if (command != "")
+		(*conn) << "ERROR unknown command " + command + "\n";
+}
+
+
+void BotHost::command_addbot(Gnet::Conn *conn, Glib::ustring arguments)
+{
+	std::istringstream stream(arguments);
+	std::string type, host;
+	unsigned int port = 0;
+	int priority = 0;
+
+	stream >> type >> host >> port;
+	if (!stream || !port)
+	{
+		(*conn) << "ERROR usage: addbot <type> <host> <port> [priority]\n";
+		return;
+	}
+	stream >> priority;
+
+	BotBase *bot = BotBase::new_bot_of_type(type);
+	if (!bot)
+	{
+		(*conn) << "ERROR bad bot type " + type + "\n";
+		return;
+	}
+
+	HostedBot hosted;
+	hosted.bot = bot;
+	hosted.owner = conn;
+	hosted.game = get_game(host, port);
+	_bots.push_back(hosted);
+
+	if (_node_limit)
+		bot->set_node_limit(_node_limit);
+	if (_book)
+		bot->set_opening_book(_book);
+	if (_stats)
+		bot->set_stats(_stats);
+	bot->set_pool(_pool, hosted.game, priority);
+
+	bot->evt_disconnected.connect(sigc::bind(sigc::mem_fun(*this,
+		&BotHost::on_bot_disconnected), bot));
+	bot->evt_cancelled.connect(sigc::bind(sigc::mem_fun(*this,
+		&BotHost::on_bot_disconnected), bot));
+
+	bot->join_game(host, port);
+
+	(*conn) << "OK\n";
+}
+
+
+void BotHost::command_removebots(Gnet::Conn *conn)
+{
+	std::list<BotBase*> bots;
+
+	for (std::list<HostedBot>::iterator b = _bots.begin(); b != _bots.end();
+		 b++)
+		if (b->owner == conn)
+			bots.push_back(b->bot);
+
+	for (std::list<BotBase*>::iterator b = bots.begin(); b != bots.end(); b++)
+		remove_bot(*b);
+}
+
+
+void BotHost::command_status(Gnet::Conn *conn)
+{
+	Glib::ustring status = "OK bots " + util::to_str(_bots.size()) +
+		" games " + util::to_str(_games.size()) +
+		" threads " + util::to_str(_pool->get_num_threads()) +
+		" running " + util::to_str(_pool->get_num_running()) +
+		" queued " + util::to_str(_pool->get_num_queued());
+
+	if (_stats)
+		status += " searches " + util::to_str(_stats->get_num_searches()) +
+			" p50 " + util::to_str((int)(1000 * _stats->get_percentile(0.50))) +
+			" p95 " + util::to_str((int)(1000 * _stats->get_percentile(0.95))) +
+			" p99 " + util::to_str((int)(1000 * _stats->get_percentile(0.99)));
+
+	(*conn) << status + "\n";
+}
+
+
+unsigned int BotHost::get_game(const Glib::ustring& host, unsigned int port)
+{
+	Glib::ustring key = host + ":" + util::to_str(port);
+	std::map<Glib::ustring, unsigned int>::iterator g = _games.find(key);
+
+	if (g != _games.end())
+		return g->second;
+
+	_games[key] = _next_game;
+	return _next_game++;
+}
+
+
+// The bot can't be deleted until the pool has handed back its last search,
+// and it may be in the middle of one of its own signals, so that waits for
+// delete_dead_bots()
+void BotHost::remove_bot(BotBase *bot)
+{
+	unsigned int game = 0;
+
+	for (std::list<HostedBot>::iterator b = _bots.begin(); b != _bots.end();
+		 b++)
+		if (b->bot == bot)
+		{
+			game = b->game;
+			_bots.erase(b);
+			break;
+		}
+
+	if (!game)
+		return;
+
+	_pool->cancel(bot);
+	_dead_bots.push_back(bot);
+	bot->leave_game();
+
+	for (std::list<HostedBot>::iterator b = _bots.begin(); b != _bots.end();
+		 b++)
+		if (b->game == game)
+			return;
+
+	// That was the game's last bot
+	_pool->forget_game(game);
+	for (std::map<Glib::ustring, unsigned int>::iterator g = _games.begin();
+		 g != _games.end(); g++)
+		if (g->second == game)
+		{
+			_games.erase(g);
+			break;
+		}
+}
+
+
+void BotHost::on_bot_disconnected(BotBase *bot)
+{
+	remove_bot(bot);
+}
+
+
+bool BotHost::delete_dead_bots()
+{
+	for (std::list<BotBase*>::iterator b = _dead_bots.begin();
+		 b != _dead_bots.end(); )
+		if (!_pool->is_busy(*b))
+		{
+			delete *b;
+			b = _dead_bots.erase(b);
+		}
+		else
+			b++;
+
+	return true;
+}
@@ -0,0 +1,97 @@
+/*
+ *  Hosts many bots in one process, taking commands to add and remove them
+ *  over a simple line-based control connection.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef INCL_BOT_HOST_HH
+#define INCL_BOT_HOST_HH
+
+#include <list>
+#include <map>
+#include <glibmm/ustring.h>
+#include <sigc++/sigc++.h>
+
+#include "gnet_server.hh"
+
+class BotBase;
+class BotPool;
+class OpeningBook;
+class SearchStats;
+
+
+// Control commands, one per line:
+//   addbot <type> <host> <port> [priority]
+//   removebots
+//   status
+// Each is answered with a line starting OK or ERROR.  With stats set,
+// status adds the p50/p95/p99 think times in milliseconds.  Bots belong to the
+// control connection that added them, and leave their games when it
+// closes.  All bots search in the one BotPool.
+class BotHost : public sigc::trackable
+{
+public:
+	BotHost(BotPool *pool);
+	virtual ~BotHost();
+
+	bool listen(unsigned int port);
+
+	void set_node_limit(unsigned long nodes);
+	void set_opening_book(const OpeningBook *book);
+	void set_stats(SearchStats *stats);
+
+	unsigned int get_num_bots() const;
+
+private:
+	class HostedBot
+	{
+	public:
+		BotBase			*bot;
+		Gnet::Conn		*owner;
+		unsigned int	game;
+	};
+
+	void connection_open(Gnet::Conn *conn);
+	void connection_closed(Gnet::Conn *conn);
+	void handle_command(Glib::ustring message, Gnet::Conn *conn);
+
+	void command_addbot(Gnet::Conn *conn, Glib::ustring arguments);
+	void command_removebots(Gnet::Conn *conn);
+	void command_status(Gnet::Conn *conn);
+
+	unsigned int get_game(const Glib::ustring& host, unsigned int port);
+	void remove_bot(BotBase *bot);
+	void on_bot_disconnected(BotBase *bot);
+	bool delete_dead_bots();
+
+	BotPool							*_pool;
+	Gnet::Server					_socket;
+	unsigned long					_node_limit;
+	const OpeningBook				*_book;
+	SearchStats						*_stats;
+
+	std::list<HostedBot>			_bots;
+
+	// Bots that have left, waiting for the pool to finish with them
+	std::list<BotBase*>				_dead_bots;
+
+	// Bots in the same game share a game number in the pool
+	std::map<Glib::ustring, unsigned int>	_games;
+	unsigned int					_next_game;
+};
+
+#endif   // #ifndef INCL_BOT_HOST_HH
@@ -24,16 +24,21 @@
 
 BotLookAhead::BotLookAhead(unsigned int depth) : BotBase()
 {
+	_max_depth = depth;
 	_depth = depth;
 	_current_depth = 0;
 	_scratch_moves.resize(depth);
 	_scratch_best_moves.resize(depth);
+	_linear_eval = NULL;
+	_accumulators.resize(depth + 1);
+
+	set_weights(EvalWeights());
 }
 
 
 Glib::ustring BotLookAhead::get_default_name() const
 {
-	switch (_depth)
+	switch (_max_depth)
 	{
 		case 1:
 			return "Batty";
@@ -51,12 +56,49 @@ Glib::ustring BotLookAhead::get_default_name() const
 }
 
 
-void BotLookAhead::on_cmd_game_turn(unsigned int posn, 
-									GameServer::GameStatus status,
-									unsigned int move_count)
+Glib::ustring BotLookAhead::get_type() const
+{
+	return "l" + util::to_str(get_max_depth());
+}
+
+
+void BotLookAhead::set_weights(const EvalWeights& weights)
+{
+	_distance_weight = weights.get(EvalWeights::Distance);
+	_finish_bonus = weights.get(EvalWeights::FinishBonus);
+	_finish_depth_bonus = weights.get(EvalWeights::FinishDepthBonus);
+	_blocking_penalty = weights.get(EvalWeights::BlockingPenalty);
+}
+
+
+void BotLookAhead::get_weights(EvalWeights *weights) const
+{
+	weights->set(EvalWeights::Distance, _distance_weight);
+	weights->set(EvalWeights::FinishBonus, _finish_bonus);
+	weights->set(EvalWeights::FinishDepthBonus, _finish_depth_bonus);
+	weights->set(EvalWeights::BlockingPenalty, _blocking_penalty);
+}
+
+
+void BotLookAhead::set_linear_eval(const LinearEval *eval)
+{
+	_linear_eval = eval;
+}
+
+
+unsigned int BotLookAhead::get_max_depth() const
+{
+	return _max_depth;
+}
+
+
+// Searches depth moves ahead, which is less than _max_depth while
+// deepening under a node limit
+void BotLookAhead::start_search(unsigned int depth)
 {
-	_current_depth = _depth;
-	BotBase::on_cmd_game_turn(posn, status, move_count);
+	_depth = depth;
+	_current_depth = depth;
+	BotBase::start_search(depth);
 }
 
 
@@ -67,6 +109,9 @@ void BotLookAhead::find_best_move(GameBoard *board, unsigned int player,
 	// Abort if it's not my turn anymore (undo/etc)
 	if (!is_still_my_turn()) return;
 
+	if (_linear_eval && _current_depth == _depth)
+		_linear_eval->refresh(*board, &_accumulators[_depth]);
+
 	_scratch_moves[_current_depth-1].clear();
 	_scratch_moves[_current_depth-1].reserve(10);
 
@@ -90,10 +135,21 @@ long BotLookAhead::score_move_recurse(GameBoard *board, unsigned int player,
 
 	board->move_peg(front, back);
 
+	if (_linear_eval)
+		_linear_eval->move_peg(board->get_num_players(),
+							   _accumulators[_current_depth],
+							   (*board)[back]->get_current_player(),
+							   front, back,
+							   &_accumulators[_current_depth - 1]);
+
+	_move_cache.make_move(front, back);
+
 	long total_score = score_this_move(board, player, move);
 
-	if (total_score > 9000 /* || total_score < -100*/)
+	// Finishing ends the search
+	if (board->player_finished(player))
 	{
+		_move_cache.unmake_move();
 		board->move_peg(back, front);
 		return total_score * _current_depth;
 	}
@@ -111,12 +167,13 @@ long BotLookAhead::score_move_recurse(GameBoard *board, unsigned int player,
 		find_best_move(board, player, &(_scratch_best_moves[_current_depth]),
 					   &best_score);
 
-		if (_depth - _current_depth <= 2)
+		if (_depth - _current_depth <= 2 && _pump_events)
 			util::delay_ms(0); // Let the client process events between move
 
 		// Abort if it's not my turn anymore (undo/etc)
 		if (!is_still_my_turn())
 		{
+			_move_cache.unmake_move();
 			board->move_peg(back, front);
 			return total_score + best_score;
 		}
@@ -126,6 +183,7 @@ long BotLookAhead::score_move_recurse(GameBoard *board, unsigned int player,
 		_current_depth++;
 	}
 
+	_move_cache.unmake_move();
 	board->move_peg(back, front);
 
 	return total_score;
@@ -138,17 +196,33 @@ long BotLookAhead::score_this_move(GameBoard *board,
 {
 	unsigned int front = move->front();
 	unsigned int back = move->back();
-	unsigned int goal = board->get_goal(player);
+	long total_score;
+
+	if (_linear_eval)
+	{
+		unsigned int num_players = board->get_num_players();
 
-	long from_dist = (long)(50 * board->get_distance(front, goal) + 0.5);
-	long to_dist = (long)(50 * board->get_distance(back, goal) + 0.5);
+		total_score = _linear_eval->get_score(num_players, player,
+			_accumulators[_current_depth - 1]) -
+			_linear_eval->get_score(num_players, player,
+			_accumulators[_current_depth]);
+	}
+	else
+	{
+		unsigned int goal = board->get_goal(player);
 
-	long total_score = from_dist - to_dist;
+		long from_dist = (long)(_distance_weight *
+			board->get_distance(front, goal) + 0.5);
+		long to_dist = (long)(_distance_weight *
+			board->get_distance(back, goal) + 0.5);
+
+		total_score = from_dist - to_dist;
+	}
 
 	if (board->player_finished(player))
-	    total_score += 10000 + (2000 * _current_depth);
+	    total_score += _finish_bonus + (_finish_depth_bonus * _current_depth);
 	else if (_current_depth == _depth && is_blocking_pegs(board, player))
-		total_score -= 5000;
+		total_score -= _blocking_penalty;
 
 	return total_score;
 }
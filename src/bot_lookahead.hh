@@ -22,6 +22,7 @@
 #define _BOT_LOOKAHEAD_HH
 
 #include "bot_base.hh"
+#include "linear_eval.hh"
 
 
 class BotLookAhead : public BotBase
@@ -37,11 +38,14 @@ class BotLookAhead : public BotBase
 								MoveList *move);
 
 		virtual Glib::ustring get_default_name() const;
+		virtual Glib::ustring get_type() const;
+		virtual unsigned int get_max_depth() const;
+		virtual void set_weights(const EvalWeights& weights);
+		virtual void get_weights(EvalWeights *weights) const;
+		virtual void set_linear_eval(const LinearEval *eval);
 
 	protected:
-		virtual void on_cmd_game_turn(unsigned int posn, 
-									  GameServer::GameStatus status,
-									  unsigned int move_count);
+		virtual void start_search(unsigned int depth);
 
 		virtual long score_move_recurse(GameBoard *board, unsigned int player,
 										MoveList *move);
@@ -50,9 +54,20 @@ class BotLookAhead : public BotBase
 									 unsigned int player,
 									 MoveList *move);
 
+		unsigned int	_max_depth;
 		unsigned int	_depth;
 		unsigned int	_current_depth;
 
+		long			_distance_weight;
+		long			_finish_bonus;
+		long			_finish_depth_bonus;
+		long			_blocking_penalty;
+
+		// The linear evaluation of the board before the move at each
+		// depth, so unmaking a move needs no work
+		const LinearEval	*_linear_eval;
+		std::vector<LinearEval::Accumulator>	_accumulators;
+
 		std::vector<MoveList>	_scratch_moves;
 		std::vector< std::vector<MoveList> >	_scratch_best_moves;
 };
@@ -18,6 +18,7 @@
  */
  
 #include "bot_mean.hh"
+#include "utility.hh"
 
 
 BotMean::BotMean(unsigned int depth) : BotFriendly(depth)
@@ -28,7 +29,7 @@ BotMean::BotMean(unsigned int depth) : BotFriendly(depth)
 
 Glib::ustring BotMean::get_default_name() const
 {
-	switch (_depth)
+	switch (_max_depth)
 	{
 		case 1:
 			return "Mean";
@@ -44,6 +45,12 @@ Glib::ustring BotMean::get_default_name() const
 }
 
 
+Glib::ustring BotMean::get_type() const
+{
+	return "m" + util::to_str(get_max_depth());
+}
+
+
 void BotMean::find_best_move(GameBoard *board, unsigned int player,
 							 std::vector<MoveList> *best_moves,
 							 long *best_score)
@@ -29,6 +29,7 @@ class BotMean : public BotFriendly
 		BotMean(unsigned int depth);
 
 		virtual Glib::ustring get_default_name() const;
+		virtual Glib::ustring get_type() const;
 
 	protected:
                 //virtual long score_this_move(GameBoard *board, 
@@ -0,0 +1,289 @@
+/*
+ *  A fixed set of worker threads that runs the searches of many bots,
+ *  sharing the threads out fairly among their games.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include <climits>
+#include <glibmm/timer.h>
+
+#include "bot_pool.hh"
+#include "bot_base.hh"
+
+
+BotPool::BotPool(unsigned int num_threads, unsigned int max_queued)
+	:_max_queued(max_queued),
+	 _stopping(false)
+{
+	_dispatcher.connect(sigc::mem_fun(*this, &BotPool::on_jobs_done));
+
+	for (unsigned int t = 0; t < num_threads; t++)
+		_threads.push_back(Glib::Thread::create(sigc::mem_fun(*this,
+			&BotPool::run_worker), true));
+}
+
+
+BotPool::~BotPool()
+{
+	{
+		Glib::Mutex::Lock lock(_mutex);
+
+		_stopping = true;
+		for (std::list<Job*>::iterator j = _running.begin();
+			 j != _running.end(); j++)
+			(*j)->bot->abort_search();
+		_cond.broadcast();
+	}
+
+	for (unsigned int t = 0; t < _threads.size(); t++)
+		_threads[t]->join();
+
+	std::list<Job*> jobs;
+	jobs.splice(jobs.end(), _queued);
+	jobs.splice(jobs.end(), _done);
+
+	for (std::list<Job*>::iterator j = jobs.begin(); j != jobs.end(); j++)
+	{
+		delete (*j)->board;
+		delete *j;
+	}
+}
+
+
+bool BotPool::submit(BotBase *bot, const GameBoard& board,
+					 unsigned int player, unsigned int game, int priority,
+					 unsigned int turn)
+{
+	Glib::Mutex::Lock lock(_mutex);
+
+	if (_queued.size() >= _max_queued || _threads.empty())
+		return false;
+
+	Job *job = new Job;
+	job->bot = bot;
+	job->board = new GameBoard(board);
+	job->player = player;
+	job->game = game;
+	job->priority = priority;
+	job->turn = turn;
+	job->cancelled = false;
+	job->best_score = LONG_MIN;
+
+	_queued.push_back(job);
+	_cond.signal();
+
+	return true;
+}
+
+
+void BotPool::cancel(BotBase *bot)
+{
+	Glib::Mutex::Lock lock(_mutex);
+
+	for (std::list<Job*>::iterator j = _queued.begin(); j != _queued.end(); )
+		if ((*j)->bot == bot)
+		{
+			delete (*j)->board;
+			delete *j;
+			j = _queued.erase(j);
+		}
+		else
+			j++;
+
+	for (std::list<Job*>::iterator j = _running.begin();
+		 j != _running.end(); j++)
+		if ((*j)->bot == bot)
+			(*j)->cancelled = true;
+
+	for (std::list<Job*>::iterator j = _done.begin(); j != _done.end(); j++)
+		if ((*j)->bot == bot)
+			(*j)->cancelled = true;
+}
+
+
+// A bot is busy until its last search has been handed back, so it can't
+// be deleted before then
+bool BotPool::is_busy(BotBase *bot)
+{
+	Glib::Mutex::Lock lock(_mutex);
+
+	for (std::list<Job*>::iterator j = _queued.begin(); j != _queued.end();
+		 j++)
+		if ((*j)->bot == bot)
+			return true;
+
+	for (std::list<Job*>::iterator j = _running.begin();
+		 j != _running.end(); j++)
+		if ((*j)->bot == bot)
+			return true;
+
+	for (std::list<Job*>::iterator j = _done.begin(); j != _done.end(); j++)
+		if ((*j)->bot == bot)
+			return true;
+
+	return false;
+}
+
+
+void BotPool::forget_game(unsigned int game)
+{
+	Glib::Mutex::Lock lock(_mutex);
+	_game_time.erase(game);
+}
+
+
+unsigned int BotPool::get_num_threads() const
+{
+	return _threads.size();
+}
+
+
+unsigned int BotPool::get_num_queued()
+{
+	Glib::Mutex::Lock lock(_mutex);
+	return _queued.size();
+}
+
+
+unsigned int BotPool::get_num_running()
+{
+	Glib::Mutex::Lock lock(_mutex);
+	return _running.size();
+}
+
+
+void BotPool::run_worker()
+{
+	for (;;)
+	{
+		Job *job;
+
+		{
+			Glib::Mutex::Lock lock(_mutex);
+
+			while (!_stopping && !(job = next_job()))
+				_cond.wait(_mutex);
+
+			if (_stopping)
+				return;
+		}
+
+		Glib::Timer timer;
+
+		job->bot->think(job->board, job->player, &job->best_moves,
+						&job->best_score);
+		timer.stop();
+
+		{
+			Glib::Mutex::Lock lock(_mutex);
+
+			_game_time[job->game] += timer.elapsed();
+			_running.remove(job);
+			_done.push_back(job);
+
+			// A job for the same bot may have been waiting for this one
+			_cond.broadcast();
+		}
+
+		_dispatcher();
+	}
+}
+
+
+// Takes the next job off the queue: the highest priority, then the game
+// with the fewest searches running and the least time searched, then the
+// oldest.  A bot only searches one position at a time, so jobs for bots
+// already searching wait.  Called with the lock held.
+BotPool::Job *BotPool::next_job()
+{
+	std::list<Job*>::iterator best = _queued.end();
+	unsigned int best_running = 0;
+
+	for (std::list<Job*>::iterator j = _queued.begin(); j != _queued.end();
+		 j++)
+	{
+		if (is_running((*j)->bot))
+			continue;
+
+		unsigned int running = count_running((*j)->game);
+
+		if (best == _queued.end() ||
+			(*j)->priority > (*best)->priority ||
+			((*j)->priority == (*best)->priority &&
+			 (running < best_running ||
+			  (running == best_running &&
+			   _game_time[(*j)->game] < _game_time[(*best)->game]))))
+		{
+			best = j;
+			best_running = running;
+		}
+	}
+
+	if (best == _queued.end())
+		return NULL;
+
+	Job *job = *best;
+	_queued.erase(best);
+	_running.push_back(job);
+
+	return job;
+}
+
+
+bool BotPool::is_running(BotBase *bot) const
+{
+	for (std::list<Job*>::const_iterator j = _running.begin();
+		 j != _running.end(); j++)
+		if ((*j)->bot == bot)
+			return true;
+
+	return false;
+}
+
+
+unsigned int BotPool::count_running(unsigned int game) const
+{
+	unsigned int running = 0;
+
+	for (std::list<Job*>::const_iterator j = _running.begin();
+		 j != _running.end(); j++)
+		if ((*j)->game == game)
+			running++;
+
+	return running;
+}
+
+
+// Back on the main loop, hands each finished search to its bot
+void BotPool::on_jobs_done()
+{
+	std::list<Job*> done;
+
+	{
+		Glib::Mutex::Lock lock(_mutex);
+		done.swap(_done);
+	}
+
+	for (std::list<Job*>::iterator j = done.begin(); j != done.end(); j++)
+	{
+		if (!(*j)->cancelled)
+			(*j)->bot->on_search_done((*j)->turn, &(*j)->best_moves);
+
+		delete (*j)->board;
+		delete *j;
+	}
+}
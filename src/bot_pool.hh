@@ -0,0 +1,100 @@
+/*
+ *  A fixed set of worker threads that runs the searches of many bots,
+ *  sharing the threads out fairly among their games.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef INCL_BOT_POOL_HH
+#define INCL_BOT_POOL_HH
+
+#include <list>
+#include <map>
+#include <vector>
+#include <sigc++/sigc++.h>
+#include <glibmm/thread.h>
+#include <glibmm/dispatcher.h>
+
+#include "game_board.hh"
+
+class BotBase;
+
+
+// Searches wait in a queue of at most max_queued.  The next one run is
+// the oldest of the highest priority, from whichever game has had the
+// least search time so far, so one game's slow bots can't starve the
+// others.  Bots hear about finished searches back on the main loop.
+class BotPool : public sigc::trackable
+{
+public:
+	BotPool(unsigned int num_threads, unsigned int max_queued);
+	virtual ~BotPool();
+
+	// Queues a search of a copy of board, returning false if the queue
+	// is full.  Must be called from the main loop.
+	bool submit(BotBase *bot, const GameBoard& board, unsigned int player,
+				unsigned int game, int priority, unsigned int turn);
+
+	// Drops any queued searches for bot.  One already running finishes,
+	// but its bot isn't told.
+	void cancel(BotBase *bot);
+	bool is_busy(BotBase *bot);
+
+	// Forgets a game's search time, once it has no more bots
+	void forget_game(unsigned int game);
+
+	unsigned int get_num_threads() const;
+	unsigned int get_num_queued();
+	unsigned int get_num_running();
+
+private:
+	class Job
+	{
+	public:
+		BotBase					*bot;
+		GameBoard				*board;
+		unsigned int			player;
+		unsigned int			game;
+		int						priority;
+		unsigned int			turn;
+		bool					cancelled;
+		std::vector<MoveList>	best_moves;
+		long					best_score;
+	};
+
+	void run_worker();
+	Job *next_job();
+	bool is_running(BotBase *bot) const;
+	unsigned int count_running(unsigned int game) const;
+	void on_jobs_done();
+
+	std::vector<Glib::Thread*>	_threads;
+	unsigned int				_max_queued;
+
+	Glib::Mutex					_mutex;
+	Glib::Cond					_cond;
+	bool						_stopping;
+	std::list<Job*>				_queued;
+	std::list<Job*>				_running;
+	std::list<Job*>				_done;
+
+	// Seconds of searching done for each game
+	std::map<unsigned int, double>	_game_time;
+
+	Glib::Dispatcher			_dispatcher;
+};
+
+#endif   // #ifndef INCL_BOT_POOL_HH
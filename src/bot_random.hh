@@ -30,6 +30,7 @@ class BotRandom : public BotBase
 								MoveList *move);
 
 		virtual Glib::ustring get_default_name() const {return "Randy";}
+		virtual Glib::ustring get_type() const {return "r";}
 };
 
 #endif // _BOT_RANDOM_HH
@@ -30,6 +30,7 @@ class BotSimple : public BotBase
 								MoveList *move);
 
 		virtual Glib::ustring get_default_name() const {return "Chong";}
+		virtual Glib::ustring get_type() const {return "s";}
 };
 
 #endif // _BOT_SIMPLE_HH
@@ -22,6 +22,7 @@
 #include <gtkmm/main.h>
 #include <glib/gi18n.h>
 #include <glibmm/optioncontext.h>
+#include <glibmm/thread.h>
 
 #include "config.h"
 #include "prefs.hh"
@@ -173,6 +174,10 @@ int main(int argc, char **argv)
 	textdomain (GETTEXT_PACKAGE);
 #endif //ENABLE_NLS
 
+	// Hints are worked out in their own thread
+	if (!Glib::thread_supported())
+		Glib::thread_init();
+
 	gnet_init();
 
 	process_options(argc, argv);
@@ -24,22 +24,69 @@
 #include <glib/gi18n.h>
 #include <glibmm/main.h>
 #include <glibmm/optioncontext.h>
+#include <glibmm/timer.h>
+#include <glibmm/thread.h>
+#include <glibmm/iochannel.h>
 #include <sigc++/bind.h>
 #include <gnet-2.0/gnet.h>
 
 #include "utility.hh"
 #include "bot_base.hh"
+#include "opening_book.hh"
+#include "self_play.hh"
+#include "eval_weights.hh"
+#include "eval_tuner.hh"
+#include "linear_eval.hh"
+#include "search_stats.hh"
 
 
 // cheechbot Options
 Glib::ustring host_name;
 int port;
+int room;
 Glib::ustring name;
 int color;
 Glib::ustring bot_type;
 int thinking_delay;
 int move_step_delay;
 int move_done_delay;
+Glib::ustring book_file;
+Glib::ustring make_book_file;
+int book_plies;
+int book_games;
+int num_players;
+bool long_jumps;
+bool hop_others;
+bool stop_others;
+int node_limit;
+bool calibrate;
+bool analyze;
+int analysis_moves;
+Glib::ustring analyze_file_name;
+int num_jobs;
+Glib::ustring output_format;
+Glib::ustring self_play_file;
+int self_play_games;
+int random_plies = -1;
+Glib::ustring weights_file;
+Glib::ustring tune_file;
+int tune_games;
+int tune_passes;
+EvalWeights weights;
+bool use_linear_eval;
+Glib::ustring linear_weights_file;
+Glib::ustring save_linear_weights_file;
+bool bench_eval;
+LinearEval *linear_eval = NULL;
+bool show_stats;
+SearchStats stats;
+
+// Positions for --analyze-file, shared out among the worker threads
+std::vector<Glib::ustring> batch_positions;
+std::vector< std::vector<BotBase::MoveAnalysis> > batch_results;
+std::vector<unsigned int> batch_players;
+unsigned int batch_next;
+Glib::Mutex batch_mutex;
 
 
 void printMessage(Glib::ustring msg)
@@ -48,6 +95,46 @@ void printMessage(Glib::ustring msg)
 }
 
 
+Glib::ustring move_to_str(const MoveList& move)
+{
+	Glib::ustring str;
+
+	for (MoveList::const_iterator h = move.begin(); h != move.end(); h++)
+		str += ((h == move.begin()) ? "" : "-") + util::to_str(*h);
+
+	return str;
+}
+
+
+void print_analysis(unsigned int player,
+					std::vector<BotBase::MoveAnalysis> *analysis)
+{
+	std::cout << "Player " << player << " to move:" << std::endl;
+
+	for (unsigned int i = 0; i < analysis->size(); i++)
+	{
+		BotBase::MoveAnalysis& a = (*analysis)[i];
+
+		std::cout << "  " << i + 1 << ". " << move_to_str(a.move)
+			<< "  (" << a.score << ")";
+		for (std::vector<MoveList>::iterator m = a.pv.begin();
+			 m != a.pv.end(); m++)
+			std::cout << " " << move_to_str(*m);
+		std::cout << std::endl;
+	}
+}
+
+
+void print_stats(std::ostream& out)
+{
+	if (!show_stats)
+		return;
+
+	out << "Search statistics: ";
+	stats.print(out);
+}
+
+
 void connected()
 {
 	std::cout << "Connected." << std::endl;
@@ -74,6 +161,278 @@ void disconnected(BotBase *bot, Glib::RefPtr<Glib::MainLoop> m)
 }
 
 
+// Times a few seconds of self-play from the starting position, to show
+// how many nodes per second this machine searches, and so what --nodes
+// limit gives a bot the move times wanted here.
+void calibrate_bot(BotBase *bot)
+{
+	GameBoard board(num_players, long_jumps, hop_others, stop_others);
+	Glib::Timer timer;
+	unsigned long nodes = 0;
+	unsigned int searches = 0;
+	unsigned int player = 1;
+
+	std::cout << "Calibrating " << bot->get_default_name() << "... "
+		<< std::flush;
+
+	timer.start();
+	while (timer.elapsed() < 3.0 || searches == 0)
+	{
+		std::vector<MoveList> best_moves;
+		long best_score = LONG_MIN;
+
+		bot->think(&board, player, &best_moves, &best_score);
+		nodes += bot->get_nodes();
+		searches++;
+
+		if (best_moves.empty() || board.game_finished())
+		{
+			board.reset_board();
+			player = 1;
+			continue;
+		}
+
+		board.move_peg(best_moves[0].front(), best_moves[0].back());
+		player = board.get_next_player(player);
+	}
+	timer.stop();
+
+	double seconds = timer.elapsed();
+
+	std::cout << nodes << " nodes in " << searches << " moves took "
+		<< seconds << " seconds." << std::endl;
+	std::cout << (unsigned long)(nodes / seconds) << " nodes/sec, "
+		<< nodes / searches << " nodes and "
+		<< (unsigned long)(1000 * seconds / searches) << " ms per move."
+		<< std::endl;
+}
+
+
+// Times the linear evaluation's incremental updates against summing the
+// whole board, then how fast the bot searches with each evaluation.
+void bench_linear_eval(BotBase *bot)
+{
+	const unsigned int UPDATES = 10000000;
+	const unsigned int REFRESHES = 1000000;
+
+	GameBoard board(num_players, long_jumps, hop_others, stop_others);
+	LinearEval::Accumulator acc, next;
+	std::vector<unsigned int> holes;
+	Glib::Timer timer;
+
+	// Keeps the compiler from skipping the work
+	volatile gint32 total = 0;
+
+	for (unsigned int h = 0; h < GameBoard::SIZE; h++)
+		if (board[h])
+			holes.push_back(h);
+
+	linear_eval->refresh(board, &acc);
+
+	timer.start();
+	for (unsigned int i = 0; i < UPDATES; i += 2)
+	{
+		unsigned int owner = (i / 2) % num_players + 1;
+		unsigned int from = holes[(i * 7) % holes.size()];
+		unsigned int to = holes[(i * 13 + 5) % holes.size()];
+
+		// There and back again, so the values stay the same
+		linear_eval->move_peg(num_players, acc, owner, from, to, &next);
+		linear_eval->move_peg(num_players, next, owner, to, from, &acc);
+		total += next.values[0];
+	}
+	timer.stop();
+
+	double update_ns = 1e9 * timer.elapsed() / UPDATES;
+
+	timer.start();
+	for (unsigned int i = 0; i < REFRESHES; i++)
+	{
+		linear_eval->refresh(board, &acc);
+		total += acc.values[0];
+	}
+	timer.stop();
+
+	double refresh_ns = 1e9 * timer.elapsed() / REFRESHES;
+
+	std::cout << "Linear evaluation (" << LinearEval::get_simd_name()
+		<< "): " << update_ns << " ns per move, " << refresh_ns
+		<< " ns per whole board." << std::endl;
+
+	std::cout << "Usual evaluation: ";
+	bot->set_linear_eval(NULL);
+	calibrate_bot(bot);
+
+	std::cout << "Linear evaluation: ";
+	bot->set_linear_eval(linear_eval);
+	calibrate_bot(bot);
+}
+
+
+void analyze_positions(BotBase *bot)
+{
+	GameBoard board(2, false, false, false);
+
+	for (;;)
+	{
+		unsigned int i;
+
+		{
+			Glib::Mutex::Lock lock(batch_mutex);
+			if (batch_next >= batch_positions.size())
+				return;
+			i = batch_next++;
+		}
+
+		unsigned int to_move;
+		if (!board.set_position(batch_positions[i], &to_move))
+			continue;
+
+		batch_players[i] = to_move;
+		bot->analyze(&board, to_move, analysis_moves, &(batch_results[i]));
+	}
+}
+
+
+void print_batch_csv()
+{
+	std::cout << "position,rank,move,score,pv" << std::endl;
+
+	for (unsigned int i = 0; i < batch_positions.size(); i++)
+		for (unsigned int r = 0; r < batch_results[i].size(); r++)
+		{
+			BotBase::MoveAnalysis& a = batch_results[i][r];
+
+			std::cout << batch_positions[i] << "," << r + 1 << ","
+				<< move_to_str(a.move) << "," << a.score << ",";
+			for (std::vector<MoveList>::iterator m = a.pv.begin();
+				 m != a.pv.end(); m++)
+				std::cout << ((m == a.pv.begin()) ? "" : " ")
+					<< move_to_str(*m);
+			std::cout << std::endl;
+		}
+}
+
+
+Glib::ustring move_to_json(const MoveList& move)
+{
+	Glib::ustring str = "[";
+
+	for (MoveList::const_iterator h = move.begin(); h != move.end(); h++)
+		str += ((h == move.begin()) ? "" : ",") + util::to_str(*h);
+
+	return str + "]";
+}
+
+
+void print_batch_json()
+{
+	bool first = true;
+
+	std::cout << "[";
+
+	for (unsigned int i = 0; i < batch_positions.size(); i++)
+	{
+		if (!batch_players[i])
+			continue;
+
+		std::cout << (first ? "" : ",") << std::endl
+			<< "{\"position\": \"" << batch_positions[i] << "\", "
+			<< "\"player\": " << batch_players[i] << ", \"moves\": [";
+
+		for (unsigned int r = 0; r < batch_results[i].size(); r++)
+		{
+			BotBase::MoveAnalysis& a = batch_results[i][r];
+
+			std::cout << ((r == 0) ? "" : ", ")
+				<< "{\"move\": " << move_to_json(a.move)
+				<< ", \"score\": " << a.score << ", \"pv\": [";
+			for (std::vector<MoveList>::iterator m = a.pv.begin();
+				 m != a.pv.end(); m++)
+				std::cout << ((m == a.pv.begin()) ? "" : ",")
+					<< move_to_json(*m);
+			std::cout << "]}";
+		}
+		std::cout << "]}";
+		first = false;
+	}
+
+	std::cout << std::endl << "]" << std::endl;
+}
+
+
+// Analyzes every position in a file, one per line, with num_jobs bots
+// in their own threads, then prints the results in the same order.
+bool analyze_file(BotBase *bot, const Glib::ustring& filename)
+{
+	Glib::RefPtr<Glib::IOChannel> pfile;
+
+	try
+	{
+		pfile = Glib::IOChannel::create_from_file(filename, "r");
+	}
+	catch (Glib::FileError)
+	{
+		std::cerr << "Can't read positions from '"
+			<< filename << "'." << std::endl;
+		return false;
+	}
+
+	Glib::ustring line;
+	while (pfile->read_line(line) == Glib::IO_STATUS_NORMAL)
+	{
+		util::trim(line);
+		if (!line.empty() && line[0] != '#')
+			batch_positions.push_back(line);
+	}
+	pfile->close();
+
+	batch_results.resize(batch_positions.size());
+	batch_players.assign(batch_positions.size(), 0);
+	batch_next = 0;
+
+	std::vector<BotBase*> bots(1, bot);
+	std::vector<Glib::Thread*> threads;
+
+	for (int j = 1; j < num_jobs; j++)
+		bots.push_back(BotBase::new_bot_of_type(bot_type));
+
+	for (unsigned int j = 0; j < bots.size(); j++)
+	{
+		bots[j]->set_pump_events(false);
+		bots[j]->set_weights(weights);
+		bots[j]->set_linear_eval(linear_eval);
+		if (show_stats)
+			bots[j]->set_stats(&stats);
+		if (node_limit > 0)
+			bots[j]->set_node_limit(node_limit);
+		threads.push_back(Glib::Thread::create(sigc::bind(
+			sigc::ptr_fun(analyze_positions), bots[j]), true));
+	}
+
+	for (unsigned int j = 0; j < threads.size(); j++)
+		threads[j]->join();
+
+	for (unsigned int j = 1; j < bots.size(); j++)
+		delete bots[j];
+
+	for (unsigned int i = 0; i < batch_positions.size(); i++)
+		if (!batch_players[i])
+			std::cerr << "Couldn't read position '"
+				<< batch_positions[i] << "'." << std::endl;
+
+	if (output_format == "json")
+		print_batch_json();
+	else
+		print_batch_csv();
+
+	// Kept off stdout, which has the results
+	print_stats(std::cerr);
+
+	return true;
+}
+
+
 void process_options(int &argc, char **&argv)
 {
 	try
@@ -90,6 +449,14 @@ void process_options(int &argc, char **&argv)
 			"port of the cheech server to connect to (3838)");
 		opt_group.add_entry(opt_port, port);
 
+		Glib::OptionEntry opt_room;
+		opt_room.set_long_name("room");
+		opt_room.set_short_name('r');
+		opt_room.set_arg_description("room");
+		opt_room.set_description(
+			"room to join, if the server hosts several games (the first)");
+		opt_group.add_entry(opt_room, room);
+
 		Glib::OptionEntry opt_name;
 		opt_name.set_long_name("name");
 		opt_name.set_short_name('n');
@@ -139,6 +506,203 @@ void process_options(int &argc, char **&argv)
 			"time to show each completed move in ms (600)");
 		opt_group.add_entry(opt_move_delay, move_done_delay);
 
+		Glib::OptionEntry opt_nodes;
+		opt_nodes.set_long_name("nodes");
+		opt_nodes.set_arg_description("num");
+		opt_nodes.set_description(
+			"search about this many moves per turn, whatever the depth "
+			"(no limit)");
+		opt_group.add_entry(opt_nodes, node_limit);
+
+		Glib::OptionEntry opt_calibrate;
+		opt_calibrate.set_long_name("calibrate");
+		opt_calibrate.set_description(
+			"measure how many nodes/sec this bot searches here, then exit");
+		opt_group.add_entry(opt_calibrate, calibrate);
+
+		Glib::OptionEntry opt_stats;
+		opt_stats.set_long_name("stats");
+		opt_stats.set_description(
+			"print each search's depth, nodes and time, and think time "
+			"percentiles at exit or on SIGUSR1");
+		opt_group.add_entry(opt_stats, show_stats);
+
+		Glib::OptionEntry opt_analyze;
+		opt_analyze.set_long_name("analyze");
+		opt_analyze.set_short_name('a');
+		opt_analyze.set_description(
+			"watch the game, printing the best moves each turn");
+		opt_group.add_entry(opt_analyze, analyze);
+
+		Glib::OptionEntry opt_top;
+		opt_top.set_long_name("top");
+		opt_top.set_arg_description("num");
+		opt_top.set_description(
+			"how many moves to print each turn when analyzing (3)");
+		opt_group.add_entry(opt_top, analysis_moves);
+
+		Glib::OptionEntry opt_analyze_file;
+		opt_analyze_file.set_long_name("analyze-file");
+		opt_analyze_file.set_arg_description("file");
+		opt_analyze_file.set_description(
+			"analyze each position in this file (one per line), print the "
+			"results, then exit");
+		opt_group.add_entry(opt_analyze_file, analyze_file_name);
+
+		Glib::OptionEntry opt_jobs;
+		opt_jobs.set_long_name("jobs");
+		opt_jobs.set_short_name('j');
+		opt_jobs.set_arg_description("num");
+		opt_jobs.set_description(
+			"how many positions to analyze (1) or games to play or "
+			"tune with (one per CPU) at once");
+		opt_group.add_entry(opt_jobs, num_jobs);
+
+		Glib::OptionEntry opt_format;
+		opt_format.set_long_name("format");
+		opt_format.set_arg_description("csv|json");
+		opt_format.set_description(
+			"how to print the results of --analyze-file (csv)");
+		opt_group.add_entry(opt_format, output_format);
+
+		Glib::OptionEntry opt_self_play;
+		opt_self_play.set_long_name("self-play");
+		opt_self_play.set_arg_description("file");
+		opt_self_play.set_description(
+			"write training records from games of self-play to this file, "
+			"then exit");
+		opt_group.add_entry(opt_self_play, self_play_file);
+
+		Glib::OptionEntry opt_games;
+		opt_games.set_long_name("games");
+		opt_games.set_arg_description("num");
+		opt_games.set_description(
+			"how many games of self-play to play (100)");
+		opt_group.add_entry(opt_games, self_play_games);
+
+		Glib::OptionEntry opt_random_plies;
+		opt_random_plies.set_long_name("random-plies");
+		opt_random_plies.set_arg_description("num");
+		opt_random_plies.set_description(
+			"how many random moves start each game of self-play (4)");
+		opt_group.add_entry(opt_random_plies, random_plies);
+
+		Glib::OptionEntry opt_weights;
+		opt_weights.set_long_name("weights");
+		opt_weights.set_short_name('w');
+		opt_weights.set_arg_description("file");
+		opt_weights.set_description(
+			"evaluate moves with the weights in this file");
+		opt_group.add_entry(opt_weights, weights_file);
+
+		Glib::OptionEntry opt_linear;
+		opt_linear.set_long_name("linear");
+		opt_linear.set_description(
+			"evaluate moves with a weight for each player's pegs in each hole");
+		opt_group.add_entry(opt_linear, use_linear_eval);
+
+		Glib::OptionEntry opt_linear_weights;
+		opt_linear_weights.set_long_name("linear-weights");
+		opt_linear_weights.set_arg_description("file");
+		opt_linear_weights.set_description(
+			"use --linear with the hole weights in this file");
+		opt_group.add_entry(opt_linear_weights, linear_weights_file);
+
+		Glib::OptionEntry opt_save_linear;
+		opt_save_linear.set_long_name("save-linear-weights");
+		opt_save_linear.set_arg_description("file");
+		opt_save_linear.set_description(
+			"write the --linear hole weights to this file, then exit");
+		opt_group.add_entry(opt_save_linear, save_linear_weights_file);
+
+		Glib::OptionEntry opt_bench_eval;
+		opt_bench_eval.set_long_name("bench-eval");
+		opt_bench_eval.set_description(
+			"compare the speed of the usual and --linear evaluations, "
+			"then exit");
+		opt_group.add_entry(opt_bench_eval, bench_eval);
+
+		Glib::OptionEntry opt_tune;
+		opt_tune.set_long_name("tune");
+		opt_tune.set_arg_description("file");
+		opt_tune.set_description(
+			"tune the bot's weights by self-play, writing them to this file, "
+			"then exit");
+		opt_group.add_entry(opt_tune, tune_file);
+
+		Glib::OptionEntry opt_tune_games;
+		opt_tune_games.set_long_name("tune-games");
+		opt_tune_games.set_arg_description("num");
+		opt_tune_games.set_description(
+			"how many games to play to try out each change of weight (40)");
+		opt_group.add_entry(opt_tune_games, tune_games);
+
+		Glib::OptionEntry opt_tune_passes;
+		opt_tune_passes.set_long_name("tune-passes");
+		opt_tune_passes.set_arg_description("num");
+		opt_tune_passes.set_description(
+			"how many times to try changing each weight (4)");
+		opt_group.add_entry(opt_tune_passes, tune_passes);
+
+		Glib::OptionEntry opt_book;
+		opt_book.set_long_name("book");
+		opt_book.set_short_name('b');
+		opt_book.set_arg_description("file");
+		opt_book.set_description(
+			"play opening moves from this opening book");
+		opt_group.add_entry(opt_book, book_file);
+
+		Glib::OptionEntry opt_make_book;
+		opt_make_book.set_long_name("make-book");
+		opt_make_book.set_arg_description("file");
+		opt_make_book.set_description(
+			"add openings for the given rules to this book by self-play, "
+			"then exit");
+		opt_group.add_entry(opt_make_book, make_book_file);
+
+		Glib::OptionEntry opt_book_plies;
+		opt_book_plies.set_long_name("book-plies");
+		opt_book_plies.set_arg_description("num");
+		opt_book_plies.set_description(
+			"how many moves deep the opening book goes (12)");
+		opt_group.add_entry(opt_book_plies, book_plies);
+
+		Glib::OptionEntry opt_book_games;
+		opt_book_games.set_long_name("book-games");
+		opt_book_games.set_arg_description("num");
+		opt_book_games.set_description(
+			"how many self-play games to build the opening book from (8)");
+		opt_group.add_entry(opt_book_games, book_games);
+
+		Glib::OptionEntry opt_num_players;
+		opt_num_players.set_long_name("num-players");
+		opt_num_players.set_short_name('N');
+		opt_num_players.set_arg_description("num");
+		opt_num_players.set_description(
+			"how many players to make a book or calibrate for (2)");
+		opt_group.add_entry(opt_num_players, num_players);
+
+		Glib::OptionEntry opt_long_jumps;
+		opt_long_jumps.set_long_name("long-jumps");
+		opt_long_jumps.set_short_name('L');
+		opt_long_jumps.set_description(
+			"allow long jumps (default=no)");
+		opt_group.add_entry(opt_long_jumps, long_jumps);
+
+		Glib::OptionEntry opt_hop_others;
+		opt_hop_others.set_long_name("hop-others");
+		opt_hop_others.set_short_name('H');
+		opt_hop_others.set_description(
+			"allow hopping through other players' triangles (default=no)");
+		opt_group.add_entry(opt_hop_others, hop_others);
+
+		Glib::OptionEntry opt_stop_others;
+		opt_stop_others.set_long_name("stop-others");
+		opt_stop_others.set_short_name('O');
+		opt_stop_others.set_description(
+			"allow stopping in other players' triangles (default=no)");
+		opt_group.add_entry(opt_stop_others, stop_others);
+
 		opt_context.set_main_group(opt_group);
 
 		opt_context.parse(argc, argv);
@@ -157,10 +721,27 @@ void process_options(int &argc, char **&argv)
 	if (thinking_delay == 0) thinking_delay = 0;
 	if (move_step_delay == 0) move_step_delay = 300;
 	if (move_done_delay == 0) move_done_delay = 600;
+	if (analysis_moves <= 0) analysis_moves = 3;
+	if (num_jobs < 1)
+		num_jobs = (analyze_file_name != "") ? 1 : util::get_num_cpus();
+	if (self_play_games <= 0) self_play_games = 100;
+	if (tune_games <= 0) tune_games = 40;
+	if (tune_passes <= 0) tune_passes = 4;
+	if (random_plies < 0) random_plies = 4;
+	if (output_format == "") output_format = "csv";
+	if (book_plies == 0) book_plies = 12;
+	if (book_games == 0) book_games = 8;
+	if (num_players < 1) num_players = 2;
+	if (num_players > 6) num_players = 6;
 
 	host_name = "";
 	if (argc == 2)
 		host_name = argv[1];
+	else if (argc == 1 && (make_book_file != "" || calibrate ||
+						   analyze_file_name != "" || self_play_file != "" ||
+						   tune_file != "" || save_linear_weights_file != "" ||
+						   bench_eval))
+		return;
 	else
 	{
 		std::cout << argv[0] << ": Bad command line arguments.  "
@@ -178,6 +759,9 @@ int main(int argc, char **argv)
 	textdomain (GETTEXT_PACKAGE);
 #endif //ENABLE_NLS
 
+	if (!Glib::thread_supported())
+		Glib::thread_init();
+
 	gnet_init();
 
 	process_options(argc, argv);
@@ -193,6 +777,143 @@ int main(int argc, char **argv)
 		exit(1);
 	}
 
+	if (node_limit > 0)
+		bot->set_node_limit(node_limit);
+
+	if (show_stats)
+		bot->set_stats(&stats);
+
+	if (weights_file != "")
+	{
+		if (!weights.read(weights_file))
+		{
+			std::cout << argv[0] << ": Couldn't read weights "
+				<< weights_file << "." << std::endl;
+			exit(1);
+		}
+		bot->set_weights(weights);
+	}
+
+	if (use_linear_eval || linear_weights_file != "" ||
+		save_linear_weights_file != "" || bench_eval)
+	{
+		linear_eval = new LinearEval;
+		linear_eval->set_defaults(weights.get(EvalWeights::Distance));
+
+		if (linear_weights_file != "" &&
+			!linear_eval->read(linear_weights_file))
+		{
+			std::cout << argv[0] << ": Couldn't read linear weights "
+				<< linear_weights_file << "." << std::endl;
+			exit(1);
+		}
+
+		if (save_linear_weights_file != "")
+		{
+			bool ok = linear_eval->write(save_linear_weights_file);
+			delete bot;
+			delete linear_eval;
+			return ok ? 0 : 1;
+		}
+
+		if (bench_eval)
+		{
+			bench_linear_eval(bot);
+			delete bot;
+			delete linear_eval;
+			return 0;
+		}
+
+		bot->set_linear_eval(linear_eval);
+	}
+
+	if (tune_file != "")
+	{
+		EvalTuner tuner(bot_type, long_jumps, hop_others, stop_others);
+
+		tuner.set_node_limit((node_limit > 0) ? node_limit : 0);
+		tuner.set_random_plies(random_plies);
+		tuner.set_match_games(tune_games);
+		tuner.set_passes(tune_passes);
+
+		bool ok = tuner.run(tune_file, &weights, num_jobs);
+
+		if (ok)
+			for (unsigned int w = 0; w < EvalWeights::NumWeights; w++)
+				std::cout << EvalWeights::NAMES[w] << " "
+					<< weights.get((EvalWeights::Weight)w) << std::endl;
+
+		delete bot;
+		return ok ? 0 : 1;
+	}
+
+	if (calibrate)
+	{
+		calibrate_bot(bot);
+		print_stats(std::cout);
+		delete bot;
+		return 0;
+	}
+
+	if (self_play_file != "")
+	{
+		SelfPlay self_play(bot_type, num_players, long_jumps,
+						   hop_others, stop_others);
+
+		self_play.set_node_limit((node_limit > 0) ? node_limit : 0);
+		self_play.set_weights(weights);
+		self_play.set_linear_eval(linear_eval);
+		self_play.set_random_plies(random_plies);
+
+		std::cout << "Playing " << self_play_games << " games with "
+			<< num_jobs << " jobs... " << std::flush;
+
+		bool ok = self_play.run(self_play_file, self_play_games, num_jobs);
+
+		std::cout << self_play.get_num_records() << " positions from "
+			<< self_play.get_num_games() << " games written." << std::endl;
+		delete bot;
+		return ok ? 0 : 1;
+	}
+
+	if (analyze_file_name != "")
+	{
+		bool ok = analyze_file(bot, analyze_file_name);
+		delete bot;
+		return ok ? 0 : 1;
+	}
+
+	OpeningBook book;
+
+	if (make_book_file != "")
+	{
+		GameBoard board(num_players, long_jumps, hop_others, stop_others);
+
+		book.load(make_book_file);
+
+		std::cout << "Building opening book for " << num_players
+			<< " players from " << book_games << " games of "
+			<< book_plies << " moves... " << std::flush;
+
+		book.generate(bot, &board, book_plies, book_games);
+
+		if (!book.save(make_book_file))
+			return 1;
+
+		std::cout << book.size() << " positions in book." << std::endl;
+		delete bot;
+		return 0;
+	}
+
+	if (book_file != "")
+	{
+		if (book.load(book_file))
+			bot->set_opening_book(&book);
+		else
+			std::cout << argv[0] << ": Couldn't read opening book "
+				<< book_file << "." << std::endl;
+	}
+
 	bot->evt_message.connect(sigc::ptr_fun(printMessage));
 	bot->evt_connected.connect(sigc::ptr_fun(connected));
 	bot->evt_cancelled.connect(sigc::bind(sigc::bind(sigc::ptr_fun(cancelled),
@@ -200,15 +921,33 @@ int main(int argc, char **argv)
 	bot->evt_disconnected.connect(sigc::bind(sigc::bind(sigc::ptr_fun(disconnected),
 		m), bot));
 
-	std::cout << "Chinese Checkers Bot joining game on " << host_name;
+	if (analyze)
+	{
+		bot->evt_analysis.connect(sigc::ptr_fun(print_analysis));
+		bot->set_analysis_moves(analysis_moves);
+		std::cout << "Chinese Checkers Bot watching game on " << host_name;
+	}
+	else
+		std::cout << "Chinese Checkers Bot joining game on " << host_name;
 	std::cout << " port " << port << " as Chong... ";
 
 	bot->set_think_delay(thinking_delay);
 	bot->set_move_delay(move_step_delay, move_done_delay);
 	bot->set_name(name);
 	bot->set_color(color);
-	bot->join_game(host_name, port);
+	if (show_stats)
+	{
+		stats.set_log(true);
+		watch_stats_signals(m, sigc::ptr_fun(print_stats));
+	}
+
+	if (room > 0)
+		bot->get_game_client()->set_room(room);
+
+	bot->join_game(host_name, port, analyze);
 	m->run();
 
+	print_stats(std::cout);
+
 	return 0;
 }
@@ -0,0 +1,179 @@
+/*
+ *  cheechbotd bot hosting server's main.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include <iostream>
+#include <string>
+#include <config.h>
+#include <stdlib.h>
+#include <glib/gi18n.h>
+#include <glibmm/main.h>
+#include <glibmm/thread.h>
+#include <glibmm/optioncontext.h>
+#include <gnet-2.0/gnet.h>
+
+#include "utility.hh"
+#include "bot_pool.hh"
+#include "bot_host.hh"
+#include "opening_book.hh"
+#include "search_stats.hh"
+
+// cheechbotd Options
+int port;
+int num_jobs;
+int max_queued;
+int node_limit;
+Glib::ustring book_file;
+bool show_stats;
+
+SearchStats stats;
+
+
+void process_options(int &argc, char **&argv)
+{
+	try
+	{
+		Glib::OptionContext opt_context;
+		Glib::OptionGroup opt_group(
+			"cheechbotd server options", "Options defining the bot host");
+
+		Glib::OptionEntry opt_port;
+		opt_port.set_long_name("port");
+		opt_port.set_short_name('p');
+		opt_port.set_arg_description("port");
+		opt_port.set_description(
+			"port to take bot commands on (3840)");
+		opt_group.add_entry(opt_port, port);
+
+		Glib::OptionEntry opt_jobs;
+		opt_jobs.set_long_name("jobs");
+		opt_jobs.set_short_name('j');
+		opt_jobs.set_arg_description("N");
+		opt_jobs.set_description(
+			"number of threads shared by all the bots' searches (CPUs)");
+		opt_group.add_entry(opt_jobs, num_jobs);
+
+		Glib::OptionEntry opt_queue;
+		opt_queue.set_long_name("queue");
+		opt_queue.set_short_name('q');
+		opt_queue.set_arg_description("N");
+		opt_queue.set_description(
+			"searches waiting for a thread before bots move without one (256)");
+		opt_group.add_entry(opt_queue, max_queued);
+
+		Glib::OptionEntry opt_nodes;
+		opt_nodes.set_long_name("nodes");
+		opt_nodes.set_short_name('N');
+		opt_nodes.set_arg_description("N");
+		opt_nodes.set_description(
+			"limit each bot's search to about N nodes per move (no limit)");
+		opt_group.add_entry(opt_nodes, node_limit);
+
+		Glib::OptionEntry opt_book;
+		opt_book.set_long_name("book");
+		opt_book.set_short_name('b');
+		opt_book.set_arg_description("file");
+		opt_book.set_description(
+			"opening book for all the bots to play from");
+		opt_group.add_entry(opt_book, book_file);
+
+		Glib::OptionEntry opt_stats;
+		opt_stats.set_long_name("stats");
+		opt_stats.set_description(
+			"log each search, and print think time percentiles at exit or on "
+			"SIGUSR1");
+		opt_group.add_entry(opt_stats, show_stats);
+
+		opt_context.set_main_group(opt_group);
+
+		opt_context.parse(argc, argv);
+	}
+	catch (Glib::OptionError er)
+	{
+		std::cout << "Bad command line arguments.  Try cheechbotd --help"
+			<< std::endl;
+		exit(1);
+	}
+
+	// Defaults
+	if (port == 0) port = 3840;
+	if (num_jobs < 1) num_jobs = util::get_num_cpus();
+	if (max_queued < 1) max_queued = 256;
+}
+
+
+void print_stats(std::ostream& out)
+{
+	out << "Search statistics: ";
+	stats.print(out);
+}
+
+
+int main(int argc, char **argv)
+{
+#if defined(ENABLE_NLS)
+	bindtextdomain (GETTEXT_PACKAGE, PACKAGE_LOCALE_DIR);
+	bind_textdomain_codeset(GETTEXT_PACKAGE, "UTF-8");
+	textdomain (GETTEXT_PACKAGE);
+#endif //ENABLE_NLS
+
+	if (!Glib::thread_supported())
+		Glib::thread_init();
+
+	gnet_init();
+
+	process_options(argc, argv);
+
+	Glib::RefPtr<Glib::MainLoop> m = Glib::MainLoop::create();
+
+	OpeningBook book;
+
+	if (book_file != "" && !book.load(book_file))
+		std::cout << argv[0] << ": Couldn't read opening book "
+			<< book_file << "." << std::endl;
+
+	BotPool pool(num_jobs, max_queued);
+	BotHost host(&pool);
+
+	if (node_limit > 0)
+		host.set_node_limit(node_limit);
+	if (book.size())
+		host.set_opening_book(&book);
+
+	// Searches are always counted, for the status command
+	stats.set_log(show_stats);
+	host.set_stats(&stats);
+
+	if (!host.listen(port))
+	{
+		std::cout << "Failed to start cheechbotd on port "
+			<< util::to_str(port) << "." << std::endl;
+		exit(1);
+	}
+
+	std::cout << "cheechbotd running on port " << util::to_str(port)
+		<< " with " << num_jobs << " search threads..." << std::endl;
+
+	watch_stats_signals(m, sigc::ptr_fun(print_stats));
+
+	m->run();
+
+	print_stats(std::cout);
+
+	return 0;
+}
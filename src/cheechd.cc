@@ -23,14 +23,41 @@
 #include <config.h>
 #include <glib/gi18n.h>
 #include <glibmm/main.h>
+#include <glibmm/thread.h>
 #include <glibmm/iochannel.h>
 #include <glibmm/optioncontext.h>
+#include <glibmm/timer.h>
+#include <glibmm/random.h>
+#include <glibmm/miscutils.h>
 #include <sigc++/bind.h>
 #include <gnet-2.0/gnet.h>
 
+#ifndef WIN32
+#include <csignal>
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
+
+#ifdef HAVE_SYS_EPOLL_H
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <vector>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#endif
+
 #include "utility.hh"
 #include "game_server.hh"
+#include "game_lobby.hh"
 #include "ajax_server.hh"
+#include "gnet_server.hh"
+#include "game_board.hh"
+#include "proto_codec.hh"
+#include "game_journal.hh"
 
 
 // cheechd Options
@@ -40,6 +67,16 @@ int port;
 bool long_jumps;
 bool hop_others;
 bool stop_others;
+int bot_node_limit;
+int max_rooms;
+int num_threads;
+std::string journal_dir;
+std::string archive_path;
+bool bench_transport;
+bool bench_codec;
+bool bench_format;
+bool bench_journal;
+bool bench_room;
 
 bool start_cheechwebd;
 int cheechweb_port;
@@ -62,21 +99,698 @@ void gameOver(GameServer *server, Glib::RefPtr<Glib::MainLoop> m)
 }
 
 
-bool on_stdin(Glib::IOCondition condition, GameServer *server)
+bool on_stdin(Glib::IOCondition condition, GameLobby *lobby)
 {
 	std::string line;
 
 	if(!std::getline(std::cin, line))
 	{
-		server->end_game();
+		lobby->close();
 		exit(0);
 	}
 
-	server->parse_command(line);
+	lobby->parse_command(line);
+	return true;
+}
+
+
+#ifdef HAVE_SYS_EPOLL_H
+
+const unsigned int BENCH_CLIENTS = 16;
+const unsigned int BENCH_MESSAGES = 5000;
+// Each room keeps its client's socket open, so both ends of them all
+// have to fit under the usual limit of 1024 files
+const unsigned int BENCH_ROOMS = 400;
+const unsigned int BENCH_ROOM_CLIENTS = 8;
+
+
+void bench_echo(Glib::ustring line, Gnet::Conn *conn)
+{
+	*conn << line + "\n";
+}
+
+
+void bench_drop(Gnet::Conn *conn)
+{
+	delete conn;
+}
+
+
+void bench_accept(Gnet::Conn *conn)
+{
+	conn->evt_data_available.connect(sigc::bind(sigc::ptr_fun(bench_echo),
+												conn));
+	conn->evt_closed.connect(sigc::bind(sigc::ptr_fun(bench_drop), conn));
+}
+
+
+// One client, in its own thread, sending a line and waiting for it to
+// come back, over and over, timing each round trip
+void bench_client(std::vector<double> *times)
+{
+	sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port = htons(port);
+
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0)
+		return;
+	if (connect(fd, (sockaddr*)&address, sizeof(address)) < 0)
+	{
+		close(fd);
+		return;
+	}
+
+	int flag = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+
+	std::string received;
+	char buffer[256];
+	Glib::Timer timer;
+
+	for (unsigned int i = 0; i < BENCH_MESSAGES; i++)
+	{
+		std::string line = "PING " + util::to_str(i) + "\n";
+		double start = timer.elapsed();
+
+		if (send(fd, line.data(), line.length(), MSG_NOSIGNAL) !=
+			(ssize_t)line.length())
+			break;
+
+		std::string::size_type end;
+		while ((end = received.find('\n')) == std::string::npos)
+		{
+			ssize_t count = recv(fd, buffer, sizeof(buffer), 0);
+			if (count <= 0)
+				break;
+			received.append(buffer, count);
+		}
+		if (end == std::string::npos)
+			break;
+
+		received.erase(0, end + 1);
+		times->push_back(timer.elapsed() - start);
+	}
+
+	close(fd);
+}
+
+
+void bench_clients(std::vector<std::vector<double> > *times,
+				   Glib::RefPtr<Glib::MainLoop> m)
+{
+	std::vector<Glib::Thread*> threads;
+
+	for (unsigned int c = 0; c < BENCH_CLIENTS; c++)
+		threads.push_back(Glib::Thread::create(sigc::bind(
+			sigc::ptr_fun(bench_client), &(*times)[c]), true));
+
+	for (unsigned int c = 0; c < BENCH_CLIENTS; c++)
+		threads[c]->join();
+
+	m->quit();
+}
+
+
+// Echoes lines back to BENCH_CLIENTS clients in other threads, first with
+// GNet and then with epoll, reporting round trips a second and how long
+// they took
+void bench_transports(Glib::RefPtr<Glib::MainLoop> m)
+{
+	for (int native = 0; native <= 1; native++)
+	{
+		const char *name = native ? "epoll" : "GNet";
+		Gnet::Server server;
+		std::vector<std::vector<double> > times(BENCH_CLIENTS);
+		std::vector<double> all_times;
+		Glib::Timer timer;
+
+		server.set_native(native);
+		server.evt_connection_available.connect(sigc::ptr_fun(bench_accept));
+		if (!server.listen(port, true))
+		{
+			std::cout << name << ": couldn't listen on port " << port
+				<< std::endl;
+			continue;
+		}
+
+		timer.start();
+		Glib::Thread *clients = Glib::Thread::create(sigc::bind(
+			sigc::ptr_fun(bench_clients), &times, m), true);
+		m->run();
+		clients->join();
+		timer.stop();
+
+		server.close();
+		// Lets the server see the clients go
+		while (Glib::MainContext::get_default()->iteration(false));
+
+		for (unsigned int c = 0; c < BENCH_CLIENTS; c++)
+			all_times.insert(all_times.end(), times[c].begin(),
+							 times[c].end());
+		if (all_times.empty())
+		{
+			std::cout << name << ": no replies." << std::endl;
+			continue;
+		}
+		std::sort(all_times.begin(), all_times.end());
+
+		std::cout << name << ": " << all_times.size() << " round trips from "
+			<< BENCH_CLIENTS << " clients in " << timer.elapsed() << " s, "
+			<< (unsigned long)(all_times.size() / timer.elapsed())
+			<< " msgs/sec, p50 "
+			<< (unsigned long)(1e6 * all_times[all_times.size() / 2])
+			<< " us, p99 "
+			<< (unsigned long)(1e6 * all_times[all_times.size() * 99 / 100])
+			<< " us" << std::endl;
+	}
+}
+
+
+
+int bench_connect()
+{
+	sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port = htons(port);
+
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0)
+		return -1;
+	if (connect(fd, (sockaddr*)&address, sizeof(address)) < 0)
+	{
+		close(fd);
+		return -1;
+	}
+
+	int flag = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+	return fd;
+}
+
+
+// Reads lines from fd until one starts with prefix, which it puts in line.
+// False if the lobby says no, or the socket closes.
+bool bench_expect(int fd, std::string *received, const std::string& prefix,
+				  std::string *line)
+{
+	char buffer[1024];
+
+	for (;;)
+	{
+		std::string::size_type end;
+		while ((end = received->find('\n')) != std::string::npos)
+		{
+			*line = received->substr(0, end);
+			received->erase(0, end + 1);
+
+			if (line->compare(0, prefix.length(), prefix) == 0)
+				return true;
+			if (line->compare(0, 10, "ROOM_ERROR") == 0)
+				return false;
+		}
+
+		ssize_t count = recv(fd, buffer, sizeof(buffer), 0);
+		if (count <= 0)
+			return false;
+		received->append(buffer, count);
+	}
+}
+
+
+bool bench_send(int fd, const std::string& line)
+{
+	return send(fd, line.data(), line.length(), MSG_NOSIGNAL) ==
+		(ssize_t)line.length();
+}
+
+
+// One client, in its own thread, making rooms one after another and
+// sitting down in each, timing each room from connecting to being seated.
+// The sockets are left open in fds, so the rooms stay busy.
+void bench_room_client(unsigned int num_rooms, std::vector<double> *times,
+					   std::vector<int> *fds)
+{
+	Glib::Timer timer;
+
+	for (unsigned int r = 0; r < num_rooms; r++)
+	{
+		double start = timer.elapsed();
+		std::string received, line;
+		int fd = bench_connect();
+		if (fd < 0)
+			return;
+		fds->push_back(fd);
+
+		if (!bench_expect(fd, &received, "HELLO", &line) ||
+			!bench_send(fd, "ROOM_CREATE 2\n") ||
+			!bench_expect(fd, &received, "ROOM_CREATED ", &line))
+			return;
+
+		std::string room = line.substr(13);
+		if (!bench_send(fd, "ROOM_JOIN " + room + "\n") ||
+			!bench_expect(fd, &received, "ROOM_JOINED ", &line) ||
+			!bench_send(fd, "PLAYER_ADD 0 Bench " + room + "\n") ||
+			!bench_expect(fd, &received, "PLAYER_ADD ", &line))
+			return;
+
+		times->push_back(timer.elapsed() - start);
+	}
+}
+
+
+// Runs the room clients, then asks the lobby what rooms it has, counting
+// them and those with their player seated
+void bench_room_clients(std::vector<std::vector<double> > *times,
+						unsigned int *listed, unsigned int *seated,
+						Glib::RefPtr<Glib::MainLoop> m)
+{
+	std::vector<std::vector<int> > fds(BENCH_ROOM_CLIENTS);
+	std::vector<Glib::Thread*> threads;
+
+	for (unsigned int c = 0; c < BENCH_ROOM_CLIENTS; c++)
+		threads.push_back(Glib::Thread::create(sigc::bind(
+			sigc::ptr_fun(bench_room_client),
+			BENCH_ROOMS / BENCH_ROOM_CLIENTS, &(*times)[c], &fds[c]), true));
+
+	for (unsigned int c = 0; c < BENCH_ROOM_CLIENTS; c++)
+		threads[c]->join();
+
+	// The lobby copies out the rooms' numbers every second
+	Glib::usleep(1500000);
+
+	std::string received, line;
+	int fd = bench_connect();
+	if (fd >= 0 && bench_expect(fd, &received, "HELLO", &line) &&
+		bench_send(fd, "ROOM_LIST\n"))
+		while (bench_expect(fd, &received, "ROOM_", &line) &&
+			   line != "ROOM_LIST_END")
+		{
+			if (line.compare(0, 10, "ROOM_INFO ") != 0)
+				continue;
+			(*listed)++;
+			if (line.find(" 1/2 ") != std::string::npos)
+				(*seated)++;
+		}
+	if (fd >= 0)
+		close(fd);
+
+	for (unsigned int c = 0; c < BENCH_ROOM_CLIENTS; c++)
+		for (unsigned int f = 0; f < fds[c].size(); f++)
+			close(fds[c][f]);
+
+	m->quit();
+}
+
+
+// Has BENCH_ROOM_CLIENTS clients make and join BENCH_ROOMS rooms between
+// them, all kept open at once, reporting how long each took and whether
+// the lobby lists them all
+void bench_rooms(Glib::RefPtr<Glib::MainLoop> m)
+{
+	GameLobby lobby(port, 2, false, false, false, num_threads);
+	std::vector<std::vector<double> > times(BENCH_ROOM_CLIENTS);
+	std::vector<double> all_times;
+	unsigned int listed = 0, seated = 0;
+	Glib::Timer timer;
+
+	lobby.set_max_rooms(BENCH_ROOMS + 1);
+	if (!lobby.listen())
+	{
+		std::cout << "Couldn't listen on port " << port << std::endl;
+		return;
+	}
+
+	timer.start();
+	Glib::Thread *clients = Glib::Thread::create(sigc::bind(
+		sigc::ptr_fun(bench_room_clients), &times, &listed, &seated, m), true);
+	m->run();
+	clients->join();
+	timer.stop();
+
+	lobby.close();
+
+	for (unsigned int c = 0; c < BENCH_ROOM_CLIENTS; c++)
+		all_times.insert(all_times.end(), times[c].begin(), times[c].end());
+	if (all_times.empty())
+	{
+		std::cout << "No rooms were made." << std::endl;
+		return;
+	}
+	std::sort(all_times.begin(), all_times.end());
+
+	std::cout << all_times.size() << " of " << BENCH_ROOMS
+		<< " rooms made and joined by " << BENCH_ROOM_CLIENTS
+		<< " clients on " << num_threads << " room threads, p50 "
+		<< (unsigned long)(1e6 * all_times[all_times.size() / 2])
+		<< " us, p99 "
+		<< (unsigned long)(1e6 * all_times[all_times.size() * 99 / 100])
+		<< " us" << std::endl;
+	std::cout << listed << " rooms listed, " << seated
+		<< " with their player seated, after " << timer.elapsed() << " s"
+		<< std::endl;
+}
+
+#endif   // #ifdef HAVE_SYS_EPOLL_H
+
+
+#ifndef WIN32
+
+const unsigned int BENCH_KILLS = 20;
+
+
+// Plays bots against each other in a room kept at path, game after game,
+// until it's killed
+void journal_writer(const std::string& path)
+{
+	Glib::RefPtr<Glib::MainLoop> m = Glib::MainLoop::create();
+	GameServer server(0, num_players, long_jumps, hop_others, stop_others);
+
+	server.evt_game_over.connect(sigc::mem_fun(server,
+		&GameServer::restart_game));
+	server.new_game();
+	server.set_journal(path);
+	for (int i = 0; i < num_players; i++)
+		server.add_bot("s");
+
+	m->run();
+}
+
+
+// Whether the game kept at path is whole: a snapshot with its TURN, then
+// whole records following on from it without a gap.  version is the
+// board version it comes to.
+bool check_journal(const std::string& path, unsigned int *version)
+{
+	GameJournal journal(path);
+	std::vector<std::string> snapshot, records;
+	bool turned = false;
+
+	if (!journal.load(&snapshot, &records))
+		return false;
+
+	for (unsigned int l = 0; l < snapshot.size(); l++)
+	{
+		StrView command, arguments;
+		StrView(snapshot[l]).split(' ', &command, &arguments);
+		unsigned int player, move_count;
+
+		if (command == StrView("TURN"))
+			turned = arguments.take_uint(&player) &&
+				arguments.take_uint(&move_count) && arguments.take_uint(version);
+	}
+	if (!turned)
+		return false;
+
+	for (unsigned int r = 0; r < records.size(); r++)
+	{
+		StrView command, arguments;
+		StrView(records[r]).split(' ', &command, &arguments);
+		unsigned int record_version, count, hole;
+
+		if (command == StrView("SEAT"))
+			continue;
+		if (!arguments.take_uint(&record_version) ||
+			record_version > *version + 1)
+			return false;
+
+		if (command == StrView("MOVE"))
+		{
+			if (!arguments.take_uint(&count) || count < 2)
+				return false;
+			for (unsigned int h = 0; h < count; h++)
+				if (!arguments.take_uint(&hole))
+					return false;
+			if (!arguments.empty())
+				return false;
+		}
+		else if (command != StrView("UNDO") && command != StrView("REDO"))
+			return false;
+
+		if (record_version > *version)
+			*version = record_version;
+	}
+
 	return true;
 }
 
 
+// Kills a server writing its journal at random points, BENCH_KILLS times,
+// starting it again on what it left each time, the way a crashed cheechd
+// would be.  Every time, what's on disk must be whole, and mustn't have
+// gone back from what was there the time before.
+void bench_journals()
+{
+	std::string dir = Glib::get_tmp_dir() + "/cheechd-journal-XXXXXX";
+	if (!mkdtemp(&dir[0]))
+	{
+		std::cout << "Couldn't make a directory for the journal." << std::endl;
+		return;
+	}
+	std::string path = dir + "/room-1";
+
+	Glib::Rand rand;
+	unsigned int version = 0, failures = 0;
+
+	for (unsigned int k = 1; k <= BENCH_KILLS; k++)
+	{
+		std::cout << std::flush;
+		pid_t pid = fork();
+		if (pid == 0)
+		{
+			journal_writer(path);
+			_exit(0);
+		}
+		if (pid < 0)
+		{
+			std::cout << "Couldn't start a server to kill." << std::endl;
+			break;
+		}
+
+		Glib::usleep(rand.get_int_range(200, 1000) * 1000);
+		kill(pid, SIGKILL);
+		waitpid(pid, NULL, 0);
+
+		unsigned int reached = 0;
+		bool whole = check_journal(path, &reached);
+
+		std::cout << "kill " << k << ": ";
+		if (!whole)
+			std::cout << "the journal's broken";
+		else if (reached < version)
+			std::cout << "went back to version " << reached << " from "
+				<< version;
+		else
+			std::cout << "whole, at version " << reached;
+		std::cout << std::endl;
+
+		if (!whole || reached < version)
+			failures++;
+		else
+			version = reached;
+	}
+
+	GameJournal(path).remove();
+	rmdir(dir.c_str());
+
+	std::cout << failures << " of " << BENCH_KILLS
+		<< " kills left a bad journal" << std::endl;
+}
+
+#endif   // #ifndef WIN32
+
+
+// Splits a line up as the handlers do, its command first and then its
+// arguments one at a time, numbers being read as they go
+static unsigned long tokenize_line(const std::string& line)
+{
+	StrView command, arguments, token;
+	unsigned int number;
+	unsigned long checksum = 0;
+
+	StrView(line).split(' ', &command, &arguments);
+	checksum += command.length();
+	while (!arguments.empty())
+		if (arguments.take_uint(&number))
+			checksum += number;
+		else if (arguments.take_token(&token))
+			checksum += token.length();
+		else
+			break;
+
+	return checksum;
+}
+
+
+// Times the usual lines of a game the way a connection and its handlers
+// take them in, first as text and then as v10 frames, which decode_line
+// turns back into the same lines for the same handlers, and compares their
+// sizes
+void bench_codecs()
+{
+	const unsigned int rounds = 200000;
+	std::vector<std::string> lines;
+	GameBoard board(num_players, long_jumps, hop_others, stop_others);
+
+	std::string board_line = "GAME_BOARD";
+	for (unsigned int i = 0; i < GameBoard::SIZE; i++)
+		if (board[i] != 0)
+			board_line += " " + util::to_str(board[i]->get_current_player());
+	lines.push_back(board_line);
+	lines.push_back("GAME_MAKEMOVE 20 38 56 74 92");
+	lines.push_back("GAME_TURN 3 0 42");
+	lines.push_back("PLAYER_ADD 2 5 Fred");
+	lines.push_back("CLIENT_MESSAGE Fred (#2) has joined the game.");
+	lines.push_back("SERVER_HEARTBEAT 17");
+
+	std::string text, frames;
+	std::vector<std::string> bodies;
+	for (unsigned int l = 0; l < lines.size(); l++)
+	{
+		std::string frame;
+		ProtoCodec::encode_line(lines[l].data(), lines[l].length(), &frame);
+		bodies.push_back(frame.substr(ProtoCodec::HEADER_SIZE));
+		text += lines[l] + "\n";
+		frames += frame;
+	}
+
+	std::cout << "text: " << text.length() << " bytes, frames: "
+		<< frames.length() << " bytes, for " << lines.size() << " lines"
+		<< std::endl;
+
+	unsigned long checksum = 0;
+	Glib::Timer timer;
+	double per_line = 1e9 / ((double)rounds * lines.size());
+
+	// A text line is copied out of the input buffer before its handler
+	// gets it
+	timer.start();
+	for (unsigned int r = 0; r < rounds; r++)
+		for (unsigned int l = 0; l < lines.size(); l++)
+		{
+			std::string line(lines[l]);
+			checksum += tokenize_line(line);
+		}
+	timer.stop();
+	std::cout << "read text: " << (unsigned long)(timer.elapsed() * per_line)
+		<< " ns/line" << std::endl;
+
+	// As Gnet::Conn::read_frame and EpollConn::take_frame do it
+	timer.start();
+	for (unsigned int r = 0; r < rounds; r++)
+		for (unsigned int l = 0; l < lines.size(); l++)
+		{
+			std::string line;
+			ProtoCodec::decode_line(bodies[l].data(), bodies[l].length(),
+									&line);
+			checksum += tokenize_line(line);
+		}
+	timer.stop();
+	std::cout << "read frames: "
+		<< (unsigned long)(timer.elapsed() * per_line) << " ns/line"
+		<< std::endl;
+
+	timer.start();
+	for (unsigned int r = 0; r < rounds; r++)
+	{
+		frames.clear();
+		for (unsigned int l = 0; l < lines.size(); l++)
+			ProtoCodec::encode_line(lines[l].data(), lines[l].length(),
+									&frames);
+		checksum += frames.length();
+	}
+	timer.stop();
+	std::cout << "encode frames: "
+		<< (unsigned long)(timer.elapsed() * per_line) << " ns/line"
+		<< std::endl;
+
+	// Keeps the loops from being optimised away
+	if (checksum == 0)
+		std::cout << std::endl;
+}
+
+
+// Times util::to_str and util::from_str, and appending to one buffer,
+// against the stream versions they replaced, on numbers the size of
+// holes and move counts
+void bench_formats()
+{
+	const unsigned int count = 1000000;
+	std::vector<Glib::ustring> texts;
+	unsigned long checksum = 0;
+	Glib::Timer timer;
+	double per_number = 1e9 / count;
+
+	timer.start();
+	for (unsigned int i = 0; i < count; i++)
+	{
+		std::ostringstream stream;
+		stream << i % 1000;
+		checksum += stream.str().length();
+	}
+	timer.stop();
+	std::cout << "to_str with a stream: "
+		<< (unsigned long)(timer.elapsed() * per_number) << " ns"
+		<< std::endl;
+
+	timer.start();
+	for (unsigned int i = 0; i < count; i++)
+		checksum += util::to_str(i % 1000).bytes();
+	timer.stop();
+	std::cout << "util::to_str: "
+		<< (unsigned long)(timer.elapsed() * per_number) << " ns"
+		<< std::endl;
+
+	std::string buffer;
+	timer.start();
+	for (unsigned int i = 0; i < count; i++)
+	{
+		// A board's worth to a message
+		if (i % 121 == 0)
+			buffer.clear();
+		util::append_uint(buffer, i % 1000);
+		buffer += ' ';
+	}
+	timer.stop();
+	checksum += buffer.length();
+	std::cout << "util::append_uint: "
+		<< (unsigned long)(timer.elapsed() * per_number) << " ns"
+		<< std::endl;
+
+	for (unsigned int i = 0; i < 1000; i++)
+		texts.push_back(util::to_str(i));
+
+	timer.start();
+	for (unsigned int i = 0; i < count; i++)
+	{
+		std::istringstream stream(texts[i % 1000]);
+		unsigned int value;
+		stream >> value;
+		checksum += value;
+	}
+	timer.stop();
+	std::cout << "from_str with a stream: "
+		<< (unsigned long)(timer.elapsed() * per_number) << " ns"
+		<< std::endl;
+
+	timer.start();
+	for (unsigned int i = 0; i < count; i++)
+		checksum += util::from_str<unsigned int>(texts[i % 1000]);
+	timer.stop();
+	std::cout << "util::from_str: "
+		<< (unsigned long)(timer.elapsed() * per_number) << " ns"
+		<< std::endl;
+
+	// Keeps the loops from being optimised away
+	if (checksum == 0)
+		std::cout << std::endl;
+}
+
+
 void process_options(int &argc, char **&argv)
 {
 	try
@@ -130,6 +844,77 @@ void process_options(int &argc, char **&argv)
 			"allow stopping in other players' triangles (default=no)");
 		opt_group.add_entry(opt_stop_others, stop_others);
 
+		Glib::OptionEntry opt_bot_nodes;
+		opt_bot_nodes.set_long_name("bot-nodes");
+		opt_bot_nodes.set_short_name('B');
+		opt_bot_nodes.set_arg_description("N");
+		opt_bot_nodes.set_description(
+			"limit the search of bots added with addbot to about N nodes per move "
+			"(500000)");
+		opt_group.add_entry(opt_bot_nodes, bot_node_limit);
+
+		Glib::OptionEntry opt_max_rooms;
+		opt_max_rooms.set_long_name("max-rooms");
+		opt_max_rooms.set_short_name('R');
+		opt_max_rooms.set_arg_description("N");
+		opt_max_rooms.set_description(
+			"most games clients can have going at once (1000)");
+		opt_group.add_entry(opt_max_rooms, max_rooms);
+
+		Glib::OptionEntry opt_threads;
+		opt_threads.set_long_name("threads");
+		opt_threads.set_short_name('t');
+		opt_threads.set_arg_description("N");
+		opt_threads.set_description(
+			"number of threads to share the rooms out among (CPUs)");
+		opt_group.add_entry(opt_threads, num_threads);
+
+		Glib::OptionEntry opt_journal_dir;
+		opt_journal_dir.set_long_name("journal-dir");
+		opt_journal_dir.set_short_name('J');
+		opt_journal_dir.set_arg_description("dir");
+		opt_journal_dir.set_description(
+			"keep games in dir, and pick them up again from there on starting");
+		opt_group.add_entry_filename(opt_journal_dir, journal_dir);
+
+		Glib::OptionEntry opt_archive;
+		opt_archive.set_long_name("archive");
+		opt_archive.set_short_name('A');
+		opt_archive.set_arg_description("file");
+		opt_archive.set_description(
+			"add finished games to the archive file.index and file.moves");
+		opt_group.add_entry_filename(opt_archive, archive_path);
+
+		Glib::OptionEntry opt_bench_transport;
+		opt_bench_transport.set_long_name("bench-transport");
+		opt_bench_transport.set_description(
+			"compare the GNet and epoll sockets' speed on port, then exit");
+		opt_group.add_entry(opt_bench_transport, bench_transport);
+
+		Glib::OptionEntry opt_bench_codec;
+		opt_bench_codec.set_long_name("bench-codec");
+		opt_bench_codec.set_description(
+			"compare reading the protocol as text and as frames, then exit");
+		opt_group.add_entry(opt_bench_codec, bench_codec);
+
+		Glib::OptionEntry opt_bench_format;
+		opt_bench_format.set_long_name("bench-format");
+		opt_bench_format.set_description(
+			"compare formatting numbers with and without streams, then exit");
+		opt_group.add_entry(opt_bench_format, bench_format);
+
+		Glib::OptionEntry opt_bench_journal;
+		opt_bench_journal.set_long_name("bench-journal");
+		opt_bench_journal.set_description(
+			"kill a server keeping a journal, and check what it left, then exit");
+		opt_group.add_entry(opt_bench_journal, bench_journal);
+
+		Glib::OptionEntry opt_bench_room;
+		opt_bench_room.set_long_name("bench-room");
+		opt_bench_room.set_description(
+			"make and join hundreds of rooms on port at once, then exit");
+		opt_group.add_entry(opt_bench_room, bench_room);
+
 		Glib::OptionEntry opt_start_cheechwebd;
 		opt_start_cheechwebd.set_long_name("start-cheechweb");
 		opt_start_cheechwebd.set_short_name('W');
@@ -162,6 +947,8 @@ void process_options(int &argc, char **&argv)
 	if (num_players == 0) num_players = 3;
 	if (num_players < 1) num_players = 1;
 	if (num_players > 6) num_players = 6;
+	if (max_rooms < 1) max_rooms = 1000;
+	if (num_threads < 1) num_threads = util::get_num_cpus();
 }
 
 
@@ -173,31 +960,85 @@ int main(int argc, char **argv)
 	textdomain (GETTEXT_PACKAGE);
 #endif //ENABLE_NLS
 
+	if (!Glib::thread_supported())
+		Glib::thread_init();
+
 	gnet_init();
 
 	process_options(argc, argv);
 
 	Glib::RefPtr<Glib::MainLoop> m = Glib::MainLoop::create();
 
-	GameServer *server = new GameServer(port, num_players, long_jumps,
-										hop_others, stop_others);
+	if (bench_transport)
+	{
+#ifdef HAVE_SYS_EPOLL_H
+		bench_transports(m);
+#else
+		std::cout << "There's no epoll here to compare GNet with." << std::endl;
+#endif
+		return 0;
+	}
+
+	if (bench_room)
+	{
+#ifdef HAVE_SYS_EPOLL_H
+		bench_rooms(m);
+#else
+		std::cout << "The room bench needs the sockets used with epoll."
+			<< std::endl;
+#endif
+		return 0;
+	}
+
+	if (bench_codec)
+	{
+		bench_codecs();
+		return 0;
+	}
+
+	if (bench_format)
+	{
+		bench_formats();
+		return 0;
+	}
+
+	if (bench_journal)
+	{
+#ifndef WIN32
+		bench_journals();
+#else
+		std::cout << "There's no fork here to kill a server with." << std::endl;
+#endif
+		return 0;
+	}
+
+	// Room 1 plays the game set up on the command line
+	GameLobby *lobby = new GameLobby(port, num_players, long_jumps,
+									 hop_others, stop_others, num_threads);
+	GameServer *server = lobby->get_first_room();
 	AjaxServer *ajax_server;
 
-	server->evt_message.connect(sigc::ptr_fun(printMessage));
+	lobby->evt_message.connect(sigc::ptr_fun(printMessage));
+	lobby->set_max_rooms(max_rooms);
+	if (bot_node_limit > 0)
+		lobby->set_bot_node_limit(bot_node_limit);
+	if (!archive_path.empty())
+		lobby->set_archive(archive_path);
+	if (!journal_dir.empty())
+		lobby->set_journal_dir(journal_dir);
 	if (num_games)
 		server->evt_game_over.connect(sigc::bind(sigc::bind(sigc::ptr_fun(gameOver), m), server));
-	server->new_game();
 
-	if (!server->ready())
+	if (!lobby->listen())
 	{
-		delete server;
+		delete lobby;
 		std::cout << "Chinese Checkers GameServer failed to start on port "
 			<< port << std::endl;
 		return 0;
 	}
 
 	std::cout << "Chinese Checkers GameServer started on port "
-		<< port << std::endl;
+		<< port << " with " << num_threads << " room threads" << std::endl;
 
 	if (cheechweb_port)
 	{
@@ -227,7 +1068,7 @@ int main(int argc, char **argv)
 
 	std::cout << std::endl;
 
-	Glib::signal_io().connect(sigc::bind(sigc::ptr_fun(on_stdin), server),
+	Glib::signal_io().connect(sigc::bind(sigc::ptr_fun(on_stdin), lobby),
 							  Glib::IOChannel::create_from_fd(0),
 							  Glib::IO_IN);
 
@@ -0,0 +1,246 @@
+/*
+ *  cheechdb application's main.
+ *  cheechdb looks through the games cheechd has archived, and writes
+ *  them out as text
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include <iostream>
+#include <string>
+#include <cstring>
+#include <stdlib.h>
+#include <config.h>
+#include <glib/gi18n.h>
+#include <glibmm/optioncontext.h>
+
+#include "utility.hh"
+#include "game_archive.hh"
+
+// cheechdb Options
+Glib::ustring bot_type;
+Glib::ustring player_name;
+bool won;
+bool lost;
+bool count_only;
+bool show_moves;
+
+
+void process_options(int &argc, char **&argv)
+{
+	try
+	{
+		Glib::OptionContext opt_context("ARCHIVE");
+		Glib::OptionGroup opt_group(
+			"cheechdb options", "Options choosing the games to write out");
+
+		Glib::OptionEntry opt_bot_type;
+		opt_bot_type.set_long_name("bot");
+		opt_bot_type.set_short_name('b');
+		opt_bot_type.set_arg_description("type");
+		opt_bot_type.set_description(
+			"only games with a bot of this type, like l5");
+		opt_group.add_entry(opt_bot_type, bot_type);
+
+		Glib::OptionEntry opt_player_name;
+		opt_player_name.set_long_name("name");
+		opt_player_name.set_short_name('n');
+		opt_player_name.set_arg_description("name");
+		opt_player_name.set_description(
+			"only games with a player of this name");
+		opt_group.add_entry(opt_player_name, player_name);
+
+		Glib::OptionEntry opt_won;
+		opt_won.set_long_name("won");
+		opt_won.set_short_name('w');
+		opt_won.set_description(
+			"only games that player or bot won");
+		opt_group.add_entry(opt_won, won);
+
+		Glib::OptionEntry opt_lost;
+		opt_lost.set_long_name("lost");
+		opt_lost.set_short_name('l');
+		opt_lost.set_description(
+			"only games that player or bot didn't win");
+		opt_group.add_entry(opt_lost, lost);
+
+		Glib::OptionEntry opt_count_only;
+		opt_count_only.set_long_name("count");
+		opt_count_only.set_short_name('c');
+		opt_count_only.set_description(
+			"just write how many games there are");
+		opt_group.add_entry(opt_count_only, count_only);
+
+		Glib::OptionEntry opt_show_moves;
+		opt_show_moves.set_long_name("moves");
+		opt_show_moves.set_short_name('m');
+		opt_show_moves.set_description(
+			"write out each game's moves too");
+		opt_group.add_entry(opt_show_moves, show_moves);
+
+		opt_context.set_main_group(opt_group);
+
+		opt_context.parse(argc, argv);
+	}
+	catch (Glib::OptionError er)
+	{
+		std::cout << "Bad command line arguments.  Try cheechdb --help"
+			<< std::endl;
+		exit(1);
+	}
+}
+
+
+// A name or type from the archive, which may fill its field
+std::string get_text(const char *field, unsigned int size)
+{
+	return std::string(field, strnlen(field, size));
+}
+
+
+bool matches(const GameArchive::GameHeader& game)
+{
+	if (bot_type.empty() && player_name.empty() && !won && !lost)
+		return true;
+
+	for (unsigned int i = 0; i < game.num_players &&
+			 i < GameArchive::MAX_PLAYERS; i++)
+	{
+		const GameArchive::PlayerInfo& player = game.players[i];
+
+		if (!bot_type.empty() && get_text(player.bot_type,
+				sizeof(player.bot_type)) != bot_type.raw())
+			continue;
+		if (!player_name.empty() && get_text(player.name,
+				sizeof(player.name)) != player_name.raw())
+			continue;
+		if ((won && player.place != 1) || (lost && player.place == 1))
+			continue;
+
+		return true;
+	}
+
+	return false;
+}
+
+
+// GAME <game> <finished> <num players> <rules> <num moves>
+// PLAYER <posn> <place> <finish moves> <bot type> <name>
+// MOVE <hole> <hole> ..., with --moves
+void write_game(const GameArchive& archive, unsigned int g)
+{
+	const GameArchive::GameHeader& game = archive.get_game(g);
+	std::string text = "GAME ";
+
+	util::append_uint(text, g);
+	text += ' ';
+	util::append_uint(text, game.finished);
+	text += ' ';
+	util::append_uint(text, game.num_players);
+	text += ' ';
+	if (game.rules & GameArchive::LongJumps)
+		text += 'L';
+	if (game.rules & GameArchive::HopOthers)
+		text += 'H';
+	if (game.rules & GameArchive::StopOthers)
+		text += 'O';
+	if (!game.rules)
+		text += '-';
+	text += ' ';
+	util::append_uint(text, game.num_moves);
+	text += '\n';
+
+	for (unsigned int i = 0; i < game.num_players &&
+			 i < GameArchive::MAX_PLAYERS; i++)
+	{
+		const GameArchive::PlayerInfo& player = game.players[i];
+		std::string type = get_text(player.bot_type, sizeof(player.bot_type));
+
+		text += "PLAYER ";
+		util::append_uint(text, i + 1);
+		text += ' ';
+		util::append_uint(text, player.place);
+		text += ' ';
+		util::append_uint(text, player.finish_moves);
+		text += ' ';
+		text += type.empty() ? std::string("-") : type;
+		text += ' ';
+		text += get_text(player.name, sizeof(player.name));
+		text += '\n';
+	}
+
+	if (show_moves)
+	{
+		std::vector<MoveList> moves;
+		if (!archive.get_moves(g, &moves))
+			std::cerr << "Game " << g << "'s moves aren't all there."
+				<< std::endl;
+
+		for (unsigned int m = 0; m < moves.size(); m++)
+		{
+			text += "MOVE";
+			for (unsigned int h = 0; h < moves[m].size(); h++)
+			{
+				text += ' ';
+				util::append_uint(text, moves[m][h]);
+			}
+			text += '\n';
+		}
+	}
+
+	std::cout << text;
+}
+
+
+int main(int argc, char **argv)
+{
+#if defined(ENABLE_NLS)
+	bindtextdomain (GETTEXT_PACKAGE, PACKAGE_LOCALE_DIR);
+	bind_textdomain_codeset(GETTEXT_PACKAGE, "UTF-8");
+	textdomain (GETTEXT_PACKAGE);
+#endif //ENABLE_NLS
+
+	process_options(argc, argv);
+
+	if (argc != 2)
+	{
+		std::cout << "Which archive?  Try cheechdb --help" << std::endl;
+		return 1;
+	}
+
+	GameArchive archive;
+	if (!archive.open(argv[1]))
+	{
+		std::cout << "Couldn't read the archive " << argv[1] << "." << std::endl;
+		return 1;
+	}
+
+	unsigned int count = 0;
+	for (unsigned int g = 0; g < archive.get_num_games(); g++)
+	{
+		if (!matches(archive.get_game(g)))
+			continue;
+
+		count++;
+		if (!count_only)
+			write_game(archive, g);
+	}
+
+	if (count_only)
+		std::cout << count << std::endl;
+
+	return 0;
+}
@@ -36,6 +36,8 @@
 int ajax_port;
 Glib::ustring cheechd_hostname;
 int cheechd_port;
+Glib::ustring bot_hostname;
+int bot_port;
 
 
 void process_options(int &argc, char **&argv)
@@ -70,6 +72,22 @@ void process_options(int &argc, char **&argv)
 			"port of a running cheech game to connect cheechweb clients to (3838)");
 		opt_group.add_entry(opt_cheechd_port, cheechd_port);
 
+		Glib::OptionEntry opt_bot_hostname;
+		opt_bot_hostname.set_long_name("bot-host");
+		opt_bot_hostname.set_short_name('b');
+		opt_bot_hostname.set_arg_description("host");
+		opt_bot_hostname.set_description(
+			"hostname of a cheechbotd to run added bots on (run them here)");
+		opt_group.add_entry(opt_bot_hostname, bot_hostname);
+
+		Glib::OptionEntry opt_bot_port;
+		opt_bot_port.set_long_name("bot-port");
+		opt_bot_port.set_short_name('B');
+		opt_bot_port.set_arg_description("port");
+		opt_bot_port.set_description(
+			"port of the cheechbotd to run added bots on (3840)");
+		opt_group.add_entry(opt_bot_port, bot_port);
+
 		opt_context.set_main_group(opt_group);
 
 		opt_context.parse(argc, argv);
@@ -85,6 +103,7 @@ void process_options(int &argc, char **&argv)
 	if (ajax_port == 0) ajax_port = 3839;
 	if (cheechd_port == 0) cheechd_port = 3838;
 	if (cheechd_hostname == "") cheechd_hostname = "localhost";
+	if (bot_port == 0) bot_port = 3840;
 }
 
 
@@ -104,6 +123,9 @@ int main(int argc, char **argv)
 
 	AjaxServer ajax_server;
 
+	if (bot_hostname != "")
+		ajax_server.set_bot_host(bot_hostname, bot_port);
+
 	if (!ajax_server.listen(ajax_port, cheechd_hostname, cheechd_port))
 	{
 		std::cout << "Failed to start cheechweb server on port "
@@ -0,0 +1,101 @@
+/*
+ *  Looks up the handler for each protocol command by name, for the game
+ *  server, the game client and the web server to share.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef INCL_COMMAND_TABLE_HH
+#define INCL_COMMAND_TABLE_HH
+
+#include <vector>
+#include <algorithm>
+
+#include "str_view.hh"
+
+
+// Built once from a list of names and handlers, which is then kept sorted
+// so a command is found with a binary search of its bytes, rather than
+// being compared against every name in turn.  Handler is usually a
+// pointer to a member function, and find() gives back a null one for
+// commands that aren't in the table.
+//
+//   static const CommandTable<Handler>::Entry entries[] = { ... };
+//   static const CommandTable<Handler> commands(entries);
+template <class Handler>
+class CommandTable
+{
+public:
+	class Entry
+	{
+	public:
+		const char	*name;
+		Handler		handler;
+	};
+
+	template <unsigned int N>
+	CommandTable(const Entry (&entries)[N]);
+
+	Handler find(const StrView& command) const;
+
+private:
+	class Named
+	{
+	public:
+		StrView		name;
+		Handler		handler;
+
+		bool operator<(const Named& other) const
+		{
+			return name < other.name;
+		}
+	};
+
+	std::vector<Named>	_commands;
+};
+
+
+template <class Handler>
+template <unsigned int N>
+CommandTable<Handler>::CommandTable(const Entry (&entries)[N])
+{
+	_commands.resize(N);
+	for (unsigned int i = 0; i < N; i++)
+	{
+		_commands[i].name = StrView(entries[i].name);
+		_commands[i].handler = entries[i].handler;
+	}
+
+	std::sort(_commands.begin(), _commands.end());
+}
+
+
+template <class Handler>
+Handler CommandTable<Handler>::find(const StrView& command) const
+{
+	Named key;
+	key.name = command;
+	key.handler = Handler();
+
+	typename std::vector<Named>::const_iterator found =
+		std::lower_bound(_commands.begin(), _commands.end(), key);
+
+	if (found == _commands.end() || found->name != command)
+		return Handler();
+	return found->handler;
+}
+
+#endif   // #ifndef INCL_COMMAND_TABLE_HH
@@ -0,0 +1,247 @@
+/*
+ *  Tunes bot evaluation weights by playing matches between bots with
+ *  slightly different weights, several games at once.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include <iostream>
+#include <climits>
+
+#include "eval_tuner.hh"
+#include "bot_base.hh"
+
+
+// Games that last longer than this are called a draw
+static const unsigned int MAX_PLIES = 1000;
+
+// How much of a match a candidate has to win to be kept
+static const double WINNING_SCORE = 0.55;
+
+
+EvalTuner::EvalTuner(const Glib::ustring& bot_type, bool long_jumps,
+					 bool hop_others, bool stop_others)
+	:_bot_type(bot_type),
+	 _long_jumps(long_jumps),
+	 _hop_others(hop_others),
+	 _stop_others(stop_others),
+	 _node_limit(0),
+	 _random_plies(4),
+	 _match_games(40),
+	 _passes(4),
+	 _games_left(0),
+	 _candidate_score(0)
+{
+}
+
+
+EvalTuner::~EvalTuner()
+{
+	for (unsigned int b = 0; b < _bots.size(); b++)
+		delete _bots[b];
+}
+
+
+void EvalTuner::set_node_limit(unsigned long nodes)
+{
+	_node_limit = nodes;
+}
+
+
+void EvalTuner::set_random_plies(unsigned int plies)
+{
+	_random_plies = plies;
+}
+
+
+void EvalTuner::set_match_games(unsigned int games)
+{
+	_match_games = games;
+}
+
+
+void EvalTuner::set_passes(unsigned int passes)
+{
+	_passes = passes;
+}
+
+
+bool EvalTuner::run(const Glib::ustring& filename, EvalWeights *weights,
+					unsigned int num_jobs)
+{
+	for (unsigned int j = 0; j < num_jobs; j++)
+	{
+		BotBase *candidate = BotBase::new_bot_of_type(_bot_type);
+		BotBase *current = BotBase::new_bot_of_type(_bot_type);
+
+		if (!candidate || !current)
+		{
+			delete candidate;
+			delete current;
+			return false;
+		}
+
+		_bots.push_back(candidate);
+		_bots.push_back(current);
+		_bots.push_back(BotBase::new_bot_of_type("random"));
+	}
+
+	for (unsigned int b = 0; b < _bots.size(); b++)
+	{
+		_bots[b]->set_pump_events(false);
+		_bots[b]->set_node_limit(_node_limit);
+	}
+
+	// Fills in the bot type's own self penalty, if it has one
+	_bots[0]->set_weights(*weights);
+	_bots[0]->get_weights(weights);
+
+	long steps[EvalWeights::NumWeights];
+	for (unsigned int w = 0; w < EvalWeights::NumWeights; w++)
+		steps[w] = (weights->get((EvalWeights::Weight)w) + 4) / 5;
+
+	for (unsigned int pass = 0; pass < _passes; pass++)
+	{
+		bool improved = false;
+
+		for (unsigned int w = 0; w < EvalWeights::NumWeights; w++)
+		{
+			EvalWeights::Weight weight = (EvalWeights::Weight)w;
+
+			// Bots without this weight don't use it
+			if (!weights->get(weight) || !steps[w])
+				continue;
+
+			for (int sign = 1; sign >= -1; sign -= 2)
+			{
+				EvalWeights candidate = *weights;
+				long value = weights->get(weight) + sign * steps[w];
+
+				if (value < 1)
+					continue;
+				candidate.set(weight, value);
+
+				double score = play_match(candidate, *weights);
+
+				std::cout << "pass " << pass + 1 << ": "
+					<< EvalWeights::NAMES[w] << " " << value << " scored "
+					<< (int)(100 * score + 0.5) << "%" << std::endl;
+
+				if (score >= WINNING_SCORE)
+				{
+					*weights = candidate;
+					improved = true;
+					if (!weights->write(filename))
+						return false;
+					break;
+				}
+			}
+		}
+
+		if (!improved)
+			for (unsigned int w = 0; w < EvalWeights::NumWeights; w++)
+				steps[w] /= 2;
+	}
+
+	return weights->write(filename);
+}
+
+
+// Returns the share of the games the candidate won
+double EvalTuner::play_match(const EvalWeights& candidate,
+							 const EvalWeights& current)
+{
+	std::vector<Glib::Thread*> threads;
+
+	for (unsigned int b = 0; b < _bots.size(); b += 3)
+	{
+		_bots[b]->set_weights(candidate);
+		_bots[b + 1]->set_weights(current);
+	}
+
+	_games_left = _match_games;
+	_candidate_score = 0;
+
+	for (unsigned int j = 0; j < _bots.size() / 3; j++)
+		threads.push_back(Glib::Thread::create(sigc::bind(sigc::mem_fun(
+			*this, &EvalTuner::play_match_games), j), true));
+
+	for (unsigned int j = 0; j < threads.size(); j++)
+		threads[j]->join();
+
+	return _match_games ? _candidate_score / _match_games : 0.0;
+}
+
+
+void EvalTuner::play_match_games(unsigned int job)
+{
+	BotBase *candidate = _bots[3 * job];
+	BotBase *current = _bots[3 * job + 1];
+	BotBase *random_bot = _bots[3 * job + 2];
+	Glib::Rand rand;
+
+	for (;;)
+	{
+		unsigned int game;
+
+		{
+			Glib::Mutex::Lock lock(_mutex);
+			if (!_games_left)
+				return;
+			game = --_games_left;
+		}
+
+		// Take turns going first
+		double score = (game % 2) ?
+			play_game(candidate, current, random_bot, &rand) :
+			1.0 - play_game(current, candidate, random_bot, &rand);
+
+		Glib::Mutex::Lock lock(_mutex);
+		_candidate_score += score;
+	}
+}
+
+
+// Returns 1 if first wins, 0 if second wins, and 0.5 for a draw
+double EvalTuner::play_game(BotBase *first, BotBase *second,
+							BotBase *random_bot, Glib::Rand *rand)
+{
+	GameBoard board(2, _long_jumps, _hop_others, _stop_others);
+	unsigned int player = 1;
+
+	for (unsigned int ply = 0; ply < MAX_PLIES; ply++)
+	{
+		BotBase *mover = (ply < _random_plies) ? random_bot :
+			((player == 1) ? first : second);
+		std::vector<MoveList> best_moves;
+		long best_score = LONG_MIN;
+
+		mover->think(&board, player, &best_moves, &best_score);
+		if (best_moves.empty())
+			break;
+
+		MoveList& move =
+			best_moves[rand->get_int_range(0, best_moves.size())];
+		board.move_peg(move.front(), move.back());
+
+		if (board.player_finished(player))
+			return (player == 1) ? 1.0 : 0.0;
+
+		player = board.get_next_player(player);
+	}
+
+	return 0.5;
+}
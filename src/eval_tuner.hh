@@ -0,0 +1,77 @@
+/*
+ *  Tunes bot evaluation weights by playing matches between bots with
+ *  slightly different weights, several games at once.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef INCL_EVAL_TUNER_HH
+#define INCL_EVAL_TUNER_HH
+
+#include <vector>
+#include <glibmm/ustring.h>
+#include <glibmm/thread.h>
+#include <glibmm/random.h>
+
+#include "eval_weights.hh"
+
+class BotBase;
+
+
+// Tries nudging each weight up and down in turn, keeping any change that
+// wins enough of a two-player match against the current weights, and
+// halving the nudges after a pass with no improvement.
+class EvalTuner
+{
+public:
+	EvalTuner(const Glib::ustring& bot_type, bool long_jumps,
+			  bool hop_others, bool stop_others);
+	~EvalTuner();
+
+	void set_node_limit(unsigned long nodes);
+	void set_random_plies(unsigned int plies);
+	void set_match_games(unsigned int games);
+	void set_passes(unsigned int passes);
+
+	// Starts from weights, and writes each improvement to filename
+	bool run(const Glib::ustring& filename, EvalWeights *weights,
+			 unsigned int num_jobs);
+
+private:
+	double play_match(const EvalWeights& candidate,
+					  const EvalWeights& current);
+	void play_match_games(unsigned int job);
+	double play_game(BotBase *first, BotBase *second, BotBase *random_bot,
+					 Glib::Rand *rand);
+
+	Glib::ustring	_bot_type;
+	bool			_long_jumps;
+	bool			_hop_others;
+	bool			_stop_others;
+	unsigned long	_node_limit;
+	unsigned int	_random_plies;
+	unsigned int	_match_games;
+	unsigned int	_passes;
+
+	// Each job has a candidate bot, a current bot and a random bot
+	std::vector<BotBase*>	_bots;
+
+	Glib::Mutex		_mutex;
+	unsigned int	_games_left;
+	double			_candidate_score;
+};
+
+#endif   // #ifndef INCL_EVAL_TUNER_HH
@@ -0,0 +1,125 @@
+/*
+ *  The weights bots give to each part of their evaluation of a move.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include <iostream>
+#include <glibmm.h>
+
+#include "eval_weights.hh"
+#include "utility.hh"
+
+
+const char *EvalWeights::NAMES[NumWeights] =
+{
+	"distance", "finish_bonus", "finish_depth_bonus", "blocking_penalty",
+	"self_penalty"
+};
+
+
+EvalWeights::EvalWeights()
+{
+	set_defaults();
+}
+
+
+void EvalWeights::set_defaults()
+{
+	_values[Distance] = 50;
+	_values[FinishBonus] = 10000;
+	_values[FinishDepthBonus] = 2000;
+	_values[BlockingPenalty] = 5000;
+	_values[SelfPenalty] = 0;
+}
+
+
+long EvalWeights::get(Weight weight) const
+{
+	return _values[weight];
+}
+
+
+void EvalWeights::set(Weight weight, long value)
+{
+	_values[weight] = value;
+}
+
+
+// Weights files have one "name value" pair per line, like preferences.
+// Weights that aren't in the file keep their current values.
+bool EvalWeights::read(const Glib::ustring& filename)
+{
+	Glib::RefPtr<Glib::IOChannel> pfile;
+
+	try
+	{
+		pfile = Glib::IOChannel::create_from_file(filename, "r");
+	}
+	catch (Glib::FileError)
+	{
+		return false;
+	}
+
+	Glib::ustring line;
+
+	while (pfile->read_line(line) == Glib::IO_STATUS_NORMAL)
+	{
+		util::trim(line);
+
+		int seperator = line.find_first_of(" ");
+		if (seperator < 0 || line[0] == '#')
+			continue;
+
+		Glib::ustring key = line.substr(0, seperator);
+		Glib::ustring value = line.substr(seperator+1);
+
+		for (unsigned int w = 0; w < NumWeights; w++)
+			if (key == NAMES[w])
+				_values[w] = util::from_str<long>(value);
+	}
+
+	pfile->close();
+
+	return true;
+}
+
+
+bool EvalWeights::write(const Glib::ustring& filename) const
+{
+	Glib::RefPtr<Glib::IOChannel> pfile;
+
+	try
+	{
+		pfile = Glib::IOChannel::create_from_file(filename, "w");
+	}
+	catch (Glib::FileError)
+	{
+		std::cerr << "Can't write weights to '"
+			<< filename << "'." << std::endl;
+		return false;
+	}
+
+	pfile->write("# cheech bot evaluation weights\n");
+
+	for (unsigned int w = 0; w < NumWeights; w++)
+		pfile->write(Glib::ustring(NAMES[w]) + " " +
+					 util::to_str(_values[w]) + "\n");
+
+	pfile->close();
+
+	return true;
+}
@@ -0,0 +1,50 @@
+/*
+ *  The weights bots give to each part of their evaluation of a move.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef INCL_EVAL_WEIGHTS_HH
+#define INCL_EVAL_WEIGHTS_HH
+
+#include <glibmm/ustring.h>
+
+
+class EvalWeights
+{
+public:
+	typedef enum {Distance=0, FinishBonus, FinishDepthBonus, BlockingPenalty,
+				  SelfPenalty, NumWeights} Weight;
+
+	const static char *NAMES[NumWeights];
+
+	EvalWeights();
+
+	// The hand-picked weights the bots have always used.  A self penalty
+	// of 0 leaves each bot type with its own.
+	void set_defaults();
+
+	long get(Weight weight) const;
+	void set(Weight weight, long value);
+
+	bool read(const Glib::ustring& filename);
+	bool write(const Glib::ustring& filename) const;
+
+private:
+	long	_values[NumWeights];
+};
+
+#endif   // #ifndef INCL_EVAL_WEIGHTS_HH
@@ -0,0 +1,310 @@
+/*
+ *  Finished games, kept for looking back over, in files made to be read
+ *  in place.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <glibmm/thread.h>
+
+#ifdef WIN32
+#include <io.h>
+// The same calls, under Windows' names
+#define fsync _commit
+#define ftruncate _chsize
+#else
+#include <unistd.h>
+#include <sys/mman.h>
+#define O_BINARY 0
+#endif
+
+#include "game_archive.hh"
+
+
+static const char MAGIC[8] = {'C', 'H', 'E', 'E', 'C', 'H', 'D', 'B'};
+
+
+static bool write_all(int fd, const char *data, size_t length, off_t offset)
+{
+#ifdef WIN32
+	// No pwrite(), but append()'s lock keeps anyone else off the file
+	if (lseek(fd, offset, SEEK_SET) != offset)
+		return false;
+#endif
+
+	while (length > 0)
+	{
+#ifndef WIN32
+		ssize_t written = pwrite(fd, data, length, offset);
+#else
+		ssize_t written = write(fd, data, length);
+#endif
+		if (written < 0 && errno == EINTR)
+			continue;
+		if (written <= 0)
+			return false;
+
+		data += written;
+		length -= written;
+		offset += written;
+	}
+
+	return true;
+}
+
+
+GameArchive::GameArchive()
+	:_index(NULL),
+	 _index_size(0),
+	 _moves(NULL),
+	 _moves_size(0),
+	 _num_games(0)
+{
+}
+
+
+GameArchive::~GameArchive()
+{
+	close();
+}
+
+
+bool GameArchive::append(const std::string& path, const GameHeader& header,
+						 const std::vector<MoveList>& moves)
+{
+	// Rooms finish games in their own threads
+	static Glib::Mutex mutex;
+	Glib::Mutex::Lock lock(mutex);
+
+	std::string packed;
+	for (unsigned int m = 0; m < moves.size(); m++)
+	{
+		if (moves[m].size() > 255)
+			return false;
+
+		packed += (char)moves[m].size();
+		for (unsigned int h = 0; h < moves[m].size(); h++)
+			packed += (char)moves[m][h];
+	}
+
+	int index_fd = ::open((path + ".index").c_str(),
+						  O_RDWR | O_CREAT | O_BINARY, 0644);
+	int moves_fd = ::open((path + ".moves").c_str(),
+						  O_RDWR | O_CREAT | O_BINARY, 0644);
+	struct stat index_stat, moves_stat;
+	bool added = false;
+
+	if (index_fd >= 0 && moves_fd >= 0 && fstat(index_fd, &index_stat) == 0 &&
+		fstat(moves_fd, &moves_stat) == 0)
+	{
+		off_t end = index_stat.st_size;
+
+		if ((size_t)end < sizeof(FileHeader))
+		{
+			FileHeader file_header;
+			memset(&file_header, 0, sizeof(file_header));
+			memcpy(file_header.magic, MAGIC, sizeof(MAGIC));
+			file_header.version = VERSION;
+			file_header.game_header_size = sizeof(GameHeader);
+
+			end = sizeof(FileHeader);
+			if (!write_all(index_fd, (const char*)&file_header,
+						   sizeof(file_header), 0))
+				end = 0;
+		}
+		else
+			end -= (end - sizeof(FileHeader)) % sizeof(GameHeader);
+
+		GameHeader game = header;
+		game.moves_offset = moves_stat.st_size;
+		game.moves_length = packed.length();
+		game.num_moves = moves.size();
+
+		// The moves are on the disk before the header that points at them
+		added = end > 0 &&
+			write_all(moves_fd, packed.data(), packed.length(),
+					  moves_stat.st_size) &&
+			fsync(moves_fd) == 0 &&
+			write_all(index_fd, (const char*)&game, sizeof(game), end) &&
+			ftruncate(index_fd, end + sizeof(game)) == 0 &&
+			fsync(index_fd) == 0;
+	}
+
+	if (index_fd >= 0)
+		::close(index_fd);
+	if (moves_fd >= 0)
+		::close(moves_fd);
+
+	return added;
+}
+
+
+void GameArchive::set_text(char *field, unsigned int size,
+						   const std::string& text)
+{
+	unsigned int length = text.length();
+
+	if (length >= size)
+	{
+		length = size - 1;
+		// Back to the start of the character that didn't fit
+		while (length > 0 && ((unsigned char)text[length] & 0xc0) == 0x80)
+			length--;
+	}
+
+	memset(field, 0, size);
+	memcpy(field, text.data(), length);
+}
+
+
+bool GameArchive::open(const std::string& path)
+{
+	close();
+
+	_index = map_file(path + ".index", &_index_size);
+	_moves = map_file(path + ".moves", &_moves_size);
+
+	const FileHeader *file_header = (const FileHeader*)_index;
+
+	if (!_index || _index_size < sizeof(FileHeader) ||
+		memcmp(file_header->magic, MAGIC, sizeof(MAGIC)) != 0 ||
+		file_header->version != VERSION ||
+		file_header->game_header_size != sizeof(GameHeader))
+	{
+		close();
+		return false;
+	}
+
+	_num_games = (_index_size - sizeof(FileHeader)) / sizeof(GameHeader);
+	return true;
+}
+
+
+void GameArchive::close()
+{
+#ifndef WIN32
+	if (_index)
+		munmap((void*)_index, _index_size);
+	if (_moves)
+		munmap((void*)_moves, _moves_size);
+#else
+	g_free((void*)_index);
+	g_free((void*)_moves);
+#endif
+
+	_index = _moves = NULL;
+	_index_size = _moves_size = 0;
+	_num_games = 0;
+}
+
+
+unsigned int GameArchive::get_num_games() const
+{
+	return _num_games;
+}
+
+
+const GameArchive::GameHeader& GameArchive::get_game(unsigned int game) const
+{
+	return ((const GameHeader*)(_index + sizeof(FileHeader)))[game];
+}
+
+
+bool GameArchive::get_moves(unsigned int game,
+							std::vector<MoveList> *moves) const
+{
+	const GameHeader& header = get_game(game);
+
+	moves->clear();
+	if (header.moves_offset + header.moves_length > _moves_size)
+		return false;
+
+	const unsigned char *posn = (const unsigned char*)_moves +
+		header.moves_offset;
+	const unsigned char *end = posn + header.moves_length;
+
+	while (posn < end)
+	{
+		unsigned int count = *posn++;
+		if ((unsigned int)(end - posn) < count)
+			return false;
+
+		moves->push_back(MoveList(posn, posn + count));
+		posn += count;
+	}
+
+	return moves->size() == header.num_moves;
+}
+
+
+// NULL for a file that's empty or can't be read.  Windows has no mmap(),
+// so there the file's read in whole instead.
+const char* GameArchive::map_file(const std::string& filename, size_t *size)
+{
+	int fd = ::open(filename.c_str(), O_RDONLY | O_BINARY);
+	struct stat file_stat;
+
+	*size = 0;
+	if (fd < 0)
+		return NULL;
+
+#ifndef WIN32
+	void *data = MAP_FAILED;
+
+	if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0)
+	{
+		*size = file_stat.st_size;
+		data = mmap(NULL, *size, PROT_READ, MAP_SHARED, fd, 0);
+	}
+	::close(fd);
+
+	if (data == MAP_FAILED)
+	{
+		*size = 0;
+		return NULL;
+	}
+	return (const char*)data;
+#else
+	char *data = NULL;
+
+	if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0)
+	{
+		size_t done = 0;
+
+		data = (char*)g_malloc(file_stat.st_size);
+		while (done < (size_t)file_stat.st_size)
+		{
+			int count = read(fd, data + done, file_stat.st_size - done);
+			if (count <= 0)
+				break;
+			done += count;
+		}
+		*size = done;
+	}
+	::close(fd);
+
+	if (data && *size == 0)
+	{
+		g_free(data);
+		data = NULL;
+	}
+	return data;
+#endif
+}
@@ -0,0 +1,126 @@
+/*
+ *  Finished games, kept for looking back over, in files made to be read
+ *  in place.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef INCL_GAME_ARCHIVE_HH
+#define INCL_GAME_ARCHIVE_HH
+
+#include <string>
+#include <vector>
+#include <glib.h>
+
+#include "game_board.hh"
+
+
+// An archive is two files:
+//
+//   path.index  a FileHeader, then a GameHeader for each game in the
+//               order they finished
+//   path.moves  each game's moves one after another, each a byte for
+//               the number of holes in it and a byte for each hole
+//
+// Both are in the byte order of the machine that wrote them, and the
+// headers are fixed in size, so a reader maps the files and looks
+// straight at the headers, only unpacking the moves of the games it
+// wants.  A game's moves are written before its header, and a header
+// that was cut short is written over by the next game, so a server
+// stopping partway through leaves the games before it whole.
+class GameArchive
+{
+public:
+	const static unsigned int VERSION = 1;
+	const static unsigned int MAX_PLAYERS = 6;
+	// In bytes, counting the '\0' at the end
+	const static unsigned int MAX_NAME = 32;
+	const static unsigned int MAX_TYPE = 8;
+
+	typedef enum {LongJumps=1, HopOthers=2, StopOthers=4} Rules;
+
+	class FileHeader
+	{
+	public:
+		char		magic[8];
+		guint32		version;
+		guint32		game_header_size;
+	};
+
+	class PlayerInfo
+	{
+	public:
+		char		name[MAX_NAME];
+		// Empty for a person, or what BotBase::new_bot_of_type() takes
+		char		bot_type[MAX_TYPE];
+		// The move it finished on, and where it came, or 0 for both if
+		// it didn't finish
+		guint16		finish_moves;
+		guint8		place;
+		guint8		padding;
+	};
+
+	class GameHeader
+	{
+	public:
+		// Seconds since the epoch
+		guint64		finished;
+		guint64		moves_offset;
+		guint32		moves_length;
+		guint32		num_moves;
+		guint8		num_players;
+		guint8		rules;
+		guint8		padding[6];
+		PlayerInfo	players[MAX_PLAYERS];
+	};
+
+	GameArchive();
+	~GameArchive();
+
+	// Adds a game to the archive at path, making it if it isn't there.
+	// Safe to call from several threads at once.
+	static bool append(const std::string& path, const GameHeader& header,
+					   const std::vector<MoveList>& moves);
+
+	// Fills in a name or type, cutting it short if need be without
+	// breaking a character in two
+	static void set_text(char *field, unsigned int size,
+						 const std::string& text);
+
+	// Maps the archive at path for reading, returning false if it isn't
+	// one
+	bool open(const std::string& path);
+	void close();
+
+	unsigned int get_num_games() const;
+	const GameHeader& get_game(unsigned int game) const;
+	// False if the game's moves aren't all there
+	bool get_moves(unsigned int game, std::vector<MoveList> *moves) const;
+
+private:
+	GameArchive(const GameArchive& archive);
+	GameArchive& operator=(const GameArchive& archive);
+
+	static const char* map_file(const std::string& filename, size_t *size);
+
+	const char		*_index;
+	size_t			_index_size;
+	const char		*_moves;
+	size_t			_moves_size;
+	unsigned int	_num_games;
+};
+
+#endif   // #ifndef INCL_GAME_ARCHIVE_HH
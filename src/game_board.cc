@@ -18,6 +18,7 @@
  */
 
 #include <math.h>
+#include <sstream>
 
 #include "config.h"
 #include "utility.hh"
@@ -81,14 +82,45 @@ GameBoard::BOARD_MAP[SIZE] =
 	  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
 };
 
+guint64 GameBoard::ZOBRIST_KEYS[SIZE][7];
+guint64 GameBoard::ZOBRIST_TURN[7];
+
+
+// Fills the Zobrist tables from a fixed seed, so that hashes (and anything
+// saved keyed by them, like opening books) are the same on every build.
+bool GameBoard::init_zobrist_keys()
+{
+	guint64 seed = G_GUINT64_CONSTANT(0x636865656368);
+
+	for (unsigned int i = 0; i < SIZE * 7 + 7; i++)
+	{
+		// splitmix64
+		guint64 z = (seed += G_GUINT64_CONSTANT(0x9E3779B97F4A7C15));
+		z = (z ^ (z >> 30)) * G_GUINT64_CONSTANT(0xBF58476D1CE4E5B9);
+		z = (z ^ (z >> 27)) * G_GUINT64_CONSTANT(0x94D049BB133111EB);
+		z = z ^ (z >> 31);
+
+		if (i < SIZE * 7)
+			ZOBRIST_KEYS[i / 7][i % 7] = (i % 7) ? z : 0;
+		else
+			ZOBRIST_TURN[i - SIZE * 7] = z;
+	}
+
+	return true;
+}
+
 
 GameBoard::GameBoard(unsigned int num_players, bool long_jumps, 
 	bool hop_others, bool stop_others)
 	:_num_players(num_players),
 	 _long_jumps(long_jumps),
 	 _hop_others(hop_others),
-	 _stop_others(stop_others)
+	 _stop_others(stop_others),
+	 _hash(0)
 {
+	static bool zobrist_ready = init_zobrist_keys();
+	(void)zobrist_ready;
+
 	// Creates all the holes with appropriate starting players
 	for (unsigned int i = 0; i < SIZE; i++)
 		if (BOARD_MAP[i] >= 0)
@@ -110,7 +142,8 @@ GameBoard::GameBoard(const GameBoard &board)
 	:_num_players(board._num_players),
 	 _long_jumps(board._long_jumps),
 	 _hop_others(board._hop_others),
-	 _stop_others(board._stop_others)
+	 _stop_others(board._stop_others),
+	 _hash(board._hash)
 {
 	for (unsigned int i = 0; i < SIZE; i++)
 		if (BOARD_MAP[i] >= 0)
@@ -138,6 +171,7 @@ GameBoard& GameBoard::operator=(const GameBoard& board)
 	_long_jumps = board._long_jumps;
 	_hop_others = board._hop_others;
 	_stop_others = board._stop_others;
+	_hash = board._hash;
 
 	for (unsigned int i = 0; i < SIZE; i++)
 	{
@@ -207,6 +241,8 @@ void GameBoard::reset_peg_lists()
 {
 	unsigned int peg_count[6];
 
+	_hash = 0;
+
 	for (int i = 0; i < 6; i++)
 	{
 		_pegs_in_goal[i] = 0;
@@ -222,6 +258,7 @@ void GameBoard::reset_peg_lists()
 			unsigned int end_player;
 			if (cur_player)
 			{
+				_hash ^= ZOBRIST_KEYS[i][cur_player];
 				_pegs[cur_player-1][peg_count[cur_player-1]] = i;
 				_board[i]->set_peg_list_index(peg_count[cur_player-1]);
 				peg_count[cur_player-1]++;
@@ -267,12 +304,39 @@ unsigned int *GameBoard::get_pegs(unsigned int player)
 }
 
 
+const unsigned int *GameBoard::get_pegs(unsigned int player) const
+{
+	return _pegs[player-1];
+}
+
+
 unsigned int GameBoard::get_size() const 
 { 
 	return SIZE; 
 }
 
 
+// Packs the player count and rule flags into one small number, so that
+// tables keyed by position can tell the different game variants apart.
+unsigned int GameBoard::get_rules_key() const
+{
+	return _num_players | (_long_jumps ? 8 : 0) |
+		(_hop_others ? 16 : 0) | (_stop_others ? 32 : 0);
+}
+
+
+guint64 GameBoard::get_hash() const
+{
+	return _hash;
+}
+
+
+guint64 GameBoard::get_hash(unsigned int to_move) const
+{
+	return _hash ^ ZOBRIST_TURN[to_move];
+}
+
+
 GameHole* GameBoard::operator[](unsigned int i) const 
 {
 	return _board[i]; 
@@ -417,6 +481,27 @@ bool GameBoard::valid_move_list(const MoveList& move_list,
 }
 
 
+bool GameBoard::read_move_list(StrView text, MoveList *move_list) const
+{
+	unsigned int count;
+
+	move_list->clear();
+	if (!text.take_uint(&count) || count > SIZE)
+		return false;
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		unsigned int hole;
+
+		if (!text.take_uint(&hole) || hole >= SIZE || !_board[hole])
+			return false;
+		move_list->push_back(hole);
+	}
+
+	return true;
+}
+
+
 bool GameBoard::make_move_list(const MoveList& move_list)
 {
 	if (!valid_move_list(move_list, true))
@@ -452,6 +537,8 @@ void GameBoard::move_peg(unsigned int from, unsigned int to)
 	_board[to]->set_current_player(player);
 	_board[from]->set_current_player(0);
 
+	_hash ^= ZOBRIST_KEYS[from][player] ^ ZOBRIST_KEYS[to][player];
+
 	if (_board[from]->get_end_player() == player)
 		_pegs_in_goal[player-1]--;
 	if (_board[to]->get_end_player() == player)
@@ -462,6 +549,91 @@ void GameBoard::move_peg(unsigned int from, unsigned int to)
 }
 
 
+Glib::ustring GameBoard::get_position(unsigned int to_move) const
+{
+	Glib::ustring position = util::to_str(_num_players) + " ";
+
+	if (_long_jumps)
+		position += "L";
+	if (_hop_others)
+		position += "H";
+	if (_stop_others)
+		position += "O";
+	if (!_long_jumps && !_hop_others && !_stop_others)
+		position += "-";
+
+	position += " " + util::to_str(to_move) + " ";
+
+	for (unsigned int i = 0; i < SIZE; i++)
+		if (_board[i])
+		{
+			unsigned int player = _board[i]->get_current_player();
+			position += player ? (char)('0' + player) : '.';
+		}
+
+	return position;
+}
+
+
+// Leaves the board alone and returns false if position can't be read, or
+// doesn't have 10 pegs for each player.
+bool GameBoard::set_position(const Glib::ustring& position,
+							 unsigned int *to_move)
+{
+	std::istringstream pos_stream(position);
+	unsigned int num_players = 0, player = 0;
+	std::string rules, holes;
+
+	pos_stream >> num_players >> rules >> player >> holes;
+
+	if (!pos_stream || num_players < 1 || num_players > 6 ||
+		player < 1 || player > num_players ||
+		rules.find_first_not_of("LHO-") != std::string::npos)
+			return false;
+
+	unsigned int num_pegs[7] = {0, 0, 0, 0, 0, 0, 0};
+	std::string::size_type h = 0;
+
+	for (unsigned int i = 0; i < SIZE; i++)
+		if (BOARD_MAP[i] >= 0)
+		{
+			if (h >= holes.size())
+				return false;
+
+			char c = holes[h++];
+			if (c == '.')
+				continue;
+			if (c < '1' || c > (char)('0' + num_players))
+				return false;
+			num_pegs[c - '0']++;
+		}
+
+	if (h != holes.size())
+		return false;
+	for (unsigned int p = 1; p <= num_players; p++)
+		if (num_pegs[p] != 10)
+			return false;
+
+	reconfigure_board(num_players,
+		rules.find('L') != std::string::npos,
+		rules.find('H') != std::string::npos,
+		rules.find('O') != std::string::npos);
+
+	h = 0;
+	for (unsigned int i = 0; i < SIZE; i++)
+		if (_board[i])
+		{
+			char c = holes[h++];
+			_board[i]->set_current_player((c == '.') ? 0 : c - '0');
+		}
+
+	reset_peg_lists();
+	*to_move = player;
+
+	return true;
+}
+
+
 unsigned int GameBoard::get_next_player(unsigned int from_player) const
 {
 	unsigned int next_player = from_player;
@@ -22,8 +22,10 @@
 
 #include <vector>
 #include <sigc++/sigc++.h>
+#include <glibmm/ustring.h>
 
 #include "game_hole.hh"
+#include "str_view.hh"
 
 
 typedef std::vector<unsigned int> MoveList;
@@ -40,6 +42,11 @@ public:
 	const static unsigned int GOAL_MAP[7];
 	const static int BOARD_MAP[SIZE];
 
+	// Zobrist keys for hashing positions: one per hole per player, plus
+	// one per player for the side to move.
+	static guint64 ZOBRIST_KEYS[SIZE][7];
+	static guint64 ZOBRIST_TURN[7];
+
 	sigc::signal<void, unsigned int> evt_player_finished;
 	sigc::signal<void> evt_game_over;
 
@@ -51,6 +58,7 @@ private:
 	bool						_stop_others;
 	unsigned int				_pegs_in_goal[6];
 	unsigned int				_pegs[6][10];
+	guint64						_hash;
 
 public:
 	GameBoard(unsigned int num_players, bool long_jumps,
@@ -69,7 +77,11 @@ public:
 	bool get_hop_others_allowed() const;
 	bool get_stop_others_allowed() const;
 	unsigned int *get_pegs(unsigned int player);
+	const unsigned int *get_pegs(unsigned int player) const;
 	unsigned int get_size() const;
+	unsigned int get_rules_key() const;
+	guint64 get_hash() const;
+	guint64 get_hash(unsigned int to_move) const;
 	GameHole* operator[](unsigned int i) const;
 
 	double get_distance(unsigned int from, unsigned int to);
@@ -89,11 +101,23 @@ public:
 								 int dir) const;
 
 	bool make_move_list(const MoveList& move_list);
+	// Reads a move as the protocol sends it, "<count> <hole>...", returning
+	// false unless it's all there and all on the board
+	bool read_move_list(StrView text, MoveList *move_list) const;
 	void move_peg(unsigned int from, unsigned int to);
 
+	// One-line notation for a position:
+	//   <num players> <rules> <player to move> <holes>
+	// where rules is some of L (long jumps), H (hop others) and O (stop
+	// others) or '-' for none, and holes has one character per hole in
+	// order, '.' for empty or the player number.
+	Glib::ustring get_position(unsigned int to_move) const;
+	bool set_position(const Glib::ustring& position, unsigned int *to_move);
+
 
 private:
 	void init_neighbors();
+	static bool init_zobrist_keys();
 };
 
 #endif   // #ifndef INCL_GAME_BOARD_HH
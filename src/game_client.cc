@@ -20,12 +20,13 @@
 #include <glibmm/main.h>
 #include <sigc++/sigc++.h>
 #include <iostream>
-#include <sstream>
 #include <vector>
 
 #include "config.h"
 #include "game_client.hh"
 #include "utility.hh"
+#include "proto_codec.hh"
+#include "command_table.hh"
 
 // #define DEBUG_CLIENT 1
 
@@ -42,10 +43,18 @@ GameClient::Player::Player(Glib::ustring name_, int color_)
 
 
 GameClient::GameClient()
-	: _current_player(0),
+	: _port(0),
+	  _session_received(0),
+	  _resuming(false),
+	  _resume_tries(0),
+	  _board_version(0),
+	  _board_versioned(false),
+	  _current_player(0),
 	  _name(""),
 	  _color(0),
 	  _player_number(0),
+	  _room(0),
+	  _joining_room(false),
 	  _client_heartbeat(0),
 	  _server_heartbeat(0)
 {
@@ -232,6 +241,21 @@ void GameClient::shuffle_players()
 }
 
 
+// Seats a bot in the game, on the server itself
+void GameClient::add_bot(Glib::ustring bot_type)
+{
+	if (ready())
+		_socket << "GAME_ADDBOT " + bot_type + "\n";
+}
+
+
+void GameClient::remove_bots()
+{
+	if (ready())
+		_socket << "GAME_REMOVEBOTS\n";
+}
+
+
 void GameClient::reconfigure_game(unsigned int num_players, bool long_jumps,
 								  bool hop_others, bool stop_others)
 {
@@ -243,6 +267,12 @@ void GameClient::reconfigure_game(unsigned int num_players, bool long_jumps,
 }
 
 
+void GameClient::set_room(unsigned int room)
+{
+	_room = room;
+}
+
+
 void GameClient::join_game(Glib::ustring host, unsigned int port,
 						   bool spectator)
 {
@@ -251,13 +281,20 @@ void GameClient::join_game(Glib::ustring host, unsigned int port,
 		return;
 
 	_spectator = spectator;
+	_host = host;
+	_port = port;
 	_socket.connect(host, port);
 }
 
 
 void GameClient::resync_game()
 {
-	if (ready())
+	if (!ready())
+		return;
+
+	if (_board && _board_versioned)
+		_socket << "SERVER_SYNC " + util::to_str(_board_version) + "\n";
+	else
 		_socket << "SERVER_SYNC\n";
 }
 
@@ -265,6 +302,7 @@ void GameClient::resync_game()
 void GameClient::leave_game()
 {
 	_current_player = 0;
+	_session.clear();
 
 	if (ready())
 		_socket.close();
@@ -275,7 +313,24 @@ void GameClient::heartbeat()
 {
 	_client_heartbeat = (_client_heartbeat + 1) % TIMEOUT_HEARTBEAT;
 
-	if (!ready())
+	if (_resuming && _socket.get_status() == Gnet::Conn::statIdle)
+	{
+		if (++_resume_tries < RESUME_TRIES)
+			_socket.connect(_host, _port);
+		else
+		{
+			evt_message("Couldn't get back into the game.");
+			_resuming = false;
+			_session.clear();
+			clear_game();
+			evt_disconnected();
+		}
+		return;
+	}
+
+	// Until we're in our room, the lobby would take a heartbeat as a
+	// client that doesn't know about rooms
+	if (!ready() || _joining_room)
 		return;
 
 	if (_client_heartbeat == _server_heartbeat)
@@ -292,23 +347,57 @@ void GameClient::connected()
 {
 	_server_heartbeat = _client_heartbeat;
 
-	if (_spectator)
+	_joining_room = (_room != 0);
+	if (_joining_room)
+		_socket << "ROOM_JOIN " + util::to_str(_room) + "\n";
+	else
+		add_self();
+
+	if (!_resuming)
+		evt_connected();
+}
+
+
+void GameClient::add_self()
+{
+	if (_resuming)
+		_socket << "RESUME " + _session + " " +
+			util::to_str(_session_received) + "\n";
+	else if (_spectator)
 		_socket << "SPECTATOR_ADD " + _name + "\n";
 	else
 		_socket << "PLAYER_ADD " + util::to_str(_color) + " " + _name + "\n";
-
-	evt_connected();
 }
 
 
+// While resuming, the next heartbeat tries again
 void GameClient::cancelled()
 {
-	evt_cancelled();
+	if (!_resuming)
+		evt_cancelled();
 }
 
 
 void
 GameClient::disconnected()
+{
+	if (!_session.empty() && !_resuming)
+	{
+		evt_message("Lost the connection to the game, reconnecting ...");
+		_resuming = true;
+		_resume_tries = 0;
+		_socket.connect(_host, _port);
+		return;
+	}
+
+	_resuming = false;
+	_session.clear();
+	clear_game();
+	evt_disconnected();
+}
+
+
+void GameClient::clear_game()
 {
 	for (int i = 1; i <= 6; i++)
 	{
@@ -321,69 +410,61 @@ GameClient::disconnected()
 		delete _board;
 		_board = NULL;
 	}
+	_board_versioned = false;
 	_current_player = 0;
-	evt_disconnected();
 }
 
 
 void
 GameClient::read(Glib::ustring message)
 {
-	Glib::ustring command, arguments;
-
-	int seperator = message.find_first_of(" ");
-	if (seperator < 0)
-	{
-		command = message.substr(0, message.length());
-	}
-	else
-	{
-		command = message.substr(0, seperator);
-		arguments = message.substr(seperator+1, message.length()-seperator-1);
-	}
+	typedef void (GameClient::*Handler)(const StrView&);
+	typedef CommandTable<Handler> Commands;
+	static const Commands::Entry entries[] = {
+		{ "HELLO", &GameClient::command_HELLO },
+		{ "SET_PLAYER_NUMBER", &GameClient::command_SET_PLAYER_NUMBER },
+		{ "PLAYER_ADD", &GameClient::command_PLAYER_ADD },
+		{ "SPECTATOR_ADD", &GameClient::command_SPECTATOR_ADD },
+		{ "PLAYER_REMOVE", &GameClient::command_PLAYER_REMOVE },
+		{ "PLAYER_CHAT", &GameClient::command_PLAYER_CHAT },
+		{ "PLAYER_FINISH", &GameClient::command_PLAYER_FINISH },
+		{ "CLIENT_MESSAGE", &GameClient::command_CLIENT_MESSAGE },
+		{ "CLIENT_HEARTBEAT", &GameClient::command_CLIENT_HEARTBEAT },
+		{ "SERVER_HEARTBEAT", &GameClient::command_SERVER_HEARTBEAT },
+		{ "GAME_SETUP", &GameClient::command_GAME_SETUP },
+		{ "PLAYER_CHOOSE_NAME", &GameClient::command_PLAYER_CHOOSE_NAME },
+		{ "PLAYER_CHOOSE_COLOR", &GameClient::command_PLAYER_CHOOSE_COLOR },
+		{ "GAME_TURN", &GameClient::command_GAME_TURN },
+		{ "GAME_SHOWMOVE", &GameClient::command_GAME_SHOWMOVE },
+		{ "GAME_HIDEMOVE", &GameClient::command_GAME_HIDEMOVE },
+		{ "GAME_MAKEMOVE", &GameClient::command_GAME_MAKEMOVE },
+		{ "GAME_UNDOMOVE", &GameClient::command_GAME_UNDOMOVE },
+		{ "GAME_BOARD", &GameClient::command_GAME_BOARD },
+		{ "GAME_VERSION", &GameClient::command_GAME_VERSION },
+		{ "ROOM_JOINED", &GameClient::command_ROOM_JOINED },
+		{ "ROOM_ERROR", &GameClient::command_ROOM_ERROR },
+		{ "PROTO_BINARY", &GameClient::command_PROTO_BINARY },
+		{ "SESSION", &GameClient::command_SESSION },
+		{ "RESUMED", &GameClient::command_RESUMED },
+		{ "RESUME_FAILED", &GameClient::command_RESUME_FAILED }
+	};
+	static const Commands commands(entries);
+
+	StrView command, arguments;
+	StrView(message.raw()).split(' ', &command, &arguments);
 
 #ifdef DEBUG_CLIENT
 		cerr << "CLIENT RECEIVED : " << message << endl;
 #endif
 
-	if (command == "HELLO")
-		command_HELLO(arguments);
-	else if (command == "SET_PLAYER_NUMBER")
-		command_SET_PLAYER_NUMBER(arguments);
-	else if (command == "PLAYER_ADD")
-		command_PLAYER_ADD(arguments);
-	else if (command == "SPECTATOR_ADD")
-		command_SPECTATOR_ADD(arguments);
-	else if (command == "PLAYER_REMOVE")
-		command_PLAYER_REMOVE(arguments);
-	else if (command == "PLAYER_CHAT")
-		command_PLAYER_CHAT(arguments);
-	else if (command == "PLAYER_FINISH")
-		command_PLAYER_FINISH(arguments);
-	else if (command == "CLIENT_MESSAGE")
-		command_CLIENT_MESSAGE(arguments);
-	else if (command == "CLIENT_HEARTBEAT")
-		command_CLIENT_HEARTBEAT(arguments);
-	else if (command == "SERVER_HEARTBEAT")
-		command_SERVER_HEARTBEAT(arguments);
-	else if (command == "GAME_SETUP")
-		command_GAME_SETUP(arguments);
-	else if (command == "PLAYER_CHOOSE_NAME")
-		command_PLAYER_CHOOSE_NAME(arguments);
-	else if (command == "PLAYER_CHOOSE_COLOR")
-		command_PLAYER_CHOOSE_COLOR(arguments);
-	else if (command == "GAME_TURN")
-		command_GAME_TURN(arguments);
-	else if (command == "GAME_SHOWMOVE")
-		command_GAME_SHOWMOVE(arguments);
-	else if (command == "GAME_HIDEMOVE")
-		command_GAME_HIDEMOVE(arguments);
-	else if (command == "GAME_MAKEMOVE")
-		command_GAME_MAKEMOVE(arguments);
-	else if (command == "GAME_UNDOMOVE")
-		command_GAME_UNDOMOVE(arguments);
-	else if (command == "GAME_BOARD")
-		command_GAME_BOARD(arguments);
+	// Counted just as the server counts what it sends in the session
+	if (!_session.empty() && !_resuming &&
+		!ProtoCodec::session_command(command))
+		_session_received++;
+
+	Handler handler = commands.find(command);
+	if (handler)
+		(this->*handler)(arguments);
 
 #ifdef DEBUG_CLIENT
 	else
@@ -402,11 +483,9 @@ void GameClient::error(Conn::Error error)
 }
 
 
-void GameClient::command_HELLO(const Glib::ustring& arguments)
+void GameClient::command_HELLO(const StrView& arguments)
 {
-	Glib::ustring version = arguments;
-
-	if (version != PROTO_VERSION)
+	if (arguments != StrView(PROTO_VERSION))
 	{
 		evt_message("Couldn't connect to the game!  "
 			"You're using a different version of cheech than the server.  "
@@ -416,37 +495,46 @@ void GameClient::command_HELLO(const Glib::ustring& arguments)
 }
 
 
-void GameClient::command_SET_PLAYER_NUMBER(const Glib::ustring& arguments)
+void GameClient::command_SET_PLAYER_NUMBER(const StrView& arguments)
 {
-	unsigned int posn = util::from_str<unsigned int>(arguments);
+	unsigned int posn = 0;
+	arguments.to_uint(&posn);
 
 	_player_number = posn;
 	cmd_set_player_number(posn);
 }
 
 
-void GameClient::command_PLAYER_ADD(const Glib::ustring& arguments)
+void GameClient::command_PLAYER_ADD(const StrView& arguments)
 {
-	unsigned int posn = util::from_str<unsigned int>(arguments);
+	StrView rest = arguments;
+	unsigned int posn;
+	int color;
+
+	if (!rest.take_uint(&posn) || posn > 6 || !rest.take_int(&color))
+		return;
 
-	_players[posn].color = util::from_str<int>(arguments.substr(2));
-	_players[posn].name = arguments.substr(4);
+	_players[posn].color = color;
+	_players[posn].name = util::to_text(rest);
 
 	cmd_player_add(posn, _players[posn].name, _players[posn].color);
 }
 
 
-void GameClient::command_SPECTATOR_ADD(const Glib::ustring& arguments)
+void GameClient::command_SPECTATOR_ADD(const StrView& arguments)
 {
-	Glib::ustring name = arguments;
+	Glib::ustring name = util::to_text(arguments);
 
 	cmd_spectator_add(name);
 }
 
 
-void GameClient::command_PLAYER_REMOVE(const Glib::ustring& arguments)
+void GameClient::command_PLAYER_REMOVE(const StrView& arguments)
 {
-	unsigned int posn = util::from_str<unsigned int>(arguments);
+	unsigned int posn;
+
+	if (!arguments.to_uint(&posn) || posn > 6)
+		return;
 
 	_players[posn].name = "";
 	_players[posn].color = 0;
@@ -455,45 +543,51 @@ void GameClient::command_PLAYER_REMOVE(const Glib::ustring& arguments)
 }
 
 
-void GameClient::command_PLAYER_CHAT(const Glib::ustring& arguments)
+void GameClient::command_PLAYER_CHAT(const StrView& arguments)
 {
-	evt_message(arguments);
+	evt_message(util::to_text(arguments));
 }
 
 
-void GameClient::command_PLAYER_FINISH(const Glib::ustring& arguments)
+void GameClient::command_PLAYER_FINISH(const StrView& arguments)
 {
-	unsigned int posn = util::from_str<unsigned int>(arguments);
-	unsigned int move_count = util::from_str<unsigned int>(arguments.substr(2));
+	StrView rest = arguments;
+	unsigned int posn, move_count;
+
+	if (!rest.take_uint(&posn) || !rest.take_uint(&move_count))
+		return;
 
 	cmd_player_finish(posn, move_count);
 }
 
 
-void GameClient::command_CLIENT_MESSAGE(const Glib::ustring& arguments)
+void GameClient::command_CLIENT_MESSAGE(const StrView& arguments)
 {
-	evt_message(arguments);
+	evt_message(util::to_text(arguments));
 }
 
 
-void GameClient::command_CLIENT_HEARTBEAT(const Glib::ustring& arguments)
+void GameClient::command_CLIENT_HEARTBEAT(const StrView& arguments)
 {
-	_server_heartbeat = util::from_str<unsigned int>(arguments);
+	arguments.to_uint(&_server_heartbeat);
 }
 
 
-void GameClient::command_SERVER_HEARTBEAT(const Glib::ustring& arguments)
+void GameClient::command_SERVER_HEARTBEAT(const StrView& arguments)
 {
-	_socket << "SERVER_HEARTBEAT " + arguments + "\n";
+	_socket << "SERVER_HEARTBEAT " + arguments.str() + "\n";
 }
 
 
-void GameClient::command_GAME_SETUP(const Glib::ustring& arguments)
+void GameClient::command_GAME_SETUP(const StrView& arguments)
 {
-	unsigned int num_players = util::from_str<unsigned int>(arguments);
-	bool long_jumps = (bool)((int)util::from_str<int>(arguments.substr(2)));
-	bool hop_others = (bool)((int)util::from_str<int>(arguments.substr(4)));
-	bool stop_others = (bool)((int)util::from_str<int>(arguments.substr(6)));
+	StrView rest = arguments;
+	unsigned int num_players;
+	int long_jumps, hop_others, stop_others;
+
+	if (!rest.take_uint(&num_players) || !rest.take_int(&long_jumps) ||
+		!rest.take_int(&hop_others) || !rest.take_int(&stop_others))
+		return;
 
 	if (_board)
 		_board->reconfigure_board(num_players, long_jumps, hop_others,
@@ -504,107 +598,178 @@ void GameClient::command_GAME_SETUP(const Glib::ustring& arguments)
 }
 
 
-void GameClient::command_PLAYER_CHOOSE_NAME(const Glib::ustring& arguments)
+void GameClient::command_PLAYER_CHOOSE_NAME(const StrView& arguments)
 {
-	Glib::ustring name = arguments;
+	Glib::ustring name = util::to_text(arguments);
 
 	cmd_choose_new_name(name);
 }
 
 
-void GameClient::command_PLAYER_CHOOSE_COLOR(const Glib::ustring& arguments)
+void GameClient::command_PLAYER_CHOOSE_COLOR(const StrView& arguments)
 {
-	int color = util::from_str<int>(arguments);
-	Glib::ustring name = arguments.substr(2);
+	StrView rest = arguments;
+	int color = 0;
+	rest.take_int(&color);
+	Glib::ustring name = util::to_text(rest);
 
 	cmd_choose_new_color(name, color);
 }
 
 
-void GameClient::command_GAME_TURN(const Glib::ustring& arguments)
+void GameClient::command_GAME_TURN(const StrView& arguments)
 {
-	unsigned int posn = util::from_str<unsigned int>(arguments);
-	GameServer::GameStatus status = (GameServer::GameStatus)
-		util::from_str<unsigned int>(arguments.substr(2));
-	unsigned int move_number =
-		util::from_str<unsigned int>(arguments.substr(4));
+	StrView rest = arguments;
+	unsigned int posn, status, move_number;
+
+	if (!rest.take_uint(&posn) || !rest.take_uint(&status) ||
+		!rest.take_uint(&move_number))
+		return;
 
 	_current_player = posn;
-	cmd_game_turn(posn, status, move_number);
+	cmd_game_turn(posn, (GameServer::GameStatus)status, move_number);
 }
 
 
-void GameClient::command_GAME_SHOWMOVE(const Glib::ustring& arguments)
+void GameClient::command_GAME_SHOWMOVE(const StrView& arguments)
 {
-	istringstream argStream(arguments);
 	MoveList move_list;
-	int numMoves;
 
-	argStream >> numMoves;
-	for (int i = 0; i < numMoves; i++)
-	{
-		int j;
-		argStream >> j;
-		move_list.push_back(j);
-	}
+	if (!_board || !_board->read_move_list(arguments, &move_list))
+		return;
 
 	cmd_game_show_move(&move_list);
 }
 
 
-void GameClient::command_GAME_HIDEMOVE(const Glib::ustring& arguments)
+void GameClient::command_GAME_HIDEMOVE(const StrView& arguments)
 {
 	cmd_game_hide_move();
 }
 
 
-void GameClient::command_GAME_MAKEMOVE(const Glib::ustring& arguments)
+void GameClient::command_GAME_MAKEMOVE(const StrView& arguments)
 {
-	istringstream argStream(arguments);
 	MoveList move_list;
-	int numMoves;
 
-	argStream >> numMoves;
-	for (int i = 0; i < numMoves; i++)
-	{
-		int j;
-		argStream >> j;
-		move_list.push_back(j);
-	}
+	_board_version++;
+	if (!_board || !_board->read_move_list(arguments, &move_list))
+		return;
 
 	_board->make_move_list(move_list);
 	cmd_game_make_move(&move_list);
 }
 
 
-void GameClient::command_GAME_UNDOMOVE(const Glib::ustring& arguments)
+void GameClient::command_GAME_UNDOMOVE(const StrView& arguments)
 {
-	istringstream argStream(arguments);
+	StrView rest = arguments;
 	unsigned int from;
 	unsigned int to;
 
-	argStream >> from;
-	argStream >> to;
+	_board_version++;
+	if (!_board || !rest.take_uint(&from) || !rest.take_uint(&to) ||
+		from >= GameBoard::SIZE || to >= GameBoard::SIZE)
+		return;
 
 	_board->move_peg(from, to);
 	cmd_game_undo_move(from, to);
 }
 
 
-void GameClient::command_GAME_BOARD(const Glib::ustring& arguments)
+void GameClient::command_GAME_BOARD(const StrView& arguments)
 {
-	istringstream argStream(arguments);
-	int holePlayer;
+	StrView rest = arguments;
+	unsigned int holePlayer;
+
+	// Until GAME_VERSION says which this is
+	_board_versioned = false;
+	if (!_board)
+		return;
 
 	for (unsigned int i = 0; i < GameBoard::SIZE; i++)
 	{
 		GameHole* hole = (*_board)[i];
 		if (hole != 0)
 		{
-			argStream >> holePlayer;
-			hole->set_current_player(static_cast<int>(holePlayer));
+			if (!rest.take_uint(&holePlayer))
+				break;
+			hole->set_current_player(holePlayer);
 		}
 	}
 	_board->reset_peg_lists();
 	cmd_game_resync();
 }
+
+
+void GameClient::command_GAME_VERSION(const StrView& arguments)
+{
+	_board_versioned = arguments.to_uint(&_board_version);
+}
+
+
+void GameClient::command_ROOM_JOINED(const StrView& arguments)
+{
+	if (!_joining_room)
+		return;
+
+	_joining_room = false;
+	_server_heartbeat = _client_heartbeat;
+	add_self();
+}
+
+
+void GameClient::command_ROOM_ERROR(const StrView& arguments)
+{
+	evt_message("Couldn't join the game's room: " + util::to_text(arguments));
+	_joining_room = false;
+	leave_game();
+}
+
+
+// We answer the offer in text and send frames from then on, but keep
+// reading text until the server's answer, after which it sends frames
+void GameClient::command_PROTO_BINARY(const StrView& arguments)
+{
+	if (arguments != StrView(PROTO_BINARY_VERSION) ||
+		_socket.get_binary_input())
+		return;
+
+	if (_socket.get_binary_output())
+		_socket.set_binary_input(true);
+	else
+	{
+		_socket << "PROTO_BINARY " PROTO_BINARY_VERSION "\n";
+		_socket.set_binary_output(true);
+	}
+}
+
+
+void GameClient::command_SESSION(const StrView& arguments)
+{
+	_session = arguments.str();
+	_session_received = 0;
+}
+
+
+void GameClient::command_RESUMED(const StrView& arguments)
+{
+	if (!_resuming)
+		return;
+
+	_resuming = false;
+	evt_message("Back in the game.");
+}
+
+
+void GameClient::command_RESUME_FAILED(const StrView& arguments)
+{
+	if (!_resuming)
+		return;
+
+	evt_message("Couldn't get back into the game, so joining it again ...");
+	_resuming = false;
+	_session.clear();
+	clear_game();
+	add_self();
+}
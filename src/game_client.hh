@@ -44,11 +44,28 @@ private:
 private:
 	const static int HEARTBEAT_TIME = 5;
 	const static int TIMEOUT_HEARTBEAT = 6;
+	// How many heartbeats to keep trying to get back into the game for,
+	// within the server's grace period
+	const static unsigned int RESUME_TRIES = 5;
 
 private:
 	Gnet::ConnBuffered	_socket;
+	Glib::ustring		_host;
+	unsigned int		_port;
+
+	// The session the server gave us, if any, and how many of its lines
+	// we've read, for picking up where we left off if we lose the
+	// connection
+	std::string			_session;
+	unsigned int		_session_received;
+	bool				_resuming;
+	unsigned int		_resume_tries;
 
 	GameBoard*			_board;
+	// The server's version of the board, once it's said, which is kept
+	// up with so SERVER_SYNC need only ask for what's been missed
+	unsigned int		_board_version;
+	bool				_board_versioned;
 	unsigned int		_current_player;
 	Player				_players[7];
 
@@ -56,6 +73,8 @@ private:
 	unsigned int		_color;
 	unsigned int		_player_number;
 	bool				_spectator;
+	unsigned int		_room;
+	bool				_joining_room;
 
 	unsigned int		_client_heartbeat;
 	unsigned int		_server_heartbeat;
@@ -108,9 +127,14 @@ public:
 	void restart_game();
 	void rotate_players();
 	void shuffle_players();
+	void add_bot(Glib::ustring bot_type);
+	void remove_bots();
 	void reconfigure_game(unsigned int num_players, bool long_jumps,
 						  bool hop_others, bool stop_others);
 
+	// Room to join on a server hosting several games, from the next
+	// join_game() on.  0, the default, plays in the server's first room.
+	void set_room(unsigned int room);
 	void join_game(Glib::ustring host, unsigned int port, bool spectator);
 	void resync_game();
 	void leave_game();
@@ -123,47 +147,64 @@ private:
 	void connected();
 	void cancelled();
 	void disconnected();
+	// Forgets about the game we were in
+	void clear_game();
 	void read(Glib::ustring message);
 	void error(Gnet::Conn::Error error);
+	void add_self();
 
 	// First message sent from server, includes protocol version
-	void command_HELLO(const Glib::ustring& arguments);
+	void command_HELLO(const StrView& arguments);
 	// Server told us what player number we are
-	void command_SET_PLAYER_NUMBER(const Glib::ustring& arguments);
+	void command_SET_PLAYER_NUMBER(const StrView& arguments);
 	// Add a player to the game
-	void command_PLAYER_ADD(const Glib::ustring& arguments);
+	void command_PLAYER_ADD(const StrView& arguments);
 	// Add a spectator to the game
-	void command_SPECTATOR_ADD(const Glib::ustring& arguments);
+	void command_SPECTATOR_ADD(const StrView& arguments);
 	// Remove a player from the game
-	void command_PLAYER_REMOVE(const Glib::ustring& arguments);
+	void command_PLAYER_REMOVE(const StrView& arguments);
 	// Player chatted me
-	void command_PLAYER_CHAT(const Glib::ustring& arguments);
+	void command_PLAYER_CHAT(const StrView& arguments);
 	// Player finished
-	void command_PLAYER_FINISH(const Glib::ustring& arguments);
+	void command_PLAYER_FINISH(const StrView& arguments);
 	// Server sent me a text message
-	void command_CLIENT_MESSAGE(const Glib::ustring& arguments);
+	void command_CLIENT_MESSAGE(const StrView& arguments);
 	// Receive confirmation that server heard my heartbeat
-	void command_CLIENT_HEARTBEAT(const Glib::ustring& arguments);
+	void command_CLIENT_HEARTBEAT(const StrView& arguments);
 	// Receive server's heartbeat
-	void command_SERVER_HEARTBEAT(const Glib::ustring& arguments);
+	void command_SERVER_HEARTBEAT(const StrView& arguments);
 	// The board/num_players has changed
-	void command_GAME_SETUP(const Glib::ustring& arguments);
+	void command_GAME_SETUP(const StrView& arguments);
 	// We need to choose another name becasue NAME is already in use
-	void command_PLAYER_CHOOSE_NAME(const Glib::ustring& arguments);
+	void command_PLAYER_CHOOSE_NAME(const StrView& arguments);
 	// We need to choose another color becasue NAME is already using COLOR
-	void command_PLAYER_CHOOSE_COLOR(const Glib::ustring& arguments);
+	void command_PLAYER_CHOOSE_COLOR(const StrView& arguments);
 	// It is now player N's turn
-	void command_GAME_TURN(const Glib::ustring& arguments);
+	void command_GAME_TURN(const StrView& arguments);
 	// Show thses holes as selected on the board
-	void command_GAME_SHOWMOVE(const Glib::ustring& arguments);
+	void command_GAME_SHOWMOVE(const StrView& arguments);
 	// Deselect all holes
-	void command_GAME_HIDEMOVE(const Glib::ustring& arguments);
+	void command_GAME_HIDEMOVE(const StrView& arguments);
 	// Make/Commit this move to the board
-	void command_GAME_MAKEMOVE(const Glib::ustring& arguments);
+	void command_GAME_MAKEMOVE(const StrView& arguments);
 	// Undo/Redo the last move
-	void command_GAME_UNDOMOVE(const Glib::ustring& arguments);
+	void command_GAME_UNDOMOVE(const StrView& arguments);
 	// Reset the game board
-	void command_GAME_BOARD(const Glib::ustring& arguments);
+	void command_GAME_BOARD(const StrView& arguments);
+	// The version of the board we've just been sent
+	void command_GAME_VERSION(const StrView& arguments);
+	// We're now in the room we asked for
+	void command_ROOM_JOINED(const StrView& arguments);
+	// The server couldn't put us in that room
+	void command_ROOM_ERROR(const StrView& arguments);
+	// The session we're in, or that we're no longer in one
+	void command_SESSION(const StrView& arguments);
+	// We're back in our session, and about to be sent what we missed
+	void command_RESUMED(const StrView& arguments);
+	// The server couldn't take us back, so we need to join again
+	void command_RESUME_FAILED(const StrView& arguments);
+	// The server offers protocol v10's frames, or has agreed to them
+	void command_PROTO_BINARY(const StrView& arguments);
 };
 
 #endif   // #ifndef INCL_GAME_CLIENT_HH
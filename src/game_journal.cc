@@ -0,0 +1,213 @@
+/*
+ *  Keeps a game on disk as it's played, so the server can pick it up
+ *  again after it stops.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+
+#ifdef WIN32
+#include <io.h>
+#include <windows.h>
+// The same calls, under Windows' names
+#define fsync _commit
+#define ftruncate _chsize
+#else
+#include <unistd.h>
+#define O_BINARY 0
+#endif
+
+#include "game_journal.hh"
+
+
+GameJournal::GameJournal(const std::string& path)
+	:_path(path),
+	 _fd(-1),
+	 _unsynced(false)
+{
+}
+
+
+GameJournal::~GameJournal()
+{
+	sync();
+
+	if (_fd >= 0)
+		close(_fd);
+}
+
+
+bool GameJournal::load(std::vector<std::string> *snapshot,
+					   std::vector<std::string> *records) const
+{
+	snapshot->clear();
+	records->clear();
+
+	if (!read_lines(_path + ".snapshot", snapshot))
+		return false;
+
+	read_lines(_path + ".journal", records);
+	return true;
+}
+
+
+// In one write, so the record's in the file straight away even if it's
+// not yet on the disk
+bool GameJournal::append(const std::string& record)
+{
+	if (!open())
+		return false;
+
+	_unsynced = true;
+	return write_all(_fd, record + '\n');
+}
+
+
+bool GameJournal::pending() const
+{
+	return _unsynced;
+}
+
+
+bool GameJournal::sync()
+{
+	if (!_unsynced)
+		return true;
+
+	_unsynced = false;
+	return fsync(_fd) == 0;
+}
+
+
+// Written beside the old one and renamed over it, then the journal's
+// emptied.  If the server stops in between, the records already in the
+// snapshot are left in the journal, so GameServer skips those it has.
+bool GameJournal::save_snapshot(const std::string& snapshot)
+{
+	std::string filename = _path + ".snapshot";
+	std::string temp = filename + ".new";
+
+	int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_BINARY,
+					0644);
+	if (fd < 0)
+		return false;
+
+	bool saved = (write_all(fd, snapshot) && fsync(fd) == 0);
+	close(fd);
+
+#ifndef WIN32
+	if (!saved || rename(temp.c_str(), filename.c_str()) != 0)
+#else
+	// rename() won't replace a file there already
+	if (!saved || !MoveFileEx(temp.c_str(), filename.c_str(),
+			MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+#endif
+	{
+		unlink(temp.c_str());
+		return false;
+	}
+
+#ifndef WIN32
+	// So the rename itself is on the disk
+	std::string::size_type slash = _path.rfind('/');
+	std::string dir = (slash == std::string::npos) ? std::string(".") :
+		_path.substr(0, slash + 1);
+	int dir_fd = ::open(dir.c_str(), O_RDONLY);
+	if (dir_fd >= 0)
+	{
+		fsync(dir_fd);
+		close(dir_fd);
+	}
+#endif
+
+	_unsynced = false;
+	if (!open())
+		return false;
+
+	return ftruncate(_fd, 0) == 0;
+}
+
+
+void GameJournal::remove()
+{
+	_unsynced = false;
+
+	if (_fd >= 0)
+	{
+		close(_fd);
+		_fd = -1;
+	}
+
+	unlink((_path + ".journal").c_str());
+	unlink((_path + ".snapshot").c_str());
+}
+
+
+bool GameJournal::open()
+{
+	if (_fd < 0)
+		_fd = ::open((_path + ".journal").c_str(),
+					 O_WRONLY | O_CREAT | O_APPEND | O_BINARY, 0644);
+
+	return _fd >= 0;
+}
+
+
+bool GameJournal::write_all(int fd, const std::string& data)
+{
+	std::string::size_type done = 0;
+	while (done < data.length())
+	{
+		ssize_t written = write(fd, data.data() + done, data.length() - done);
+		if (written < 0 && errno == EINTR)
+			continue;
+		if (written <= 0)
+			return false;
+		done += written;
+	}
+
+	return true;
+}
+
+
+// Only whole lines, as the last one may have been cut short
+bool GameJournal::read_lines(const std::string& filename,
+							 std::vector<std::string> *lines)
+{
+	FILE *file = fopen(filename.c_str(), "rb");
+	if (!file)
+		return false;
+
+	std::string contents;
+	char buffer[4096];
+	size_t count;
+
+	while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		contents.append(buffer, count);
+	fclose(file);
+
+	std::string::size_type start = 0, end;
+	while ((end = contents.find('\n', start)) != std::string::npos)
+	{
+		lines->push_back(contents.substr(start, end - start));
+		start = end + 1;
+	}
+
+	return true;
+}
@@ -0,0 +1,78 @@
+/*
+ *  Keeps a game on disk as it's played, so the server can pick it up
+ *  again after it stops.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef INCL_GAME_JOURNAL_HH
+#define INCL_GAME_JOURNAL_HH
+
+#include <string>
+#include <vector>
+
+
+// A game is kept in two files, both of lines of text:
+//
+//   path.snapshot  the whole game as it was at some point, replaced all
+//                  at once so it's never seen half written
+//   path.journal   the records of what's happened since, appended one
+//                  at a time and started again with each snapshot
+//
+// Records are written as they're appended, but only fsynced by sync(),
+// so one fsync covers however many came in since the last.  A record
+// that was half written when the server stopped is left out when the
+// journal's read back.  What the lines say is up to GameServer.
+class GameJournal
+{
+public:
+	GameJournal(const std::string& path);
+	~GameJournal();
+
+	// The snapshot's lines, and those of the records after it, without
+	// their newlines.  False if there's no snapshot.
+	bool load(std::vector<std::string> *snapshot,
+			  std::vector<std::string> *records) const;
+
+	// record is a line, without its newline
+	bool append(const std::string& record);
+	// Whether anything's been appended since the last sync
+	bool pending() const;
+	// Waits for everything appended to be on the disk
+	bool sync();
+
+	// Replaces the snapshot, which covers everything appended so far, so
+	// the journal can start again
+	bool save_snapshot(const std::string& snapshot);
+
+	// For a game that's over for good
+	void remove();
+
+private:
+	GameJournal(const GameJournal& journal);
+	GameJournal& operator=(const GameJournal& journal);
+
+	bool open();
+	static bool write_all(int fd, const std::string& data);
+	static bool read_lines(const std::string& filename,
+						   std::vector<std::string> *lines);
+
+	std::string		_path;
+	int				_fd;
+	bool			_unsynced;
+};
+
+#endif   // #ifndef INCL_GAME_JOURNAL_HH
@@ -0,0 +1,776 @@
+/*
+ *  Serves many GameServer rooms on one port.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include <glib.h>
+#include <glibmm/fileutils.h>
+#include <sigc++/bind.h>
+#include <sigc++/bind_return.h>
+
+#include "utility.hh"
+#include "command_table.hh"
+#include "game_lobby.hh"
+
+
+using namespace Gnet;
+
+
+// Reads "players [long_jumps hop_others stop_others]", the rules being 0
+// or 1 and left off from the end if they're 0.  num_players is kept as it
+// was if it's left off too.  False if there's anything else in arguments.
+static bool read_room_rules(StrView arguments, unsigned int *num_players,
+							bool *long_jumps, bool *hop_others,
+							bool *stop_others)
+{
+	unsigned int rules[3] = {0, 0, 0};
+
+	if (arguments.take_uint(num_players))
+		for (unsigned int i = 0; i < 3; i++)
+			if (!arguments.take_uint(&rules[i]) || rules[i] > 1)
+				break;
+
+	*long_jumps = rules[0];
+	*hop_others = rules[1];
+	*stop_others = rules[2];
+
+	return arguments.trim().empty() && rules[0] <= 1 && rules[1] <= 1 &&
+		rules[2] <= 1;
+}
+
+GameLobby::GameLobby(unsigned int port, unsigned int num_players,
+					 bool long_jumps, bool hop_others, bool stop_others,
+					 unsigned int num_threads)
+	:_port(port),
+	 _shards(num_threads ? num_threads : 1),
+	 _console_room(1),
+	 _next_room(1),
+	 _max_rooms(1000),
+	 _bot_node_limit(0)
+{
+	_socket.evt_connection_available.connect(sigc::mem_fun(*this,
+		&GameLobby::add_client));
+
+	for (unsigned int s = 0; s < _shards.size(); s++)
+	{
+		Shard& shard = _shards[s];
+
+		if (s == 0)
+		{
+			shard.context = Glib::MainContext::get_default();
+			shard.thread = NULL;
+		}
+		else
+		{
+			shard.context = Glib::MainContext::create();
+			shard.loop = Glib::MainLoop::create(shard.context);
+			shard.thread = Glib::Thread::create(sigc::bind(sigc::ptr_fun(
+				&GameLobby::run_shard), shard.loop), true);
+		}
+
+		shard.context->signal_timeout().connect(sigc::bind(sigc::mem_fun(
+			*this, &GameLobby::update_rooms), s), UPDATE_TIME * 1000);
+	}
+
+	// Room 1 is always there, for clients that don't know about rooms, and
+	// being in shard 0 it's set up right away
+	create_room(num_players, long_jumps, hop_others, stop_others);
+}
+
+
+GameLobby::~GameLobby()
+{
+	close();
+}
+
+
+bool GameLobby::listen()
+{
+	return _socket.listen(_port, true);
+}
+
+
+bool GameLobby::ready() const
+{
+	return _socket.ready();
+}
+
+
+void GameLobby::close()
+{
+	_socket.close();
+
+	while (!_clients.empty())
+		remove_client(_clients.begin()->first);
+
+	close_rooms(0);
+
+	for (unsigned int s = 1; s < _shards.size(); s++)
+		if (_shards[s].thread)
+		{
+			run_in_shard(s, sigc::bind(sigc::mem_fun(*this,
+				&GameLobby::close_rooms), s));
+			_shards[s].thread->join();
+			_shards[s].thread = NULL;
+		}
+}
+
+
+void GameLobby::set_max_rooms(unsigned int max_rooms)
+{
+	Glib::Mutex::Lock lock(_mutex);
+	_max_rooms = max_rooms;
+}
+
+
+void GameLobby::set_bot_node_limit(unsigned long nodes)
+{
+	{
+		Glib::Mutex::Lock lock(_mutex);
+		_bot_node_limit = nodes;
+	}
+
+	get_first_room()->set_bot_node_limit(nodes);
+}
+
+
+void GameLobby::set_archive(const std::string& path)
+{
+	{
+		Glib::Mutex::Lock lock(_mutex);
+		_archive_path = path;
+	}
+
+	get_first_room()->set_archive(path);
+}
+
+
+void GameLobby::set_journal_dir(const std::string& dir)
+{
+	std::vector<unsigned int> kept;
+
+	g_mkdir_with_parents(dir.c_str(), 0755);
+	try
+	{
+		Glib::Dir files(dir);
+		for (Glib::DirIterator f = files.begin(); f != files.end(); f++)
+		{
+			std::string name = *f;
+			StrView prefix, rest, number;
+			unsigned int room;
+
+			// room-<room>.snapshot
+			StrView(name).split('-', &prefix, &rest);
+			rest.split('.', &number, &rest);
+			if (prefix == StrView("room") && rest == StrView("snapshot") &&
+				number.to_uint(&room) && room > 1)
+				kept.push_back(room);
+		}
+	}
+	catch (Glib::FileError error)
+	{
+		message("Couldn't read " + dir + ", so games won't be kept.");
+		return;
+	}
+
+	std::vector<unsigned int> shards;
+	{
+		Glib::Mutex::Lock lock(_mutex);
+		_journal_dir = dir;
+
+		// The game kept will set the room up as it was
+		for (unsigned int k = 0; k < kept.size(); k++)
+		{
+			shards.push_back(add_room(kept[k], 1, false, false, false));
+			_rooms[kept[k]].restored = true;
+			if (_next_room <= kept[k])
+				_next_room = kept[k] + 1;
+		}
+	}
+
+	get_first_room()->set_journal(dir + "/room-1");
+
+	for (unsigned int k = 0; k < kept.size(); k++)
+		if (shards[k] == 0)
+			build_room(kept[k]);
+		else
+			run_in_shard(shards[k], sigc::bind(sigc::mem_fun(*this,
+				&GameLobby::build_room), kept[k]));
+}
+
+
+GameServer* GameLobby::get_first_room()
+{
+	Glib::Mutex::Lock lock(_mutex);
+	std::map<unsigned int, Room>::iterator r = _rooms.find(1);
+
+	return (r != _rooms.end()) ? r->second.server : NULL;
+}
+
+
+unsigned int GameLobby::get_num_rooms()
+{
+	Glib::Mutex::Lock lock(_mutex);
+	return _rooms.size();
+}
+
+
+unsigned int GameLobby::get_num_threads() const
+{
+	return _shards.size();
+}
+
+
+unsigned int GameLobby::create_room(unsigned int num_players,
+									bool long_jumps, bool hop_others,
+									bool stop_others)
+{
+	unsigned int room, shard;
+
+	if (num_players < 1) num_players = 1;
+	if (num_players > 6) num_players = 6;
+
+	{
+		Glib::Mutex::Lock lock(_mutex);
+
+		if (_rooms.size() >= _max_rooms)
+			return 0;
+
+		room = _next_room++;
+		shard = add_room(room, num_players, long_jumps, hop_others,
+						 stop_others);
+	}
+
+	if (shard == 0)
+		build_room(room);
+	else
+		run_in_shard(shard, sigc::bind(sigc::mem_fun(*this,
+			&GameLobby::build_room), room));
+
+	return room;
+}
+
+
+unsigned int GameLobby::add_room(unsigned int room, unsigned int num_players,
+								 bool long_jumps, bool hop_others,
+								 bool stop_others)
+{
+	Room& r = _rooms[room];
+	r.server = NULL;
+	r.shard = (room - 1) % _shards.size();
+	r.num_players = num_players;
+	r.long_jumps = long_jumps;
+	r.hop_others = hop_others;
+	r.stop_others = stop_others;
+	r.connected = 0;
+	r.spectators = 0;
+	r.status = GameServer::WaitingForPlayers;
+	r.idle_time = 0;
+	r.restored = false;
+
+	return r.shard;
+}
+
+
+void GameLobby::parse_command(Glib::ustring message)
+{
+	typedef void (GameLobby::*Handler)(const StrView&);
+	typedef CommandTable<Handler> Commands;
+	static const Commands::Entry entries[] = {
+		{ "rooms", &GameLobby::console_rooms },
+		{ "room", &GameLobby::console_room },
+		{ "newroom", &GameLobby::console_newroom },
+		{ "help", &GameLobby::console_help },
+		{ "?", &GameLobby::console_help }
+	};
+	static const Commands commands(entries);
+
+	util::trim(message);
+
+	StrView command, arguments;
+	StrView(message.raw()).split(' ', &command, &arguments);
+
+	Handler handler = commands.find(command);
+	if (handler)
+		(this->*handler)(arguments.trim());
+	else
+		run_in_shard((_console_room - 1) % _shards.size(), sigc::bind(
+			sigc::mem_fun(*this, &GameLobby::run_command), message,
+			_console_room));
+}
+
+
+void GameLobby::console_rooms(const StrView& arguments)
+{
+	std::vector<Glib::ustring> lines;
+	{
+		Glib::Mutex::Lock lock(_mutex);
+		for (std::map<unsigned int, Room>::iterator r = _rooms.begin();
+			 r != _rooms.end(); r++)
+			lines.push_back("Room " + util::to_str(r->first) + ": " +
+				util::to_str(r->second.connected) + "/" +
+				util::to_str(r->second.num_players) + " players, " +
+				util::to_str(r->second.spectators) + " spectators, thread " +
+				util::to_str(r->second.shard));
+	}
+
+	for (unsigned int i = 0; i < lines.size(); i++)
+		message(lines[i]);
+}
+
+
+void GameLobby::console_room(const StrView& arguments)
+{
+	unsigned int room = 0;
+	bool found = false;
+	if (arguments.to_uint(&room))
+	{
+		Glib::Mutex::Lock lock(_mutex);
+		found = (_rooms.find(room) != _rooms.end());
+	}
+
+	if (found)
+	{
+		_console_room = room;
+		message("Commands now go to room " + util::to_str(room) + ".");
+	}
+	else
+		message("Room " + util::to_text(arguments) + " does not exist.");
+}
+
+
+void GameLobby::console_newroom(const StrView& arguments)
+{
+	unsigned int num_players = 3;
+	bool long_jumps, hop_others, stop_others;
+
+	if (!read_room_rules(arguments, &num_players, &long_jumps, &hop_others,
+						 &stop_others))
+	{
+		message("Use newroom players [long_jumps hop_others stop_others], "
+				"the rules being 0 or 1.");
+		return;
+	}
+	if (num_players < 1 || num_players > 6)
+	{
+		message("Rooms are for 1 to 6 players.");
+		return;
+	}
+
+	unsigned int room = create_room(num_players, long_jumps, hop_others,
+									stop_others);
+	if (room)
+		message("Created room " + util::to_str(room) + ".");
+	else
+		message("There are too many rooms already.");
+}
+
+
+void GameLobby::console_help(const StrView& arguments)
+{
+	help();
+}
+
+
+void GameLobby::help()
+{
+	message("Lobby commands: rooms, room #, newroom players [long_jumps "
+			"hop_others stop_others]");
+	run_in_shard((_console_room - 1) % _shards.size(), sigc::bind(
+		sigc::mem_fun(*this, &GameLobby::run_command), Glib::ustring("help"),
+		_console_room));
+}
+
+
+void GameLobby::add_client(Conn *socket)
+{
+	Client& client = _clients[socket];
+
+	client.data = socket->evt_data_available.connect(sigc::bind(
+		sigc::mem_fun(*this, &GameLobby::read_client), socket));
+	client.closed = socket->evt_closed.connect(sigc::bind(
+		sigc::mem_fun(*this, &GameLobby::remove_client), socket));
+
+	*socket << "HELLO " PROTO_VERSION "\n";
+}
+
+
+void GameLobby::remove_client(Conn *socket)
+{
+	forget_client(socket);
+	delete socket;
+}
+
+
+// Once a client has joined a room, that room's GameServer looks after it
+void GameLobby::forget_client(Conn *socket)
+{
+	std::map<Conn*, Client>::iterator c = _clients.find(socket);
+
+	if (c == _clients.end())
+		return;
+
+	c->second.data.disconnect();
+	c->second.closed.disconnect();
+	_clients.erase(c);
+}
+
+
+void GameLobby::read_client(Glib::ustring message, Conn *socket)
+{
+	typedef void (GameLobby::*Handler)(Conn*, const StrView&);
+	typedef CommandTable<Handler> Commands;
+	static const Commands::Entry entries[] = {
+		{ "ROOM_LIST", &GameLobby::command_ROOM_LIST },
+		{ "ROOM_CREATE", &GameLobby::command_ROOM_CREATE },
+		{ "ROOM_JOIN", &GameLobby::command_ROOM_JOIN }
+	};
+	static const Commands commands(entries);
+
+	StrView command, arguments;
+	StrView(message.raw()).split(' ', &command, &arguments);
+
+	Handler handler = commands.find(command);
+	if (handler)
+		(this->*handler)(socket, arguments);
+	else if (get_first_room())
+		join_room(socket, 1, message);
+	else
+		*socket << "ROOM_ERROR Join a room first.\n";
+}
+
+
+// Only for rooms in shard 0
+void GameLobby::join_room(Conn *socket, unsigned int room,
+						  const Glib::ustring& message)
+{
+	GameServer *server;
+	{
+		Glib::Mutex::Lock lock(_mutex);
+		server = _rooms[room].server;
+	}
+
+	forget_client(socket);
+	server->join_client(socket, message);
+}
+
+
+// Called from the main loop once the socket's read handler has returned,
+// since it's deleted here
+void GameLobby::hand_off_client(Conn *socket, unsigned int room)
+{
+	if (!socket->detach())
+	{
+		delete socket;
+		return;
+	}
+
+	run_in_shard((room - 1) % _shards.size(), sigc::bind(sigc::mem_fun(*this,
+		&GameLobby::adopt_client), socket, room));
+}
+
+
+void GameLobby::adopt_client(Conn *socket, unsigned int room)
+{
+	unsigned int shard = (room - 1) % _shards.size();
+	socket->attach(_shards[shard].context->gobj());
+	GameServer *server = NULL;
+	{
+		Glib::Mutex::Lock lock(_mutex);
+		std::map<unsigned int, Room>::iterator r = _rooms.find(room);
+		if (r != _rooms.end())
+			server = r->second.server;
+	}
+
+	if (!server)
+	{
+		*socket << "ROOM_ERROR Room " + util::to_str(room) +
+			" has closed.\n";
+		socket->evt_closed.connect(sigc::bind(sigc::mem_fun(*this,
+			&GameLobby::drop_client), socket));
+		// Delayed the close so the message can get there first
+		_shards[shard].context->signal_timeout().connect(sigc::bind_return(
+			sigc::mem_fun(*socket, &Conn::close), false), 100);
+		return;
+	}
+
+	*socket << "ROOM_JOINED " + util::to_str(room) + "\n";
+	server->join_client(socket);
+}
+
+
+void GameLobby::drop_client(Conn *socket)
+{
+	delete socket;
+}
+
+
+void GameLobby::build_room(unsigned int room)
+{
+	unsigned int shard, num_players;
+	bool long_jumps, hop_others, stop_others;
+	unsigned long bot_node_limit;
+	std::string journal_dir, archive_path;
+	{
+		Glib::Mutex::Lock lock(_mutex);
+		std::map<unsigned int, Room>::iterator r = _rooms.find(room);
+		if (r == _rooms.end())
+			return;
+
+		shard = r->second.shard;
+		num_players = r->second.num_players;
+		long_jumps = r->second.long_jumps;
+		hop_others = r->second.hop_others;
+		stop_others = r->second.stop_others;
+		bot_node_limit = _bot_node_limit;
+		journal_dir = _journal_dir;
+		archive_path = _archive_path;
+	}
+
+	// Port 0 keeps the room from listening for itself
+	GameServer *server = new GameServer(0, num_players, long_jumps,
+		hop_others, stop_others, _shards[shard].context);
+	server->evt_message.connect(sigc::bind(sigc::mem_fun(*this,
+		&GameLobby::room_message), room));
+	if (bot_node_limit)
+		server->set_bot_node_limit(bot_node_limit);
+	server->new_game();
+	if (!archive_path.empty())
+		server->set_archive(archive_path);
+	if (!journal_dir.empty())
+		server->set_journal(journal_dir + "/room-" + util::to_str(room));
+
+	Glib::Mutex::Lock lock(_mutex);
+	_rooms[room].server = server;
+}
+
+
+void GameLobby::run_command(Glib::ustring message, unsigned int room)
+{
+	GameServer *server = NULL;
+	{
+		Glib::Mutex::Lock lock(_mutex);
+		std::map<unsigned int, Room>::iterator r = _rooms.find(room);
+		if (r != _rooms.end())
+			server = r->second.server;
+	}
+
+	if (server)
+		server->parse_command(message);
+	else
+		this->message("Room " + util::to_str(room) +
+					  " has closed.  Choose another with \"room #\".");
+}
+
+
+// Copies out each room's numbers for the other threads, and closes rooms,
+// besides room 1 and those waiting for their players to come back after
+// a restart, that have had no one in them for IDLE_TIME
+bool GameLobby::update_rooms(unsigned int shard)
+{
+	std::vector<GameServer*> closing;
+	{
+		Glib::Mutex::Lock lock(_mutex);
+		std::map<unsigned int, Room>::iterator r = _rooms.begin();
+
+		while (r != _rooms.end())
+		{
+			Room& room = r->second;
+
+			if (room.shard != shard || !room.server)
+			{
+				r++;
+				continue;
+			}
+
+			// The game it picked up from its journal may be for more or
+			// fewer players
+			room.num_players = room.server->get_num_players();
+			room.connected = room.server->get_num_connected_players();
+			room.spectators = room.server->get_num_spectators();
+			room.status = room.server->get_game_status();
+
+			if (room.server->get_num_clients())
+				room.restored = false;
+			if (r->first == 1 || room.restored ||
+				room.server->get_num_clients())
+				room.idle_time = 0;
+			else
+				room.idle_time += UPDATE_TIME;
+
+			if (room.idle_time >= IDLE_TIME)
+			{
+				closing.push_back(room.server);
+				_rooms.erase(r++);
+			}
+			else
+				r++;
+		}
+	}
+
+	// Without the lock, as they'll send out messages
+	for (unsigned int i = 0; i < closing.size(); i++)
+	{
+		closing[i]->end_game();
+		closing[i]->remove_journal();
+		delete closing[i];
+	}
+
+	return true;
+}
+
+
+void GameLobby::close_rooms(unsigned int shard)
+{
+	std::vector<GameServer*> closing;
+	{
+		Glib::Mutex::Lock lock(_mutex);
+		std::map<unsigned int, Room>::iterator r = _rooms.begin();
+
+		while (r != _rooms.end())
+			if (r->second.shard == shard)
+			{
+				if (r->second.server)
+					closing.push_back(r->second.server);
+				_rooms.erase(r++);
+			}
+			else
+				r++;
+	}
+
+	for (unsigned int i = 0; i < closing.size(); i++)
+	{
+		closing[i]->end_game();
+		delete closing[i];
+	}
+
+	if (_shards[shard].loop)
+		_shards[shard].loop->quit();
+}
+
+
+void GameLobby::message(const Glib::ustring& text)
+{
+	Glib::Mutex::Lock lock(_message_mutex);
+	evt_message(text);
+}
+
+
+void GameLobby::room_message(Glib::ustring text, unsigned int room)
+{
+	if (room == 1)
+		message(text);
+	else
+		message("[room " + util::to_str(room) + "] " + text);
+}
+
+
+void GameLobby::run_shard(Glib::RefPtr<Glib::MainLoop> loop)
+{
+	loop->run();
+}
+
+
+// Runs slot from shard's main loop, or right away for shard 0, which is
+// the caller's
+void GameLobby::run_in_shard(unsigned int shard, const sigc::slot<void>& slot)
+{
+	if (shard == 0)
+		slot();
+	else
+		_shards[shard].context->signal_idle().connect(sigc::bind_return(slot,
+			false));
+}
+
+
+void GameLobby::command_ROOM_LIST(Conn *socket, const StrView& arguments)
+{
+	static const char *statuses[] = {"waiting", "starting", "playing",
+									 "won", "ended"};
+	Glib::ustring list;
+	{
+		Glib::Mutex::Lock lock(_mutex);
+		for (std::map<unsigned int, Room>::iterator r = _rooms.begin();
+			 r != _rooms.end(); r++)
+			list += "ROOM_INFO " + util::to_str(r->first) + " " +
+				util::to_str(r->second.connected) + "/" +
+				util::to_str(r->second.num_players) + " " +
+				util::to_str(r->second.spectators) + " " +
+				statuses[r->second.status] + "\n";
+	}
+
+	*socket << list + "ROOM_LIST_END\n";
+}
+
+
+void GameLobby::command_ROOM_CREATE(Conn *socket, const StrView& arguments)
+{
+	unsigned int num_players = 0;
+	bool long_jumps, hop_others, stop_others;
+
+	if (!read_room_rules(arguments, &num_players, &long_jumps, &hop_others,
+						 &stop_others))
+	{
+		*socket << "ROOM_ERROR Use ROOM_CREATE players [long_jumps "
+			"hop_others stop_others], the rules being 0 or 1.\n";
+		return;
+	}
+	if (num_players < 1 || num_players > 6)
+	{
+		*socket << "ROOM_ERROR Rooms are for 1 to 6 players.\n";
+		return;
+	}
+
+	unsigned int room = create_room(num_players, long_jumps, hop_others,
+									stop_others);
+	if (room)
+		*socket << "ROOM_CREATED " + util::to_str(room) + "\n";
+	else
+		*socket << "ROOM_ERROR Sorry, there are too many rooms already.\n";
+}
+
+
+void GameLobby::command_ROOM_JOIN(Conn *socket, const StrView& arguments)
+{
+	unsigned int room = 0;
+	bool found = false;
+	if (arguments.trim().to_uint(&room))
+	{
+		Glib::Mutex::Lock lock(_mutex);
+		found = (_rooms.find(room) != _rooms.end());
+	}
+
+	if (!found)
+	{
+		*socket << "ROOM_ERROR There's no room " + util::to_text(arguments) +
+			".\n";
+		return;
+	}
+
+	if ((room - 1) % _shards.size() == 0)
+	{
+		*socket << "ROOM_JOINED " + util::to_str(room) + "\n";
+		join_room(socket, room, "");
+		return;
+	}
+
+	// The socket moves to the room's thread, once its read handler, which
+	// is running now, is done with it
+	forget_client(socket);
+	Glib::signal_idle().connect(sigc::bind_return(sigc::bind(sigc::mem_fun(
+		*this, &GameLobby::hand_off_client), socket, room), false));
+}
@@ -0,0 +1,198 @@
+/*
+ *  Serves many GameServer rooms on one port.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef INCL_GAME_LOBBY_HH
+#define INCL_GAME_LOBBY_HH
+
+#include <map>
+#include <vector>
+#include <sigc++/sigc++.h>
+#include <glibmm/main.h>
+#include <glibmm/thread.h>
+
+#include "str_view.hh"
+#include "gnet_server.hh"
+#include "game_server.hh"
+
+
+// Clients start out in the lobby, which takes these commands:
+//   ROOM_LIST
+//     answered with ROOM_INFO <room> <players>/<seats> <spectators> <status>
+//     for each room, then ROOM_LIST_END
+//   ROOM_CREATE <num_players> [long_jumps hop_others stop_others]
+//     answered with ROOM_CREATED <room>
+//   ROOM_JOIN <room>
+//     answered with ROOM_JOINED <room>, after which the client is talking
+//     to that room's GameServer.  Clients mustn't send anything else
+//     until then, as they may be moving to another thread.
+// Problems are answered with ROOM_ERROR <message>.  Any other command
+// joins room 1 and goes on to it, so older clients play there as if the
+// server only had the one game.  Rooms besides room 1 are closed once
+// they've been empty for a while, except that a room picked up from its
+// journal waits for someone to come back to it first.
+//
+// Rooms are shared out among num_threads shards, each running its own
+// main loop.  The lobby and room 1 are in shard 0, the main thread's
+// default main loop; everything else about a room, its clients' sockets
+// included, belongs to its shard's thread.
+//
+// The lobby isn't a sigc::trackable, as the slots it makes are connected
+// and destroyed on whichever thread has the room, which a trackable's
+// list of them couldn't stand.  They're untracked instead, and close()
+// stops every shard before the lobby goes.
+class GameLobby
+{
+public:
+	GameLobby(unsigned int port, unsigned int num_players, bool long_jumps,
+			  bool hop_others, bool stop_others, unsigned int num_threads = 1);
+	virtual ~GameLobby();
+
+	bool listen();
+	bool ready() const;
+	void close();
+
+	void set_max_rooms(unsigned int max_rooms);
+	// For room 1 and rooms created after
+	void set_bot_node_limit(unsigned long nodes);
+	// Adds every room's finished games to the GameArchive at path
+	void set_archive(const std::string& path);
+	// Keeps each room's game in dir, as room-<room>.snapshot and
+	// .journal, and opens again the rooms that were kept there when the
+	// server last stopped.  Before listen().
+	void set_journal_dir(const std::string& dir);
+
+	// Room 1, in the main thread, so safe to use from there
+	GameServer* get_first_room();
+	unsigned int get_num_rooms();
+	unsigned int get_num_threads() const;
+
+	// Adds a room for num_players, returning its number, or 0 if there
+	// are already too many
+	unsigned int create_room(unsigned int num_players, bool long_jumps,
+							 bool hop_others, bool stop_others);
+
+	// Console commands, which go to the room chosen with "room #"
+	void parse_command(Glib::ustring message);
+	void help();
+
+	// Emitted from whichever thread the message came from, one at a time
+	sigc::signal<void, Glib::ustring> evt_message;
+
+private:
+	GameLobby(const GameLobby& lobby);
+	GameLobby& operator=(const GameLobby& lobby);
+
+	const static int UPDATE_TIME = 1;
+	const static int IDLE_TIME = 60;
+
+	class Room
+	{
+	public:
+		// NULL until its shard has set it up
+		GameServer				*server;
+		unsigned int			shard;
+		unsigned int			num_players;
+		bool					long_jumps;
+		bool					hop_others;
+		bool					stop_others;
+
+		// Copied from the server by its shard every UPDATE_TIME, for the
+		// other threads to read
+		unsigned int			connected;
+		unsigned int			spectators;
+		GameServer::GameStatus	status;
+		// Seconds it's been without clients
+		unsigned int			idle_time;
+		// Picked up from its journal at start, so it's kept open, however
+		// long it's empty, until someone comes back to it
+		bool					restored;
+	};
+
+	class Shard
+	{
+	public:
+		Glib::RefPtr<Glib::MainContext>	context;
+		Glib::RefPtr<Glib::MainLoop>	loop;
+		Glib::Thread					*thread;
+	};
+
+	class Client
+	{
+	public:
+		sigc::connection	data;
+		sigc::connection	closed;
+	};
+
+	// With _mutex held, returning the room's shard
+	unsigned int add_room(unsigned int room, unsigned int num_players,
+						  bool long_jumps, bool hop_others, bool stop_others);
+
+	// In the main thread
+	void add_client(Gnet::Conn *socket);
+	void remove_client(Gnet::Conn *socket);
+	void forget_client(Gnet::Conn *socket);
+	void read_client(Glib::ustring message, Gnet::Conn *socket);
+	void join_room(Gnet::Conn *socket, unsigned int room,
+				   const Glib::ustring& message);
+	void hand_off_client(Gnet::Conn *socket, unsigned int room);
+
+	// In the room's shard's thread
+	void adopt_client(Gnet::Conn *socket, unsigned int room);
+	void drop_client(Gnet::Conn *socket);
+	void build_room(unsigned int room);
+	void run_command(Glib::ustring message, unsigned int room);
+	bool update_rooms(unsigned int shard);
+	void close_rooms(unsigned int shard);
+
+	// The shard threads' main
+	static void run_shard(Glib::RefPtr<Glib::MainLoop> loop);
+
+	// In any thread
+	void message(const Glib::ustring& text);
+	void room_message(Glib::ustring text, unsigned int room);
+	void run_in_shard(unsigned int shard, const sigc::slot<void>& slot);
+
+	void console_rooms(const StrView& arguments);
+	void console_room(const StrView& arguments);
+	void console_newroom(const StrView& arguments);
+	void console_help(const StrView& arguments);
+
+	void command_ROOM_LIST(Gnet::Conn *socket, const StrView& arguments);
+	void command_ROOM_CREATE(Gnet::Conn *socket, const StrView& arguments);
+	void command_ROOM_JOIN(Gnet::Conn *socket, const StrView& arguments);
+
+	Gnet::Server						_socket;
+	unsigned int						_port;
+	std::vector<Shard>					_shards;
+	std::map<Gnet::Conn*, Client>		_clients;
+	unsigned int						_console_room;
+
+	// Guards everything below
+	Glib::Mutex							_mutex;
+	std::map<unsigned int, Room>		_rooms;
+	unsigned int						_next_room;
+	unsigned int						_max_rooms;
+	unsigned long						_bot_node_limit;
+	std::string							_journal_dir;
+	std::string							_archive_path;
+
+	Glib::Mutex							_message_mutex;
+};
+
+#endif   // #ifndef INCL_GAME_LOBBY_HH
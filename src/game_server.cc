@@ -20,13 +20,22 @@
 #include <iostream>
 #include <vector>
 #include <algorithm>
+#include <cstring>
+#include <ctime>
 #include <glibmm/main.h>
+#include <glibmm/random.h>
+#include <glibmm/timer.h>
 #include <sigc++/bind.h>
 #include <sigc++/bind_return.h>
 
 #include "utility.hh"
 #include "game_server.hh"
 #include "ajax_server.hh"
+#include "bot_base.hh"
+#include "proto_codec.hh"
+#include "command_table.hh"
+#include "game_journal.hh"
+#include "game_archive.hh"
 
 // #define DEBUG_SERVER 1
 
@@ -34,22 +43,71 @@
 using namespace std;
 using namespace Gnet;
 
+GameServer::Session::Session(const std::string& token_)
+	:token(token_),
+	 sent(0)
+{
+}
+
+
+GameServer::Session::~Session()
+{
+	expiry.disconnect();
+}
+
+
+// Keeps whole lines, as the player would have read them
+void GameServer::Session::record(const gchar *data, unsigned long count)
+{
+	std::string::size_type start = 0, end;
+
+	partial.append(data, count);
+	while ((end = partial.find('\n', start)) != std::string::npos)
+	{
+		StrView command, arguments;
+		StrView(partial.data() + start, end - start).split(' ', &command,
+															&arguments);
+
+		if (!ProtoCodec::session_command(command))
+		{
+			log.push_back(partial.substr(start, end + 1 - start));
+			if (log.size() > SESSION_LOG)
+				log.pop_front();
+			sent++;
+		}
+		start = end + 1;
+	}
+	partial.erase(0, start);
+}
+
+
 GameServer::Player::Player(Conn *socket_, Glib::ustring name_,
 	unsigned int color_, Glib::ustring location_,
-	unsigned int heartbeat_, bool spectator_)
+	unsigned int heartbeat_, bool spectator_, BotBase *bot_, Conn *owner_)
 	:socket(socket_),
 	 name(name_),
 	 color(color_),
 	 location(location_),
 	 heartbeat(heartbeat_),
-	 spectator(spectator_)
+	 spectator(spectator_),
+	 bot(bot_),
+	 owner(owner_)
+{
+}
+
+
+bool GameServer::Player::seated() const
 {
+	return (socket != NULL || bot != NULL || session);
 }
 
 
 GameServer::GameServer(unsigned int port, unsigned int num_players,
-					  bool long_jumps, bool hop_others, bool stop_others)
-	:_players(7), // the _players vector is 1-based!! (0 is not used)
+					  bool long_jumps, bool hop_others, bool stop_others,
+					  Glib::RefPtr<Glib::MainContext> context)
+	:_context(context),
+	 _open(false),
+	 _players(7), // the _players vector is 1-based!! (0 is not used)
 	 _spectators(0), // the _spectators vector is 0-based
 	 _num_connected_players(0),
 	 _num_players(num_players),
@@ -59,19 +117,64 @@ GameServer::GameServer(unsigned int port, unsigned int num_players,
 	 _hop_others(hop_others),
 	 _stop_others(stop_others),
 	 _current_player(0),
-	 _move_count(1)
+	 _move_count(1),
+	 _board_version(0),
+	 _num_finished(0),
+	 _bot_node_limit(BOT_NODE_LIMIT),
+	 _turn_posn(0),
+	 _bot_thread(NULL),
+	 _bot_done(NULL),
+	 _search_bot(NULL),
+	 _search_board(NULL),
+	 _search_posn(0),
+	 _search_version(0),
+	 _search_found(false),
+	 _search_waiting(false),
+	 _search_finished(false),
+	 _search_removed(false),
+	 _bot_stopping(false),
+	 _journal(NULL),
+	 _journal_records(0)
 {
+	for (unsigned int i = 0; i <= 6; i++)
+		_finish_place[i] = _finish_moves[i] = 0;
+
 	_board = NULL;
 	_socket.evt_connection_available.connect(sigc::mem_fun(*this,
 		&GameServer::add_client));
 
-	Glib::signal_timeout().connect(sigc::bind_return(sigc::mem_fun(*this,
+	_context->signal_timeout().connect(sigc::bind_return(sigc::mem_fun(*this,
 		&GameServer::heartbeat_players), true), HEARTBEAT_TIME * 1000);
 }
 
 
 GameServer::~GameServer()
 {
+	if (_bot_thread)
+	{
+		{
+			Glib::Mutex::Lock lock(_bot_mutex);
+			_bot_stopping = true;
+			if (_search_bot)
+				_search_bot->abort_search();
+			_bot_cond.signal();
+		}
+		_bot_thread->join();
+		delete _bot_done;
+	}
+
+	for (unsigned int i = 1; i <= 6; i++)
+		if (_players[i].bot)
+			delete _players[i].bot;
+	if (_search_removed)
+		delete _search_bot;
+	if (_search_board)
+		delete _search_board;
+
+	_journal_sync.disconnect();
+	if (_journal)
+		delete _journal;
+
 	if (_board)
 		delete _board;
 }
@@ -89,9 +192,39 @@ unsigned int GameServer::get_num_players() const
 }
 
 
+unsigned int GameServer::get_num_connected_players() const
+{
+	return _num_connected_players;
+}
+
+
+unsigned int GameServer::get_num_spectators() const
+{
+	unsigned int count = 0;
+
+	for (unsigned int i = 0; i < _spectators.size(); i++)
+		if (_spectators[i].socket != NULL)
+			count++;
+
+	return count;
+}
+
+
+unsigned int GameServer::get_num_clients() const
+{
+	unsigned int count = get_num_spectators();
+
+	for (unsigned int i = 1; i <= 6; i++)
+		if (_players[i].socket != NULL)
+			count++;
+
+	return count;
+}
+
+
 bool GameServer::ready() const
 {
-	return (_socket.ready());
+	return _open;
 }
 
 
@@ -143,10 +276,16 @@ void GameServer::parse_command(Glib::ustring message)
 			kick_player(util::from_str<unsigned int>(arguments));
 		else
 			evt_message("Bad arguments for command \"kick\"\n");
+	else if (command == "addbot")
+		add_bot(arguments.empty() ? Glib::ustring("l3") : arguments);
+	else if (command == "removebots")
+		remove_bots();
 	else if (command == "list" || command == "l")
 	{
 		for (unsigned int i = 1; i <= 6; i++)
-			if (_players[i].socket != 0)
+			if (_players[i].bot)
+				evt_message(util::to_str(i) + ": " + _players[i].name + " (bot)");
+			else if (_players[i].socket != 0)
 				evt_message(util::to_str(i) + ": " + _players[i].name);
 		for (unsigned int i = 0; i < _spectators.size(); i++)
 			if (_spectators[i].socket != 0)
@@ -165,7 +304,8 @@ void GameServer::parse_command(Glib::ustring message)
 void GameServer::help()
 {
 	evt_message("Available commands: start, restart, end, pack, "
-				"rotate, shuffle, resync, list, kick #, help");
+				"rotate, shuffle, resync, list, kick #, addbot type, "
+				"removebots, help");
 }
 
 
@@ -173,7 +313,8 @@ void GameServer::new_game()
 {
 	end_game();
 
-	if (_socket.listen(_port, true))
+	_open = (_port == 0 || _socket.listen(_port, true));
+	if (_open)
 	{
 		restart_game();
 	}
@@ -207,6 +348,12 @@ void GameServer::restart_game()
 	_undo_stack.clear();
 	_redo_stack.clear();
 	_move_count = 1;
+	for (unsigned int i = 0; i <= 6; i++)
+		_finish_place[i] = _finish_moves[i] = 0;
+	_num_finished = 0;
+	// Changes from before now are no use to anyone
+	_board_version++;
+	_board_changes.clear();
 
 	Glib::ustring message = "Starting a new game for " +
 		util::to_str(_board->get_num_players()) + " player(s) ...";
@@ -217,11 +364,18 @@ void GameServer::restart_game()
 	for (unsigned int i = 1; i <= 6; i++)
 		if (_players[i].socket != 0)
 			prepare_player(_players[i].socket);
+		else if (_players[i].session)
+		{
+			std::string setup = get_setup(i);
+			_players[i].session->record(setup.data(), setup.length());
+		}
 	for (unsigned int i = 0; i < _spectators.size(); i++)
 		if (_spectators[i].socket != 0)
 			prepare_player(_spectators[i].socket);
 
 	_current_player = 1;
+	if (_journal)
+		save_snapshot();
 	game_turn(1);
 }
 
@@ -238,11 +392,18 @@ void GameServer::end_game()
 	_current_player = 0;
 	game_turn(0);
 
+	remove_bots();
 	_socket.close();
+	_open = false;
 
 	for (unsigned int i = 1; i <= 6; i++)
 		if (_players[i].socket != 0)
+		{
+			end_session(i);
 			_players[i].socket->close();
+		}
+		else if (_players[i].session)
+			expire_session(_players[i].session->token);
 
 	while (!_spectators.empty())
 	{
@@ -272,10 +433,10 @@ void GameServer::pack_players()
 
 	for (unsigned int i = 1; i <= 5; i++)
 	{
-		if (_players[i].socket == 0)
+		if (!_players[i].seated())
 		{
 			unsigned int j;
-			for (j = i + 1; j <= 6 && _players[j].socket == 0; j++);
+			for (j = i + 1; j <= 6 && !_players[j].seated(); j++);
 			if (j > 6)
 				return;
 			swap(_players[i], _players[j]);
@@ -317,14 +478,22 @@ void GameServer::kick_player(unsigned int posn)
 	if (!ready())
 		return;
 
-	if (posn >= 1 && posn <= 6 && _players[posn].socket != NULL)
+	if (posn >= 1 && posn <= 6 && _players[posn].seated())
 	{
 		Glib::ustring message = "Kicking " + _players[posn].name
 			+ " (Player #" + util::to_str(posn) + ") ...";
 		evt_message(message);
 		*this << "CLIENT_MESSAGE " + message + "\n";
 
-		_players[posn].socket->close();
+		if (_players[posn].bot)
+			remove_bot(posn);
+		else if (_players[posn].socket == NULL)
+			expire_session(_players[posn].session->token);
+		else
+		{
+			end_session(posn);
+			_players[posn].socket->close();
+		}
 	}
 	else if (posn >= 7 && posn <= _spectators.size()+6 &&
 		_spectators[posn-7].socket != NULL)
@@ -345,20 +514,153 @@ void GameServer::kick_player(unsigned int posn)
 }
 
 
+bool GameServer::add_bot(Glib::ustring bot_type, Conn *owner)
+{
+	if (!ready())
+		return false;
+
+	Glib::ustring problem;
+	unsigned int posn = get_empty_posn();
+	BotBase *bot = NULL;
+
+	if (_num_connected_players == _num_players || !posn)
+		problem = "Sorry, this Chinese Checkers game is full.";
+	else if (!(bot = BotBase::new_bot_of_type(bot_type)))
+		problem = "There's no bot of type " + bot_type + ".";
+
+	if (bot == NULL)
+	{
+		evt_message(problem);
+		if (owner)
+			*owner << "CLIENT_MESSAGE " + problem + "\n";
+		return false;
+	}
+
+	bot->set_pump_events(false);
+	if (_bot_node_limit)
+		bot->set_node_limit(_bot_node_limit);
+
+	Glib::ustring name = bot->get_default_name();
+	for (unsigned int n = 2; get_client_posn_from_name(name); n++)
+		name = bot->get_default_name() + " " + util::to_str(n);
+
+	unsigned int color;
+	for (color = 1; color < 8; color++)
+	{
+		unsigned int i;
+		for (i = 1; i <= 6 && !(_players[i].seated() &&
+								_players[i].color == color); i++);
+		if (i > 6)
+			break;
+	}
+
+	_players[posn] = Player(NULL, name, color, "the server", _heartbeat,
+							false, bot, owner);
+	_num_connected_players++;
+
+	Glib::ustring message = name + " has joined as player "
+		+ util::to_str(posn) + ".";
+	evt_message("Server: " + message);
+	*this << "CLIENT_MESSAGE " + message + "\n";
+
+	*this << "PLAYER_ADD " + util::to_str(posn)
+		+ " " + util::to_str(color) + " " + name + "\n";
+
+	game_turn(_current_player);
+
+	return true;
+}
+
+
+void GameServer::remove_bot(unsigned int posn)
+{
+	if (posn < 1 || posn > 6 || !_players[posn].bot)
+		return;
+
+	// A bot that's still searching is deleted when its search is done
+	if (_players[posn].bot == _search_bot)
+	{
+		_search_bot->abort_search();
+		_search_removed = true;
+	}
+	else
+		delete _players[posn].bot;
+	_players[posn].bot = NULL;
+	_players[posn].owner = NULL;
+
+	Glib::ustring message = _players[posn].name + " (#"
+		+ util::to_str(posn) + ") has left the game.";
+	evt_message(message);
+	*this << "CLIENT_MESSAGE " + message + "\n";
+	*this << "PLAYER_REMOVE " + util::to_str(posn) + "\n";
+
+	_num_connected_players--;
+
+	game_turn(_current_player);
+}
+
+
+void GameServer::remove_bots(Conn *owner)
+{
+	for (unsigned int i = 1; i <= 6; i++)
+		if (_players[i].bot && (!owner || _players[i].owner == owner))
+			remove_bot(i);
+}
+
+
+void GameServer::set_bot_node_limit(unsigned long nodes)
+{
+	_bot_node_limit = nodes;
+
+	for (unsigned int i = 1; i <= 6; i++)
+		if (_players[i].bot)
+			_players[i].bot->set_node_limit(nodes);
+}
+
+
+// Encodes text just the once, for every socket to share, and frames it
+// just the once too if any of them want frames
 GameServer& GameServer::operator<<(const Glib::ustring& text)
 {
+	SharedData data = std::make_shared<const std::string>(text.raw());
+	SharedData frames;
+
 	for (unsigned int i = 1; i <= 6; i++)
 		if (_players[i].socket != 0)
-			*_players[i].socket << text;
+			write_client(_players[i].socket, data, &frames);
+		else if (_players[i].session)
+			_players[i].session->record(data->data(), data->length());
 
 	for (unsigned int i = 0; i < _spectators.size(); i++)
 		if (_spectators[i].socket != 0)
-			*_spectators[i].socket << text;
+			write_client(_spectators[i].socket, data, &frames);
 
 	return *this;
 }
 
 
+void GameServer::write_client(Conn* socket, const SharedData& data,
+							  SharedData *frames)
+{
+	if (socket->get_binary_output() && !*frames && !data->empty() &&
+		(*data)[data->length() - 1] == '\n')
+	{
+		std::string framed;
+		std::string::size_type start = 0, end;
+
+		while ((end = data->find('\n', start)) != std::string::npos)
+		{
+			ProtoCodec::encode_line(data->data() + start, end - start,
+									&framed);
+			start = end + 1;
+		}
+		*frames = std::make_shared<const std::string>(framed);
+	}
+
+	socket->write(data, *frames);
+}
+
+
 void GameServer::heartbeat_players()
 {
 	_heartbeat = (_heartbeat + 1) % TIMEOUT_HEARTBEAT;
@@ -378,34 +680,99 @@ void GameServer::heartbeat_players()
 
 void GameServer::prepare_player(Conn* socket)
 {
-	unsigned int posn = get_client_posn(socket);
+	std::string setup = get_setup(get_client_posn(socket));
+
+	socket->write(setup.data(), setup.length());
+}
+
+
+std::string GameServer::get_setup(unsigned int posn)
+{
+	std::string setup;
 
 	if (posn)
-		*socket << "SET_PLAYER_NUMBER " + util::to_str(posn) + "\n" ;
+	{
+		setup += "SET_PLAYER_NUMBER ";
+		util::append_uint(setup, posn);
+		setup += '\n';
+	}
 
-	*socket << "GAME_SETUP " + util::to_str(_board->get_num_players()) +
-		(_board->get_long_jumps_allowed()?" 1":" 0") +
-		(_board->get_hop_others_allowed()?" 1":" 0") +
-		(_board->get_stop_others_allowed()?" 1":" 0") + "\n" ;
+	setup += "GAME_SETUP ";
+	util::append_uint(setup, _board->get_num_players());
+	setup += _board->get_long_jumps_allowed() ? " 1" : " 0";
+	setup += _board->get_hop_others_allowed() ? " 1" : " 0";
+	setup += _board->get_stop_others_allowed() ? " 1" : " 0";
+	setup += '\n';
 
 	for (unsigned int i = 1; i <= 6; i++)
 	{
-		if (_players[i].socket != 0)
-			*socket << "PLAYER_ADD " + util::to_str(i) + " "
-				+ util::to_str(_players[i].color)
-				+ " " + _players[i].name + "\n";
+		if (_players[i].seated())
+		{
+			setup += "PLAYER_ADD ";
+			util::append_uint(setup, i);
+			setup += ' ';
+			util::append_uint(setup, _players[i].color);
+			setup += ' ';
+			setup += _players[i].name.raw();
+		}
 		else
-			*socket << "PLAYER_REMOVE " + util::to_str(i) + "\n";
+		{
+			setup += "PLAYER_REMOVE ";
+			util::append_uint(setup, i);
+		}
+		setup += '\n';
 	}
 
-	*socket << "GAME_BOARD";
+	setup += "GAME_BOARD";
 	for (unsigned int i = 0; i < GameBoard::SIZE; i++)
 	{
 		GameHole* hole = (*_board)[i];
 		if (hole != 0)
-			*socket << " " + util::to_str(hole->get_current_player());
+		{
+			setup += ' ';
+			util::append_uint(setup, hole->get_current_player());
+		}
+	}
+	setup += "\nGAME_VERSION ";
+	util::append_uint(setup, _board_version);
+	setup += '\n';
+
+	return setup;
+}
+
+
+void GameServer::change_board(const std::string& line)
+{
+	_board_version++;
+	_board_changes.push_back(_finishes + line);
+	_finishes.clear();
+	if (_board_changes.size() > SYNC_HISTORY)
+		_board_changes.pop_front();
+
+	*this << line;
+}
+
+
+void GameServer::sync_player(Conn* socket, unsigned int version)
+{
+	unsigned int behind = _board_version - version;
+
+	if (version > _board_version || behind > _board_changes.size())
+	{
+		prepare_player(socket);
+		return;
 	}
-	*socket << "\n";
+
+	std::string changes;
+	for (unsigned int c = _board_changes.size() - behind;
+		 c < _board_changes.size(); c++)
+		changes += _board_changes[c];
+	changes += "GAME_VERSION ";
+	util::append_uint(changes, _board_version);
+	changes += '\n';
+
+	socket->write(changes.data(), changes.length());
+	*socket << _turn;
 }
 
 
@@ -415,7 +782,7 @@ void GameServer::attempt_set_player_name(Player *player, Glib::ustring name)
 		return;
 
 	for (unsigned int i = 1; i <= 6; i++)
-		if (_players[i].socket && &_players[i] != player &&
+		if (_players[i].seated() && &_players[i] != player &&
 			_players[i].name == name)
 		{
 			*(player->socket) << "PLAYER_CHOOSE_NAME "
@@ -433,7 +800,7 @@ void GameServer::attempt_set_player_color(Player *player, unsigned int color)
 		return;
 
 	for (unsigned int i = 1; i <= 6; i++)
-		if (_players[i].socket && &_players[i] != player &&
+		if (_players[i].seated() && &_players[i] != player &&
 			_players[i].color != 0 && _players[i].color == color)
 		{
 			*(player->socket) << "PLAYER_CHOOSE_COLOR "
@@ -456,118 +823,687 @@ void GameServer::game_turn(unsigned int posn)
 		posn = 0;
 
 	for (unsigned int i = 1; i <= 6; i++)
-		if (_players[i].socket && _players[i].color == 0)
+		if (_players[i].seated() && _players[i].color == 0)
 			posn = 0;
 
-	*this << "GAME_TURN " + util::to_str(posn) + " " +
+	_turn = "GAME_TURN " + util::to_str(posn) + " " +
 		util::to_str(get_game_status()) + " " +
 		util::to_str(_move_count) + "\n";
+	*this << _turn;
+
+	// A bot searching for a turn that's gone by only holds the next up
+	_turn_posn = posn;
+	if (_search_bot && (posn != _search_posn ||
+						_board_version != _search_version))
+		_search_bot->abort_search();
+
+	// Let the turn go out to the clients before a bot starts thinking
+	_bot_move.disconnect();
+	if (posn && _players[posn].bot)
+		_bot_move = _context->signal_timeout().connect(sigc::bind_return(
+			sigc::bind(sigc::mem_fun(*this, &GameServer::bot_move), posn),
+			false), 1);
 }
 
 
-void GameServer::player_finish(unsigned int posn)
+void GameServer::bot_move(unsigned int posn)
 {
-	evt_message(_players[posn].name + " (#" + util::to_str(posn)
-		+ ") has finished in " + util::to_str(_move_count) + " moves.");
-	*this << "PLAYER_FINISH " + util::to_str(posn) + "  " +
-		util::to_str(_move_count) + "\n";
+	if (posn != _turn_posn || posn != _current_player ||
+		!_players[posn].bot ||
+		_num_connected_players < _board->get_num_players())
+		return;
+
+	// The last search is still finishing, and bot_search_done() will
+	// start this one after it
+	if (_search_bot)
+		return;
+
+	if (!_bot_done)
+	{
+		_bot_done = new Glib::Dispatcher(_context);
+		_bot_done->connect(sigc::mem_fun(*this,
+			&GameServer::bot_search_done));
+	}
+	if (!_bot_thread)
+		_bot_thread = Glib::Thread::create(sigc::bind(sigc::ptr_fun(
+			&GameServer::run_bot_searches), this), true);
+
+	Glib::Mutex::Lock lock(_bot_mutex);
+	_search_bot = _players[posn].bot;
+	_search_bot->clear_abort();
+	if (_search_board)
+		delete _search_board;
+	_search_board = new GameBoard(*_board);
+	_search_posn = posn;
+	_search_version = _board_version;
+	_search_waiting = true;
+	_bot_cond.signal();
 }
 
 
-void GameServer::game_over()
+// Runs in _bot_thread until the server's deleted.  Bots search with event
+// pumping off, and only ever see their own copy of the board.
+void GameServer::run_bot_searches(GameServer *server)
 {
-	Glib::ustring message = "Game Over!";
-	evt_message(message);
-	*this << "CLIENT_MESSAGE " + message + "\n";
-	evt_game_over();
+	for (;;)
+	{
+		BotBase *bot;
+		GameBoard *board;
+		unsigned int posn;
+
+		{
+			Glib::Mutex::Lock lock(server->_bot_mutex);
+			while (!server->_bot_stopping && !server->_search_waiting)
+				server->_bot_cond.wait(server->_bot_mutex);
+			if (server->_bot_stopping)
+				return;
+
+			server->_search_waiting = false;
+			bot = server->_search_bot;
+			board = server->_search_board;
+			posn = server->_search_posn;
+		}
+
+		MoveList move_list;
+		bool found = bot->choose_move(board, posn, &move_list);
+
+		{
+			Glib::Mutex::Lock lock(server->_bot_mutex);
+			server->_search_move = move_list;
+			server->_search_found = found;
+			server->_search_finished = true;
+		}
+
+		server->_bot_done->emit();
+	}
 }
 
 
-GameServer::GameStatus GameServer::get_game_status()
+void GameServer::bot_search_done()
 {
-	if (_num_connected_players < _num_players)
-		return GameServer::WaitingForPlayers;
-	else if (_move_count == 1 && _current_player == 1)
-		return GameServer::Start;
-	else
+	MoveList move_list;
+	bool found;
+
 	{
-		int num_finished = 0;
-		for (unsigned int i = 1; i <= _num_players; i++)
-			if (_board->player_finished(i))
-				num_finished++;
+		Glib::Mutex::Lock lock(_bot_mutex);
+		if (!_search_finished)
+			return;
+		_search_finished = false;
+		move_list = _search_move;
+		found = _search_found;
+	}
 
-		if (num_finished == 0)
-			return GameServer::Playing;
-		else if (_move_count < _num_players)
-			return GameServer::Won;
-		else
-			return GameServer::End;
+	BotBase *bot = _search_bot;
+	_search_bot = NULL;
+
+	if (_search_removed)
+	{
+		_search_removed = false;
+		delete bot;
+	}
+	else if (_search_posn == _turn_posn &&
+			 _search_version == _board_version)
+	{
+		if (found && _board->valid_move_list(move_list, true))
+			make_move(move_list);
+		return;
 	}
 
-	return GameServer::End;
+	// The turn moved on while the bot was searching
+	if (_turn_posn && _players[_turn_posn].bot)
+		bot_move(_turn_posn);
 }
 
 
-unsigned int GameServer::get_client_posn(Conn* socket)
+void GameServer::make_move(const MoveList& move_list)
 {
-	for (unsigned int i = 1; i <= 6; i++)
-		if (_players[i].socket == socket)
-			return i;
+	Glib::ustring arguments = util::to_str(move_list.size());
+	for (MoveList::const_iterator hole = move_list.begin();
+		 hole != move_list.end(); hole++)
+		arguments += " " + util::to_str(*hole);
 
-	return 0;
-}
+	_undo_stack.push_back(move_list);
+	_redo_stack.clear();
 
+	_board->make_move_list(move_list);
+	change_board("GAME_MAKEMOVE " + arguments + "\n");
+	journal("MOVE " + util::to_str(_board_version) + " " + arguments.raw());
 
-unsigned int GameServer::get_client_posn_from_name(Glib::ustring name)
-{
-	for (unsigned int i = 1; i <= 6; i++)
-		if (_players[i].name == name)
-			return i;
+	unsigned int next_player = _board->get_next_player(_current_player);
 
-	return 0;
+	if (next_player <= _current_player)
+		_move_count++;
+
+	_current_player = next_player;
+	game_turn(_current_player);
 }
 
 
-GameServer::Player* GameServer::get_client_player(Conn* socket)
+void GameServer::undo_move()
 {
-	for (unsigned int i = 1; i <= 6; i++)
-		if (_players[i].socket == socket)
-			return &_players[i];
+	MoveList move = _undo_stack.back();
+	unsigned int was_player = _current_player;
 
-	for (unsigned int i = 0; i < _spectators.size(); i++)
-		if (_spectators[i].socket == socket)
-			return &_spectators[i];
+	_board->move_peg(move.back(), move.front());
+	_redo_stack.push_back(move);
+	_undo_stack.pop_back();
 
-	return NULL;
+	_current_player = (*_board)[move.front()]->get_current_player();
+
+	change_board("GAME_UNDOMOVE " + util::to_str(move.back()) + " " +
+				 util::to_str(move.front()) + "\n");
+	journal("UNDO " + util::to_str(_board_version));
+
+	if (_current_player >= was_player)
+		_move_count--;
+
+	game_turn(_current_player);
 }
 
 
-void GameServer::add_client(Conn* socket)
+void GameServer::redo_move()
 {
-	socket->evt_data_available.connect(sigc::bind(sigc::mem_fun(*this,
-		&GameServer::read_client), socket));
+	MoveList move = _redo_stack.back();
+	unsigned int was_player = _current_player;
 
-	*socket << "HELLO " PROTO_VERSION "\n";
+	_board->move_peg(move.front(), move.back());
+	_undo_stack.push_back(move);
+	_redo_stack.pop_back();
 
-	*socket << "CLIENT_MESSAGE GameServer is version " PROTO_VERSION
-		", running a game for " + util::to_str(_board->get_num_players()) +
-		" player(s).\n";
+	_current_player = _board->get_next_player(
+		(*_board)[move.back()]->get_current_player());
+
+	change_board("GAME_UNDOMOVE " + util::to_str(move.front()) + " " +
+				 util::to_str(move.back()) + "\n");
+	journal("REDO " + util::to_str(_board_version));
+
+	if (_current_player <= was_player)
+		_move_count++;
+
+	game_turn(_current_player);
 }
 
 
-void GameServer::remove_client(Conn* socket)
+void GameServer::player_finish(unsigned int posn)
 {
-	Player *sad_player = get_client_player(socket);
-
-	if (sad_player->spectator)
+	evt_message(_players[posn].name + " (#" + util::to_str(posn)
+		+ ") has finished in " + util::to_str(_move_count) + " moves.");
+	if (!_finish_place[posn])
 	{
-		delete sad_player->socket;
-		sad_player->socket = NULL;
+		_finish_place[posn] = ++_num_finished;
+		_finish_moves[posn] = _move_count;
+	}
 
-		Glib::ustring message = "Spectator " + sad_player->name + " from "
-			+ sad_player->location + " has disconnected.";
-		evt_message(message);
-		*this << "CLIENT_MESSAGE " + message + "\n";
+	Glib::ustring finish = "PLAYER_FINISH " + util::to_str(posn) + "  " +
+		util::to_str(_move_count) + "\n";
+
+	_finishes += finish;
+	*this << finish;
+}
+
+
+void GameServer::game_over()
+{
+	Glib::ustring message = "Game Over!";
+	evt_message(message);
+	*this << "CLIENT_MESSAGE " + message + "\n";
+	if (!_archive_path.empty())
+		archive_game();
+	evt_game_over();
+}
+
+
+void GameServer::archive_game()
+{
+	GameArchive::GameHeader header;
+	memset(&header, 0, sizeof(header));
+
+	header.finished = time(NULL);
+	header.num_players = _board->get_num_players();
+	header.rules =
+		(_board->get_long_jumps_allowed() ? GameArchive::LongJumps : 0) |
+		(_board->get_hop_others_allowed() ? GameArchive::HopOthers : 0) |
+		(_board->get_stop_others_allowed() ? GameArchive::StopOthers : 0);
+
+	for (unsigned int i = 1; i <= header.num_players; i++)
+	{
+		GameArchive::PlayerInfo& player = header.players[i - 1];
+
+		GameArchive::set_text(player.name, sizeof(player.name),
+							  _players[i].name.raw());
+		if (_players[i].bot)
+			GameArchive::set_text(player.bot_type, sizeof(player.bot_type),
+								  _players[i].bot->get_type().raw());
+		player.place = _finish_place[i];
+		player.finish_moves = _finish_moves[i];
+	}
+
+	if (!GameArchive::append(_archive_path, header, _undo_stack))
+		evt_message("Couldn't add the game to the archive " + _archive_path +
+					".");
+}
+
+
+void GameServer::set_journal(const std::string& path)
+{
+	if (!ready())
+		return;
+
+	_journal_sync.disconnect();
+	if (_journal)
+		delete _journal;
+	_journal = NULL;
+
+	GameJournal *journal = new GameJournal(path);
+	std::vector<std::string> snapshot, records;
+	// Games that finish in the replay are already in the archive
+	std::string archive_path = _archive_path;
+
+	_archive_path.clear();
+	if (journal->load(&snapshot, &records))
+	{
+		Glib::Timer timer;
+
+		if (restore_snapshot(snapshot))
+		{
+			replay_journal(records);
+			evt_message("Picked up the game kept in " + path + " at move " +
+						util::to_str(_move_count) + ", in " +
+						util::to_str((int)(timer.elapsed() * 1000)) + " ms.");
+		}
+		else
+		{
+			evt_message("The game kept in " + path + " couldn't be read, so "
+						"starting a new one.");
+			restart_game();
+		}
+		game_turn(_current_player);
+	}
+	_archive_path = archive_path;
+
+	_journal = journal;
+	save_snapshot();
+}
+
+
+void GameServer::set_archive(const std::string& path)
+{
+	_archive_path = path;
+}
+
+
+void GameServer::remove_journal()
+{
+	_journal_sync.disconnect();
+
+	if (_journal)
+	{
+		_journal->remove();
+		delete _journal;
+		_journal = NULL;
+	}
+}
+
+
+void GameServer::journal(const std::string& record)
+{
+	if (!_journal)
+		return;
+
+	if (!_journal->append(record))
+		evt_message("Couldn't save the game to its journal.");
+
+	// Snapshots stop the journal getting long, so it's quick to replay
+	if (++_journal_records >= SNAPSHOT_RECORDS)
+		save_snapshot();
+	else if (!_journal_sync.connected())
+		_journal_sync = _context->signal_timeout().connect(sigc::bind_return(
+			sigc::mem_fun(*this, &GameServer::sync_journal), false),
+			JOURNAL_SYNC_TIME);
+}
+
+
+// Names are kept so players coming back after a restart find their seats
+void GameServer::journal_seat(unsigned int posn)
+{
+	journal("SEAT " + util::to_str(posn) + " " + _players[posn].name.raw());
+}
+
+
+void GameServer::sync_journal()
+{
+	if (_journal && !_journal->sync())
+		evt_message("Couldn't save the game to its journal.");
+}
+
+
+//   POSITION <GameBoard::get_position()>
+//   TURN <current player> <move count> <board version>
+//   UNDO <move>, for each move that can be undone, the oldest first
+//   REDO <move>, likewise
+//   SEAT <posn> <name>, for each player's seat
+//   FINISH <posn> <place> <moves>, for each player that's finished
+void GameServer::save_snapshot()
+{
+	std::string snapshot = "POSITION " + _board->get_position(1).raw();
+
+	snapshot += "\nTURN ";
+	util::append_uint(snapshot, _current_player);
+	snapshot += ' ';
+	util::append_uint(snapshot, _move_count);
+	snapshot += ' ';
+	util::append_uint(snapshot, _board_version);
+	snapshot += '\n';
+
+	for (unsigned int s = 0; s < 2; s++)
+	{
+		const std::vector<MoveList>& stack = s ? _redo_stack : _undo_stack;
+
+		for (unsigned int m = 0; m < stack.size(); m++)
+		{
+			snapshot += s ? "REDO " : "UNDO ";
+			util::append_uint(snapshot, stack[m].size());
+			for (unsigned int h = 0; h < stack[m].size(); h++)
+			{
+				snapshot += ' ';
+				util::append_uint(snapshot, stack[m][h]);
+			}
+			snapshot += '\n';
+		}
+	}
+
+	for (unsigned int i = 1; i <= 6; i++)
+		if (!_players[i].bot && !_players[i].name.empty())
+		{
+			snapshot += "SEAT ";
+			util::append_uint(snapshot, i);
+			snapshot += ' ';
+			snapshot += _players[i].name.raw();
+			snapshot += '\n';
+		}
+
+	for (unsigned int i = 1; i <= 6; i++)
+		if (_finish_place[i])
+		{
+			snapshot += "FINISH ";
+			util::append_uint(snapshot, i);
+			snapshot += ' ';
+			util::append_uint(snapshot, _finish_place[i]);
+			snapshot += ' ';
+			util::append_uint(snapshot, _finish_moves[i]);
+			snapshot += '\n';
+		}
+
+	_journal_sync.disconnect();
+	_journal_records = 0;
+	if (!_journal->save_snapshot(snapshot))
+		evt_message("Couldn't save the game to its journal.");
+}
+
+
+bool GameServer::restore_snapshot(const std::vector<std::string>& snapshot)
+{
+	bool positioned = false, turned = false;
+	unsigned int to_move, current_player = 0, move_count = 1, version = 0;
+	std::vector<MoveList> undo_stack, redo_stack;
+	unsigned int finish_place[7] = {0, 0, 0, 0, 0, 0, 0};
+	unsigned int finish_moves[7] = {0, 0, 0, 0, 0, 0, 0};
+	unsigned int num_finished = 0;
+
+	for (unsigned int l = 0; l < snapshot.size(); l++)
+	{
+		StrView command, arguments;
+		StrView(snapshot[l]).split(' ', &command, &arguments);
+		MoveList move;
+
+		if (command == StrView("POSITION"))
+			positioned = _board->set_position(arguments.str(), &to_move);
+		else if (command == StrView("TURN"))
+		{
+			StrView rest = arguments;
+			turned = rest.take_uint(&current_player) &&
+				rest.take_uint(&move_count) && rest.take_uint(&version);
+		}
+		else if (command == StrView("UNDO") || command == StrView("REDO"))
+		{
+			// undo_move and redo_move need a start and an end, and
+			// read_move_list only lets through holes that are on the board
+			if (!_board->read_move_list(arguments, &move) || move.size() < 2)
+				return false;
+			if (command == StrView("UNDO"))
+				undo_stack.push_back(move);
+			else
+				redo_stack.push_back(move);
+		}
+		else if (command == StrView("SEAT"))
+			restore_seat(arguments);
+		else if (command == StrView("FINISH"))
+		{
+			StrView rest = arguments;
+			unsigned int posn, place, moves;
+
+			if (rest.take_uint(&posn) && posn >= 1 && posn <= 6 &&
+				rest.take_uint(&place) && rest.take_uint(&moves))
+			{
+				finish_place[posn] = place;
+				finish_moves[posn] = moves;
+				num_finished = std::max(num_finished, place);
+			}
+		}
+	}
+
+	if (!positioned || !turned || current_player > _board->get_num_players())
+		return false;
+
+	_num_players = _board->get_num_players();
+	_long_jumps = _board->get_long_jumps_allowed();
+	_hop_others = _board->get_hop_others_allowed();
+	_stop_others = _board->get_stop_others_allowed();
+	_current_player = current_player;
+	_move_count = move_count;
+	_board_version = version;
+	_board_changes.clear();
+	_finishes.clear();
+	_undo_stack = undo_stack;
+	_redo_stack = redo_stack;
+	for (unsigned int i = 0; i <= 6; i++)
+	{
+		_finish_place[i] = finish_place[i];
+		_finish_moves[i] = finish_moves[i];
+	}
+	_num_finished = num_finished;
+
+	return true;
+}
+
+
+// Each change to the board has the version it made, so those the snapshot
+// already has are skipped, and it stops at any that doesn't follow on
+void GameServer::replay_journal(const std::vector<std::string>& records)
+{
+	for (unsigned int r = 0; r < records.size(); r++)
+	{
+		StrView command, arguments;
+		StrView(records[r]).split(' ', &command, &arguments);
+
+		if (command == StrView("SEAT"))
+		{
+			restore_seat(arguments);
+			continue;
+		}
+
+		StrView rest = arguments;
+		unsigned int version;
+		MoveList move;
+
+		if (!rest.take_uint(&version) || version > _board_version + 1)
+			return;
+		if (version <= _board_version)
+			continue;
+
+		if (command == StrView("MOVE") &&
+			_board->read_move_list(rest, &move) &&
+			_board->valid_move_list(move, true))
+			make_move(move);
+		else if (command == StrView("UNDO") && !_undo_stack.empty())
+			undo_move();
+		else if (command == StrView("REDO") && !_redo_stack.empty())
+			redo_move();
+		else
+			return;
+	}
+}
+
+
+void GameServer::restore_seat(const StrView& arguments)
+{
+	StrView rest = arguments;
+	unsigned int posn;
+
+	if (rest.take_uint(&posn) && posn >= 1 && posn <= 6 &&
+		!_players[posn].seated())
+		_players[posn].name = util::to_text(rest);
+}
+
+
+GameServer::GameStatus GameServer::get_game_status()
+{
+	if (_num_connected_players < _num_players)
+		return GameServer::WaitingForPlayers;
+	else if (_move_count == 1 && _current_player == 1)
+		return GameServer::Start;
+	else
+	{
+		int num_finished = 0;
+		for (unsigned int i = 1; i <= _num_players; i++)
+			if (_board->player_finished(i))
+				num_finished++;
+
+		if (num_finished == 0)
+			return GameServer::Playing;
+		else if (_move_count < _num_players)
+			return GameServer::Won;
+		else
+			return GameServer::End;
+	}
+
+	return GameServer::End;
+}
+
+
+unsigned int GameServer::get_client_posn(Conn* socket)
+{
+	for (unsigned int i = 1; i <= 6; i++)
+		if (_players[i].socket == socket)
+			return i;
+
+	return 0;
+}
+
+
+unsigned int GameServer::get_empty_posn()
+{
+	for (unsigned int i = 1; i <= 6; i++)
+		if (!_players[i].seated())
+			return i;
+
+	return 0;
+}
+
+
+bool GameServer::owns_bots(Conn* socket)
+{
+	for (unsigned int i = 1; i <= 6; i++)
+		if (_players[i].bot && _players[i].owner == socket)
+			return true;
+
+	return false;
+}
+
+
+unsigned int GameServer::get_client_posn_from_name(Glib::ustring name)
+{
+	for (unsigned int i = 1; i <= 6; i++)
+		if (_players[i].name == name)
+			return i;
+
+	return 0;
+}
+
+
+GameServer::Player* GameServer::get_client_player(Conn* socket)
+{
+	for (unsigned int i = 1; i <= 6; i++)
+		if (_players[i].socket == socket)
+			return &_players[i];
+
+	for (unsigned int i = 0; i < _spectators.size(); i++)
+		if (_spectators[i].socket == socket)
+			return &_spectators[i];
+
+	return NULL;
+}
+
+
+void GameServer::add_client(Conn* socket)
+{
+	*socket << "HELLO " PROTO_VERSION "\n";
+
+	join_client(socket);
+}
+
+
+void GameServer::join_client(Conn* socket, const Glib::ustring& message)
+{
+	socket->evt_data_available.connect(sigc::bind(sigc::mem_fun(*this,
+		&GameServer::read_client), socket));
+	socket->evt_closed.connect(sigc::bind(sigc::mem_fun(*this,
+		&GameServer::drop_client), socket));
+
+	*socket << "CLIENT_MESSAGE GameServer is version " PROTO_VERSION
+		", running a game for " + util::to_str(_board->get_num_players()) +
+		" player(s).\n";
+	// Clients that don't know about frames just ignore this
+	if (socket->get_buffered())
+		*socket << "PROTO_BINARY " PROTO_BINARY_VERSION "\n";
+
+	if (message != "")
+		read_client(message, socket);
+}
+
+
+// Connected before remove_client(), so it's first to hear of a client
+// going, and leaves those that became players or spectators to it
+void GameServer::drop_client(Conn* socket)
+{
+	if (!get_client_player(socket))
+		delete socket;
+}
+
+
+void GameServer::remove_client(Conn* socket)
+{
+	Player *sad_player = get_client_player(socket);
+
+	// Players with a session get a while to come back, bots and all
+	if (sad_player->session)
+	{
+		hold_player(get_client_posn(socket));
+		return;
+	}
+
+	// Bots a client added leave with it
+	remove_bots(socket);
+
+	if (sad_player->spectator)
+	{
+		delete sad_player->socket;
+		sad_player->socket = NULL;
+
+		Glib::ustring message = "Spectator " + sad_player->name + " from "
+			+ sad_player->location + " has disconnected.";
+		evt_message(message);
+		*this << "CLIENT_MESSAGE " + message + "\n";
 
 		for (std::vector<Player>::iterator pl = _spectators.begin();
 			pl < _spectators.end(); pl++)
@@ -581,74 +1517,155 @@ void GameServer::remove_client(Conn* socket)
 		delete sad_player->socket;
 		sad_player->socket = NULL;
 
-		Glib::ustring message = "Player " + sad_player->name
-			+ " (#" + util::to_str(posn) + ") from " + sad_player->location
-			+ " has disconnected.";
-		evt_message(message);
-		*this << "CLIENT_MESSAGE " + message + "\n";
-		*this << "PLAYER_REMOVE " + util::to_str(posn) + "\n";
+		remove_player(posn);
+	}
 
-		_num_connected_players--;
+	game_turn(_current_player);
+}
 
-		if (_num_connected_players == 0 && _board->game_finished())
-			restart_game();
-	}
 
+void GameServer::remove_player(unsigned int posn)
+{
+	Glib::ustring message = "Player " + _players[posn].name
+		+ " (#" + util::to_str(posn) + ") from " + _players[posn].location
+		+ " has disconnected.";
+	evt_message(message);
+	*this << "CLIENT_MESSAGE " + message + "\n";
+	*this << "PLAYER_REMOVE " + util::to_str(posn) + "\n";
+
+	_num_connected_players--;
+
+	if (_num_connected_players == 0 && _board->game_finished())
+		restart_game();
+}
+
+
+void GameServer::start_session(unsigned int posn)
+{
+	static const char digits[] = "0123456789abcdef";
+	Glib::Rand rand;
+	std::string token;
+
+	for (unsigned int c = 0; c < 32; c++)
+		token += digits[rand.get_int_range(0, 16)];
+
+	Player& player = _players[posn];
+	player.session = std::make_shared<Session>(token);
+
+	*player.socket << "SESSION " + token + "\n";
+	player.socket->evt_written.connect(sigc::mem_fun(*player.session,
+		&Session::record));
+}
+
+
+void GameServer::end_session(unsigned int posn)
+{
+	if (!_players[posn].session)
+		return;
+
+	_players[posn].session.reset();
+	if (_players[posn].socket)
+		*_players[posn].socket << "SESSION\n";
+}
+
+
+void GameServer::hold_player(unsigned int posn)
+{
+	Player& player = _players[posn];
+	Session& session = *player.session;
+
+	// The bots it added have no owner until it's back
+	for (unsigned int i = 1; i <= 6; i++)
+		if (_players[i].bot && _players[i].owner == player.socket)
+		{
+			_players[i].owner = NULL;
+			session.bots.push_back(_players[i].bot);
+		}
+
+	delete player.socket;
+	player.socket = NULL;
+
+	Glib::ustring message = player.name + " (#" + util::to_str(posn)
+		+ ") has lost its connection, and has " + util::to_str(SESSION_GRACE)
+		+ " seconds to come back.";
+	evt_message(message);
+	*this << "CLIENT_MESSAGE " + message + "\n";
+
+	session.expiry = _context->signal_timeout().connect(sigc::bind_return(
+		sigc::bind(sigc::mem_fun(*this, &GameServer::expire_session),
+				   session.token), false), SESSION_GRACE * 1000);
+}
+
+
+void GameServer::expire_session(std::string token)
+{
+	unsigned int posn = get_session_posn(token);
+
+	if (!posn || _players[posn].socket)
+		return;
+
+	std::vector<BotBase*> bots = _players[posn].session->bots;
+	_players[posn].session.reset();
+
+	for (unsigned int i = 1; i <= 6; i++)
+		if (_players[i].bot && std::find(bots.begin(), bots.end(),
+										 _players[i].bot) != bots.end())
+			remove_bot(i);
+
+	remove_player(posn);
 	game_turn(_current_player);
 }
 
 
-void GameServer::read_client(Glib::ustring message, Conn* socket)
+unsigned int GameServer::get_session_posn(const StrView& token)
 {
-	Glib::ustring command, arguments;
+	for (unsigned int i = 1; i <= 6; i++)
+		if (_players[i].session && StrView(_players[i].session->token) == token)
+			return i;
 
-	int seperator = message.find_first_of(" ");
-	if (seperator < 0)
-		command = message.substr(0, message.length());
-	else
-	{
-		command = message.substr(0, seperator);
-		arguments = message.substr(seperator+1, message.length()-seperator-1);
-	}
+	return 0;
+}
+
+
+void GameServer::read_client(Glib::ustring message, Conn* socket)
+{
+	typedef void (GameServer::*Handler)(Conn*, const StrView&);
+	typedef CommandTable<Handler> Commands;
+	static const Commands::Entry entries[] = {
+		{ "PLAYER_ADD", &GameServer::command_PLAYER_ADD },
+		{ "SPECTATOR_ADD", &GameServer::command_SPECTATOR_ADD },
+		{ "PLAYER_CHAT", &GameServer::command_PLAYER_CHAT },
+		{ "SERVER_SYNC", &GameServer::command_SERVER_SYNC },
+		{ "SERVER_HEARTBEAT", &GameServer::command_SERVER_HEARTBEAT },
+		{ "CLIENT_HEARTBEAT", &GameServer::command_CLIENT_HEARTBEAT },
+		{ "PLAYER_NAME", &GameServer::command_PLAYER_NAME },
+		{ "PLAYER_COLOR", &GameServer::command_PLAYER_COLOR },
+		{ "GAME_SHOWMOVE", &GameServer::command_GAME_SHOWMOVE },
+		{ "GAME_HIDEMOVE", &GameServer::command_GAME_HIDEMOVE },
+		{ "GAME_MAKEMOVE", &GameServer::command_GAME_MAKEMOVE },
+		{ "GAME_UNDOMOVE", &GameServer::command_GAME_UNDOMOVE },
+		{ "GAME_REDOMOVE", &GameServer::command_GAME_REDOMOVE },
+		{ "GAME_RESTART", &GameServer::command_GAME_RESTART },
+		{ "GAME_ROTATE", &GameServer::command_GAME_ROTATE },
+		{ "GAME_SHUFFLE", &GameServer::command_GAME_SHUFFLE },
+		{ "GAME_RECONFIG", &GameServer::command_GAME_RECONFIG },
+		{ "GAME_ADDBOT", &GameServer::command_GAME_ADDBOT },
+		{ "GAME_REMOVEBOTS", &GameServer::command_GAME_REMOVEBOTS },
+		{ "PROTO_BINARY", &GameServer::command_PROTO_BINARY },
+		{ "RESUME", &GameServer::command_RESUME }
+	};
+	static const Commands commands(entries);
+
+	StrView command, arguments;
+	StrView(message.raw()).split(' ', &command, &arguments);
 
 #ifdef DEBUG_SERVER
 		cerr << "SERVER RECEIVED : " << message << endl;
 #endif
 
-	if (command == "PLAYER_ADD")
-		command_PLAYER_ADD(socket, arguments);
-	else if (command == "SPECTATOR_ADD")
-		command_SPECTATOR_ADD(socket, arguments);
-	else if (command == "PLAYER_CHAT")
-		command_PLAYER_CHAT(socket, arguments);
-	else if (command == "SERVER_SYNC")
-		command_SERVER_SYNC(socket, arguments);
-	else if (command == "SERVER_HEARTBEAT")
-		command_SERVER_HEARTBEAT(socket, arguments);
-	else if (command == "CLIENT_HEARTBEAT")
-		command_CLIENT_HEARTBEAT(socket, arguments);
-	else if (command == "PLAYER_NAME")
-		command_PLAYER_NAME(socket, arguments);
-	else if (command == "PLAYER_COLOR")
-		command_PLAYER_COLOR(socket, arguments);
-	else if (command == "GAME_SHOWMOVE")
-		command_GAME_SHOWMOVE(socket, arguments);
-	else if (command == "GAME_HIDEMOVE")
-		command_GAME_HIDEMOVE(socket, arguments);
-	else if (command == "GAME_MAKEMOVE")
-		command_GAME_MAKEMOVE(socket, arguments);
-	else if (command == "GAME_UNDOMOVE")
-		command_GAME_UNDOMOVE(socket, arguments);
-	else if (command == "GAME_REDOMOVE")
-		command_GAME_REDOMOVE(socket, arguments);
-	else if (command == "GAME_RESTART")
-		command_GAME_RESTART(socket, arguments);
-	else if (command == "GAME_ROTATE")
-		command_GAME_ROTATE(socket, arguments);
-	else if (command == "GAME_SHUFFLE")
-		command_GAME_SHUFFLE(socket, arguments);
-	else if (command == "GAME_RECONFIG")
-		command_GAME_RECONFIG(socket, arguments);
+	Handler handler = commands.find(command);
+	if (handler)
+		(this->*handler)(socket, arguments);
 
 #ifdef DEBUG_SERVER
 	else
@@ -669,15 +1686,26 @@ void GameServer::error_client(Conn::Error error, Conn* socket)
 
 
 void GameServer::command_PLAYER_ADD(Conn *socket,
-									const Glib::ustring& arguments)
+									const StrView& arguments)
 {
+	StrView rest = arguments;
+	int color = 0;
+	rest.take_int(&color);
+	Glib::ustring name = util::to_text(rest);
+
+	// Someone coming back by name instead of resuming, as older clients
+	// do, gets the seat afresh
+	unsigned int posn = get_client_posn_from_name(name);
+	if (posn && _players[posn].session && !_players[posn].socket)
+		expire_session(_players[posn].session->token);
+
 	if (_num_connected_players == _num_players)
 	{
 		*socket << "CLIENT_MESSAGE "
 			<< "Sorry, this Chinese Checkers game is full.\n";
 		// Delayed the close so the message can get there first
-		Glib::signal_timeout().connect(sigc::bind_return(sigc::mem_fun(*socket,
-			&Conn::close), false), 100);
+		_context->signal_timeout().connect(sigc::bind_return(
+			sigc::mem_fun(*socket, &Conn::close), false), 100);
 		return;
 	}
 
@@ -686,13 +1714,10 @@ void GameServer::command_PLAYER_ADD(Conn *socket,
 	socket->evt_error.connect(sigc::bind(sigc::mem_fun(*this,
 		&GameServer::error_client), socket));
 
-	int color = util::from_str<int>(arguments);
-	Glib::ustring name = arguments.substr(2);
-
-	unsigned int posn = get_client_posn_from_name(name);
+	posn = get_client_posn_from_name(name);
 	// if no player by that name, or that player is already connected,
-	if (!posn || _players[posn].socket)
-		posn = get_client_posn(NULL);
+	if (!posn || _players[posn].seated())
+		posn = get_empty_posn();
 
 	_players[posn] = Player(socket,
 							Glib::ustring("Player ") + util::to_str(posn),
@@ -702,7 +1727,9 @@ void GameServer::command_PLAYER_ADD(Conn *socket,
 	attempt_set_player_name(&_players[posn], name);
 
 	attempt_set_player_color(&_players[posn], color);
+	journal_seat(posn);
 
+	start_session(posn);
 	prepare_player(socket);
 
 	Glib::ustring message = "Server: " + _players[posn].name + " from "
@@ -722,9 +1749,9 @@ void GameServer::command_PLAYER_ADD(Conn *socket,
 
 
 void GameServer::command_SPECTATOR_ADD(Conn *socket,
-									   const Glib::ustring& arguments)
+									   const StrView& arguments)
 {
-	Glib::ustring name = arguments;
+	Glib::ustring name = util::to_text(arguments);
 
 	_spectators.push_back(Player(socket, name, 0, socket->get_host_name(),
 						  _heartbeat, true));
@@ -745,59 +1772,143 @@ void GameServer::command_SPECTATOR_ADD(Conn *socket,
 
 
 void GameServer::command_PLAYER_CHAT(Conn *socket,
-									 const Glib::ustring& arguments)
+									 const StrView& arguments)
 {
 	*this << "PLAYER_CHAT <<" + get_client_player(socket)->name + ">> "
-		+ arguments + "\n";
+		+ util::to_text(arguments) + "\n";
 }
 
 
 void GameServer::command_SERVER_SYNC(Conn *socket,
-									 const Glib::ustring& arguments)
+									 const StrView& arguments)
 {
-	prepare_player(socket);
+	unsigned int version;
+
+	if (arguments.to_uint(&version))
+		sync_player(socket, version);
+	else
+		prepare_player(socket);
+}
+
+
+// The old connection may not have been noticed to have dropped yet, and
+// is let go of first
+void GameServer::command_RESUME(Conn *socket,
+								const StrView& arguments)
+{
+	StrView rest = arguments;
+	StrView token;
+	unsigned int received;
+	unsigned int posn = 0;
+
+	if (get_client_player(socket))
+		return;
+
+	if (rest.take_token(&token) && rest.take_uint(&received))
+		posn = get_session_posn(token);
+	if (posn && _players[posn].socket)
+		_players[posn].socket->close();
+
+	Session *session = posn ? _players[posn].session.get() : NULL;
+
+	if (!session || _players[posn].socket || received > session->sent ||
+		session->sent - received > session->log.size())
+	{
+		*socket << "RESUME_FAILED\n";
+		return;
+	}
+
+	Player& player = _players[posn];
+	session->expiry.disconnect();
+	player.socket = socket;
+	player.location = socket->get_host_name();
+	player.heartbeat = _heartbeat;
+
+	socket->evt_closed.connect(sigc::bind(sigc::mem_fun(*this,
+		&GameServer::remove_client), socket));
+	socket->evt_error.connect(sigc::bind(sigc::mem_fun(*this,
+		&GameServer::error_client), socket));
+
+	for (unsigned int i = 1; i <= 6; i++)
+		if (_players[i].bot && std::find(session->bots.begin(),
+				session->bots.end(), _players[i].bot) != session->bots.end())
+			_players[i].owner = socket;
+	session->bots.clear();
+
+	std::string missed = "RESUMED ";
+	util::append_uint(missed, received);
+	missed += '\n';
+	for (unsigned int l = session->log.size() - (session->sent - received);
+		 l < session->log.size(); l++)
+		missed += session->log[l];
+
+	socket->write(missed.data(), missed.length());
+	socket->evt_written.connect(sigc::mem_fun(*session, &Session::record));
+
+	Glib::ustring message = player.name + " (#" + util::to_str(posn)
+		+ ") is back.";
+	evt_message(message);
+	*this << "CLIENT_MESSAGE " + message + "\n";
 }
 
 
 void GameServer::command_SERVER_HEARTBEAT(Conn *socket,
-										  const Glib::ustring& arguments)
+										  const StrView& arguments)
 {
-	get_client_player(socket)->heartbeat =
-		util::from_str<unsigned int>(arguments);
+	arguments.to_uint(&get_client_player(socket)->heartbeat);
 }
 
 
 void GameServer::command_CLIENT_HEARTBEAT(Conn *socket,
-										  const Glib::ustring& arguments)
+										  const StrView& arguments)
 {
-	*socket << "CLIENT_HEARTBEAT " + arguments + "\n";
+	*socket << "CLIENT_HEARTBEAT " + arguments.str() + "\n";
+}
+
+
+// The client will send frames from now on, and wants them back, once
+// it's seen that we've agreed
+void GameServer::command_PROTO_BINARY(Conn *socket,
+									  const StrView& arguments)
+{
+	if (arguments != StrView(PROTO_BINARY_VERSION) || !socket->get_buffered() ||
+		socket->get_binary_input())
+		return;
+
+	socket->set_binary_input(true);
+	*socket << "PROTO_BINARY " PROTO_BINARY_VERSION "\n";
+	socket->set_binary_output(true);
 }
 
 
 void GameServer::command_PLAYER_NAME(Conn *socket,
-									 const Glib::ustring& arguments)
+									 const StrView& arguments)
 {
 	Player *player = get_client_player(socket);
 
-	Glib::ustring name = arguments;
+	Glib::ustring name = util::to_text(arguments);
 
 	attempt_set_player_name(player, name);
 
 	if (!player->spectator)
+	{
 		*this << "PLAYER_ADD " + util::to_str(get_client_posn(socket)) + " " +
 			util::to_str(player->color) + " " + player->name + "\n";
+		journal_seat(get_client_posn(socket));
+	}
 }
 
 
 void GameServer::command_PLAYER_COLOR(Conn *socket,
-									  const Glib::ustring& arguments)
+									  const StrView& arguments)
 {
 	Player *player = get_client_player(socket);
 
 	if (player->spectator)
 		return;
 
-	int color = util::from_str<int>(arguments);
+	int color = 0;
+	arguments.to_int(&color);
 
 	attempt_set_player_color(player, color);
 
@@ -810,7 +1921,7 @@ void GameServer::command_PLAYER_COLOR(Conn *socket,
 
 
 void GameServer::command_GAME_SHOWMOVE(Conn *socket,
-										const Glib::ustring& arguments)
+										const StrView& arguments)
 {
 	Player *player = get_client_player(socket);
 
@@ -819,12 +1930,12 @@ void GameServer::command_GAME_SHOWMOVE(Conn *socket,
 
 	if (_num_connected_players >= _board->get_num_players()
 		&& get_client_posn(socket) == _current_player)
-			*this << "GAME_SHOWMOVE " + arguments + "\n";
+			*this << "GAME_SHOWMOVE " + arguments.str() + "\n";
 }
 
 
 void GameServer::command_GAME_HIDEMOVE(Conn *socket,
-										const Glib::ustring& arguments)
+										const StrView& arguments)
 {
 	Player *player = get_client_player(socket);
 
@@ -838,117 +1949,59 @@ void GameServer::command_GAME_HIDEMOVE(Conn *socket,
 
 
 void GameServer::command_GAME_MAKEMOVE(Conn *socket,
-										const Glib::ustring& arguments)
+										const StrView& arguments)
 {
 	Player *player = get_client_player(socket);
 
 	if (player->spectator)
 		return;
 
-	istringstream argStream(arguments);
 	MoveList move_list;
-	int numMoves;
-
-	argStream >> numMoves;
-	for (int i = 0; i < numMoves; i++)
-	{
-		int j;
-		argStream >> j;
-		move_list.push_back(j);
-	}
+	bool readable = _board->read_move_list(arguments, &move_list);
 
 	if (_num_connected_players < _board->get_num_players())
 		*socket << "CLIENT_MESSAGE " << "Waiting for more players to join!\n";
 	else if (get_client_posn(socket) != _current_player)
 		*socket << "CLIENT_MESSAGE " << "It's not your turn yet!\n";
-	else if (!(_board->valid_move_list(move_list, true) &&
+	else if (!(readable && _board->valid_move_list(move_list, true) &&
 			(*_board)[move_list.front()]->get_current_player() == _current_player))
 	{
 		*socket << "CLIENT_MESSAGE " << "Invalid move! Try again.\n";
 		*this << "GAME_HIDEMOVE \n";
 	}
 	else
-	{
-		_undo_stack.push_back(move_list);
-		_redo_stack.clear();
-
-		_board->make_move_list(move_list);
-		*this << "GAME_MAKEMOVE " + arguments + "\n";
-
-		unsigned int next_player = _board->get_next_player(_current_player);
-
-		if (next_player <= _current_player)
-			_move_count++;
-
-		_current_player = next_player;
-		game_turn(_current_player);
-	}
+		make_move(move_list);
 }
 
 
 void GameServer::command_GAME_UNDOMOVE(Conn *socket,
-										const Glib::ustring& arguments)
+										const StrView& arguments)
 {
 	if (_undo_stack.empty())
 		return;
 
 	if (_num_connected_players == _board->get_num_players())
-	{
-		MoveList move = _undo_stack.back();
-		unsigned int was_player = _current_player;
-
-		_board->move_peg(move.back(), move.front());
-		_redo_stack.push_back(move);
-		_undo_stack.pop_back();
-
-		_current_player = (*_board)[move.front()]->get_current_player();
-
-		*this << "GAME_UNDOMOVE " << util::to_str(move.back()) << " "
-			<< util::to_str(move.front()) << "\n";
-
-		if (_current_player >= was_player)
-			_move_count--;
-
-		game_turn(_current_player);
-	}
+		undo_move();
 }
 
 
 void GameServer::command_GAME_REDOMOVE(Conn *socket,
-										const Glib::ustring& arguments)
+										const StrView& arguments)
 {
 	if (_redo_stack.empty())
 		return;
 
 	if (_num_connected_players == _board->get_num_players())
-	{
-		MoveList move = _redo_stack.back();
-		unsigned int was_player = _current_player;
-
-		_board->move_peg(move.front(), move.back());
-		_undo_stack.push_back(move);
-		_redo_stack.pop_back();
-
-		_current_player = _board->get_next_player(
-			(*_board)[move.back()]->get_current_player());
-
-		*this << "GAME_UNDOMOVE " << util::to_str(move.front()) << " "
-			<< util::to_str(move.back()) << "\n";
-
-		if (_current_player <= was_player)
-			_move_count++;
-
-		game_turn(_current_player);
-	}
+		redo_move();
 }
 
 
 void GameServer::command_GAME_RESTART(Conn *socket,
-									  const Glib::ustring& arguments)
+									  const StrView& arguments)
 {
 	Player *player = get_client_player(socket);
 
-	if (player->spectator)
+	if (player->spectator && !owns_bots(socket))
 		return;
 
 	restart_game();
@@ -956,11 +2009,11 @@ void GameServer::command_GAME_RESTART(Conn *socket,
 
 
 void GameServer::command_GAME_ROTATE(Conn *socket,
-									  const Glib::ustring& arguments)
+									  const StrView& arguments)
 {
 	Player *player = get_client_player(socket);
 
-	if (player->spectator)
+	if (player->spectator && !owns_bots(socket))
 		return;
 
 	rotate_players();
@@ -968,11 +2021,11 @@ void GameServer::command_GAME_ROTATE(Conn *socket,
 
 
 void GameServer::command_GAME_SHUFFLE(Conn *socket,
-									  const Glib::ustring& arguments)
+									  const StrView& arguments)
 {
 	Player *player = get_client_player(socket);
 
-	if (player->spectator)
+	if (player->spectator && !owns_bots(socket))
 		return;
 
 	shuffle_players();
@@ -980,17 +2033,44 @@ void GameServer::command_GAME_SHUFFLE(Conn *socket,
 
 
 void GameServer::command_GAME_RECONFIG(Conn *socket,
-									   const Glib::ustring& arguments)
+									   const StrView& arguments)
 {
 	Player *player = get_client_player(socket);
 
 	if (player->spectator)
 		return;
 
-	unsigned int num_players = util::from_str<unsigned int>(arguments);
-	bool long_jumps = (bool)((int)util::from_str<int>(arguments.substr(2)));
-	bool hop_others = (bool)((int)util::from_str<int>(arguments.substr(4)));
-	bool stop_others = (bool)((int)util::from_str<int>(arguments.substr(6)));
+	StrView rest = arguments;
+	unsigned int num_players;
+	int long_jumps, hop_others, stop_others;
+
+	if (!rest.take_uint(&num_players) || !rest.take_int(&long_jumps) ||
+		!rest.take_int(&hop_others) || !rest.take_int(&stop_others))
+		return;
 
 	reconfigure_game(num_players, long_jumps, hop_others, stop_others);
 }
+
+
+void GameServer::command_GAME_ADDBOT(Conn *socket,
+									 const StrView& arguments)
+{
+	Player *player = get_client_player(socket);
+
+	// Owning bots lets a client run the game, so only players get to
+	if (!player || player->spectator)
+	{
+		*socket << "CLIENT_MESSAGE Only players can add bots.\n";
+		return;
+	}
+
+	add_bot(arguments.empty() ? Glib::ustring("l3") : util::to_text(arguments),
+			socket);
+}
+
+
+void GameServer::command_GAME_REMOVEBOTS(Conn *socket,
+										 const StrView& arguments)
+{
+	remove_bots(socket);
+}
@@ -21,17 +21,49 @@
 #define INCL_GAME_SERVER_HH
 
 #include <vector>
+#include <deque>
+#include <memory>
 #include <sigc++/sigc++.h>
+#include <glibmm/main.h>
+#include <glibmm/thread.h>
+#include <glibmm/dispatcher.h>
 
 #include "gnet_server.hh"
 #include "game_board.hh"
+#include "str_view.hh"
 
 #define PROTO_VERSION "9"
 
+class BotBase;
+class GameJournal;
+
 
 class GameServer : public sigc::trackable
 {
 private:
+	// What a player has been sent since it joined, so that when its
+	// connection drops it can come back with RESUME and be sent just what
+	// it missed, rather than everything again
+	class Session : public sigc::trackable
+	{
+		public:
+			std::string		token;
+			// How many lines have been sent, counting those sent while
+			// the player was away, the last of which are in log
+			unsigned int	sent;
+			std::deque<std::string>	log;
+			// The start of a line that hasn't been finished yet
+			std::string		partial;
+			// The bots the player added, while it's away
+			std::vector<BotBase*>	bots;
+			sigc::connection	expiry;
+
+			Session(const std::string& token_);
+			~Session();
+
+			void record(const gchar *data, unsigned long count);
+	};
+
 	class Player
 	{
 		public:
@@ -42,14 +74,31 @@ private:
 			unsigned int	heartbeat;
 			bool			spectator;
 
+			// Bots seated right in the server have no socket, just the
+			// client that added them, if any
+			BotBase*		bot;
+			Gnet::Conn*		owner;
+
+			// A player's seat is kept for it while it has a session, even
+			// with no socket
+			std::shared_ptr<Session>	session;
+
 			Player(Gnet::Conn *socket_ = NULL, Glib::ustring name_ = "",
 				   unsigned int color_ = 0, Glib::ustring location_ = "",
-				   unsigned int heartbeat_ = 0, bool spectator = false);
+				   unsigned int heartbeat_ = 0, bool spectator = false,
+				   BotBase *bot_ = NULL, Gnet::Conn *owner_ = NULL);
+
+			bool seated() const;
 	};
 
 public:
+	// With port 0, the server doesn't listen itself, but plays as a room
+	// whose clients are handed over with join_client().  Its timers run
+	// from context's main loop, so a room can live in its own thread.
 	GameServer(unsigned int port, unsigned int num_players, bool long_jumps,
-			   bool hop_others, bool stop_others);
+			   bool hop_others, bool stop_others,
+			   Glib::RefPtr<Glib::MainContext> context =
+				   Glib::MainContext::get_default());
 	virtual ~GameServer();
 
 	typedef enum {WaitingForPlayers=0, Start, Playing, Won, End} GameStatus;
@@ -61,9 +110,25 @@ private:
 private:
 	const static int HEARTBEAT_TIME = 5;
 	const static int TIMEOUT_HEARTBEAT = 6;
+	// How many of the latest changes to the board are kept, for clients
+	// that are only a little behind to catch up on
+	const static unsigned int SYNC_HISTORY = 64;
+	// How long a player that's lost its connection has to come back, and
+	// how many lines it can miss and still do so
+	const static int SESSION_GRACE = 30;
+	const static unsigned int SESSION_LOG = 256;
+	// How long records wait to be fsynced together, in milliseconds, and
+	// how many go in the journal before it's replaced by a snapshot
+	const static int JOURNAL_SYNC_TIME = 100;
+	const static unsigned int SNAPSHOT_RECORDS = 100;
+	// How many moves a seated bot scores a turn, unless set otherwise,
+	// so one room's bots can't keep its thread busy for long
+	const static unsigned long BOT_NODE_LIMIT = 500000;
 
 private:
+	Glib::RefPtr<Glib::MainContext>	_context;
 	Gnet::Server			_socket;
+	bool					_open;
 	GameBoard*				_board;
 	std::vector<Player>		_players;
 	std::vector<Player>		_spectators;
@@ -78,12 +143,64 @@ private:
 	unsigned int			_move_count;
 	std::vector<MoveList>	_undo_stack;
 	std::vector<MoveList>	_redo_stack;
+	// Goes up with every change to the board, and carries on across games
+	unsigned int			_board_version;
+	// The lines that made the latest changes, the last one making
+	// _board_version
+	std::deque<std::string>	_board_changes;
+	// Any PLAYER_FINISHes the change being made has caused, to be kept
+	// with it
+	std::string				_finishes;
+	// The last GAME_TURN sent
+	Glib::ustring			_turn;
+	// Where each player came and the move it finished on, 0 until it has
+	unsigned int			_finish_place[7];
+	unsigned int			_finish_moves[7];
+	unsigned int			_num_finished;
+	// Where finished games go, if anywhere
+	std::string				_archive_path;
+	unsigned long			_bot_node_limit;
+	sigc::connection		_bot_move;
+	// The last turn game_turn() gave out, which a bot's move must be for
+	unsigned int			_turn_posn;
+	// Seated bots search in this thread, on a copy of the board, so the
+	// room's loop carries on meanwhile.  Everything under _bot_mutex is
+	// shared with it; _bot_done brings the move back to the room's loop.
+	Glib::Thread*			_bot_thread;
+	Glib::Mutex				_bot_mutex;
+	Glib::Cond				_bot_cond;
+	Glib::Dispatcher*		_bot_done;
+	BotBase*				_search_bot;
+	GameBoard*				_search_board;
+	unsigned int			_search_posn;
+	unsigned int			_search_version;
+	MoveList				_search_move;
+	bool					_search_found;
+	bool					_search_waiting;
+	bool					_search_finished;
+	// The searching bot was taken out, and is deleted once it's done
+	bool					_search_removed;
+	bool					_bot_stopping;
+	// Where the game's kept on disk, if anywhere, and how many records
+	// have gone in the journal since the last snapshot
+	GameJournal*			_journal;
+	unsigned int			_journal_records;
+	sigc::connection		_journal_sync;
 
 public:
 	const Gnet::Server& getSocket() const;
 	unsigned int get_num_players() const;
+	unsigned int get_num_connected_players() const;
+	unsigned int get_num_spectators() const;
+	// Players and spectators connected over sockets, so not counting bots
+	unsigned int get_num_clients() const;
+	GameServer::GameStatus get_game_status();
 	bool ready() const;
 
+	// Takes over a client that has already been sent HELLO, and handles
+	// message, if there is one, as the first thing it sent
+	void join_client(Gnet::Conn* socket, const Glib::ustring& message = "");
+
 	void parse_command(Glib::ustring message);
 	
 	void help();
@@ -100,6 +217,23 @@ public:
 
 	void kick_player(unsigned int posn);
 
+	// Seats a bot of bot_type (see BotBase::new_bot_of_type()) in the
+	// game.  It moves straight on the server's board, without a socket.
+	bool add_bot(Glib::ustring bot_type, Gnet::Conn *owner = NULL);
+	void remove_bot(unsigned int posn);
+	// Takes out the bots owner added, or all of them
+	void remove_bots(Gnet::Conn *owner = NULL);
+	void set_bot_node_limit(unsigned long nodes);
+
+	// Picks up the game kept at path, if there is one, and keeps this one
+	// there from now on.  For a game that's started, before any clients
+	// have joined.
+	void set_journal(const std::string& path);
+	// Forgets the game kept on disk, for a room that's closing for good
+	void remove_journal();
+	// Adds each game to the GameArchive at path as it finishes
+	void set_archive(const std::string& path);
+
 public:
 	sigc::signal<void, Glib::ustring> evt_message;
 	sigc::signal<void> evt_game_over;
@@ -109,74 +243,135 @@ private:
 
 	void heartbeat_players();
 	void prepare_player(Gnet::Conn* socket);
+	// Everything player posn needs to be sent to catch up on the game
+	std::string get_setup(unsigned int posn);
 	void attempt_set_player_name(Player *player, Glib::ustring name);
 	void attempt_set_player_color(Player *player, unsigned int color);
 
 	void game_turn(unsigned int posn);
+	// Sends everyone line, which changes the board, and keeps it for
+	// catching up clients with
+	void change_board(const std::string& line);
+	// Sends socket the changes since version, or all of the board if it's
+	// too far behind
+	void sync_player(Gnet::Conn* socket, unsigned int version);
+	// Hands the bot at posn's search to _bot_thread
+	void bot_move(unsigned int posn);
+	static void run_bot_searches(GameServer *server);
+	// Makes the move _bot_thread found, if it's still that bot's turn
+	void bot_search_done();
+	void make_move(const MoveList& move_list);
+	void undo_move();
+	void redo_move();
 	void move_increment();
 	void player_finish(unsigned int posn);
 	void game_over();
+	void archive_game();
+
+	// Adds record to the journal, to be synced shortly along with any
+	// others that come in meanwhile
+	void journal(const std::string& record);
+	void journal_seat(unsigned int posn);
+	void sync_journal();
+	void save_snapshot();
+	// False if the snapshot isn't a whole game
+	bool restore_snapshot(const std::vector<std::string>& snapshot);
+	void replay_journal(const std::vector<std::string>& records);
+	void restore_seat(const StrView& arguments);
 
 	unsigned int get_client_posn(Gnet::Conn* socket);
+	unsigned int get_empty_posn();
+	bool owns_bots(Gnet::Conn* socket);
 	unsigned int get_client_posn_from_name(Glib::ustring name);
 	GameServer::Player* get_client_player(Gnet::Conn* socket);
-	GameServer::GameStatus get_game_status();
 	void add_client(Gnet::Conn* socket);
+	// Deletes a client that goes before it's added as a player or
+	// spectator, which nothing else would
+	void drop_client(Gnet::Conn* socket);
 	void remove_client(Gnet::Conn* socket);
+	void remove_player(unsigned int posn);
+
+	// Gives the player at posn a session, from what it's sent next on
+	void start_session(unsigned int posn);
+	// Tells the player at posn not to bother resuming
+	void end_session(unsigned int posn);
+	// Keeps the seat of a player whose connection has dropped, until it
+	// resumes or its session expires
+	void hold_player(unsigned int posn);
+	void expire_session(std::string token);
+	unsigned int get_session_posn(const StrView& token);
 	void read_client(Glib::ustring message, Gnet::Conn* socket);
 	void error_client(Gnet::Conn::Error error, Gnet::Conn* socket);
+	// Writes a broadcast, framing it into frames the first time a socket
+	// needs it framed
+	void write_client(Gnet::Conn* socket, const SharedData& data,
+					  SharedData *frames);
 
 	// Client is adding itself as a player
 	void command_PLAYER_ADD(Gnet::Conn* socket,
-							const Glib::ustring& arguments);
+							const StrView& arguments);
 	// Client is adding itself as a spectator
 	void command_SPECTATOR_ADD(Gnet::Conn* socket,
-							   const Glib::ustring& arguments);
-	// Client wants a resync
+							   const StrView& arguments);
+	// Client wants a resync, of the changes since the version it gives
+	// or of everything
 	void command_SERVER_SYNC(Gnet::Conn* socket,
-							 const Glib::ustring& arguments);
+							 const StrView& arguments);
+	// Client is a player coming back after its connection dropped, and
+	// has received so many lines of its session
+	void command_RESUME(Gnet::Conn* socket,
+						const StrView& arguments);
+	// Client wants protocol v10's frames
+	void command_PROTO_BINARY(Gnet::Conn* socket,
+							  const StrView& arguments);
 	// Confirmation that client heard our heartbeat
 	void command_SERVER_HEARTBEAT(Gnet::Conn* socket,
-								  const Glib::ustring& arguments);
+								  const StrView& arguments);
 	// Receive client's heartbeat
 	void command_CLIENT_HEARTBEAT(Gnet::Conn* socket,
-								  const Glib::ustring& arguments);
+								  const StrView& arguments);
 	// Player is changing it's name
 	void command_PLAYER_NAME(Gnet::Conn* socket,
-							 const Glib::ustring& arguments);
+							 const StrView& arguments);
 	// Player is changing it's color
 	void command_PLAYER_COLOR(Gnet::Conn* socket,
-							  const Glib::ustring& arguments);
+							  const StrView& arguments);
 	// Player sent a chat
 	void command_PLAYER_CHAT(Gnet::Conn* socket,
-							 const Glib::ustring& arguments);
+							 const StrView& arguments);
 	// Player says to show these holes as selected
 	void command_GAME_SHOWMOVE(Gnet::Conn* socket,
-								const Glib::ustring& arguments);
+								const StrView& arguments);
 	// Player says to deselect all holes
 	void command_GAME_HIDEMOVE(Gnet::Conn* socket, 
-								const Glib::ustring& arguments);
+								const StrView& arguments);
 	// Player says make/commit this move
 	void command_GAME_MAKEMOVE(Gnet::Conn* socket,
-								const Glib::ustring& arguments);
+								const StrView& arguments);
 	// Player requests undo of last move
 	void command_GAME_UNDOMOVE(Gnet::Conn* socket,
-								const Glib::ustring& arguments);
+								const StrView& arguments);
 	// Player requests redo of last move
 	void command_GAME_REDOMOVE(Gnet::Conn* socket,
-								const Glib::ustring& arguments);
+								const StrView& arguments);
 	// Player requests restarting the game
 	void command_GAME_RESTART(Gnet::Conn* socket,
-							  const Glib::ustring& arguments);
+							  const StrView& arguments);
 	// Player requests rotating the players
 	void command_GAME_ROTATE(Gnet::Conn* socket,
-							  const Glib::ustring& arguments);
+							  const StrView& arguments);
 	// Player requests shuffling the players
 	void command_GAME_SHUFFLE(Gnet::Conn* socket,
-							  const Glib::ustring& arguments);
+							  const StrView& arguments);
 	// Player requests a new, possibly different game
 	void command_GAME_RECONFIG(Gnet::Conn* socket,
-								const Glib::ustring& arguments);
+								const StrView& arguments);
+	// Player wants a bot of this type seated in the game
+	void command_GAME_ADDBOT(Gnet::Conn* socket,
+							 const StrView& arguments);
+	// Client wants the bots it added taken out of the game
+	void command_GAME_REMOVEBOTS(Gnet::Conn* socket,
+								 const StrView& arguments);
 };
 
 #endif   // #ifndef INCL_GAME_SERVER_HH
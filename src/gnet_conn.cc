@@ -20,9 +20,12 @@
  */
 
 #include <glibmm/ustring.h>
+#include <glibmm/main.h>
 #include <iostream>
+#include <cstring>
 
 #include "gnet_conn.hh"
+#include "proto_codec.hh"
 
 // #define DEBUG_SOCKET 1
 
@@ -33,7 +36,11 @@ Gnet::Conn::Conn()
 {
 	_status = statIdle;
 	_conn = NULL;
+	_detached = NULL;
+	_context = g_main_context_default();
 	_read_count = 0;
+	_flush_queued = false;
+	reset_binary();
 }
 
 
@@ -45,6 +52,11 @@ Gnet::ConnBuffered::ConnBuffered() : Conn()
 Gnet::Conn::Conn(GConn* gconn)
 {
 	_conn = gconn;
+	_detached = NULL;
+	_context = g_main_context_default();
+	_read_count = 0;
+	_flush_queued = false;
+	reset_binary();
 	_status = statConnected;
 	gnet_conn_set_callback(_conn, &Gnet::Conn::handle_event_static, this);
 	do_read();
@@ -54,6 +66,7 @@ Gnet::Conn::Conn(GConn* gconn)
 Gnet::ConnBuffered::ConnBuffered(GConn* gconn)
 {
 	_conn = gconn;
+	_detached = NULL;
 	_status = statConnected;
 	gnet_conn_set_callback(_conn, &Gnet::ConnBuffered::handle_event_static, this);
 	do_read();
@@ -75,6 +88,45 @@ Gnet::Conn::connect(const Glib::ustring& host, unsigned int port)
 }
 
 
+bool
+Gnet::Conn::detach()
+{
+	if (!_conn || _status != statConnected)
+		return false;
+
+	// The GConn deletes its socket, so keep a reference for attach()
+	_detached = _conn->socket;
+	gnet_tcp_socket_ref(_detached);
+
+	gnet_conn_delete(_conn);
+	_conn = NULL;
+
+	// What's waiting to be written goes out once attached again
+	_flush_idle.disconnect();
+	_flush_queued = false;
+
+	return true;
+}
+
+
+void
+Gnet::Conn::attach(GMainContext* context)
+{
+	if (!_detached)
+		return;
+
+	_conn = gnet_conn_new_socket(_detached, &Gnet::Conn::handle_event_static,
+								 this);
+	gnet_conn_set_main_context(_conn, context);
+	_context = context;
+	_detached = NULL;
+	do_read();
+
+	if (!_output.empty())
+		queue_flush();
+}
+
+
 Gnet::Conn::Status 
 Gnet::Conn::get_status() const 
 {
@@ -103,6 +155,45 @@ Gnet::Conn::get_read_count() const
 }
 
 
+void
+Gnet::Conn::set_binary_input(bool binary)
+{
+	_binary_input = binary;
+	_frame_length = 0;
+}
+
+
+void
+Gnet::Conn::set_binary_output(bool binary)
+{
+	_binary_output = binary;
+}
+
+
+bool
+Gnet::Conn::get_binary_input() const
+{
+	return _binary_input;
+}
+
+
+bool
+Gnet::Conn::get_binary_output() const
+{
+	return _binary_output;
+}
+
+
+void
+Gnet::Conn::reset_binary()
+{
+	_binary_input = false;
+	_binary_output = false;
+	_frame_length = 0;
+	_partial_line.clear();
+}
+
+
 bool 
 Gnet::Conn::get_buffered() const
 {
@@ -122,9 +213,18 @@ Gnet::Conn::close()
 {
 	if (_conn)
 	{
+		flush();
 		gnet_conn_delete(_conn);
 		_conn = NULL;
 	}
+
+	if (_detached)
+	{
+		gnet_tcp_socket_delete(_detached);
+		_detached = NULL;
+	}
+	_output.clear();
+	reset_binary();
 	
 	switch (_status)
 	{
@@ -152,10 +252,17 @@ Gnet::Conn::do_read()
 }
 
 
+// Binary input reads each frame's length, and then the rest of it
 void
 Gnet::ConnBuffered::do_read()
 {
-	if (_conn && _status == statConnected)
+	if (!_conn || _status != statConnected)
+		return;
+
+	if (_binary_input)
+		gnet_conn_readn(_conn, _frame_length ? _frame_length :
+						ProtoCodec::HEADER_SIZE);
+	else
 		gnet_conn_readline(_conn);
 }
 
@@ -179,7 +286,15 @@ Gnet::Conn::handle_event(GConn *conn, GConnEvent *event)
 			return;
 
 		case GNET_CONN_READ:
-			if (event->length > 0)
+			if (_binary_input)
+			{
+				if (!read_frame(event->buffer, event->length))
+				{
+					evt_error(errIO);
+					break;
+				}
+			}
+			else if (event->length > 0)
 			{
 				evt_data_available(event->buffer);
 				_read_count++;
@@ -227,18 +342,127 @@ Gnet::Conn::handle_event(GConn *conn, GConnEvent *event)
 Gnet::Conn&
 Gnet::Conn::operator<<(const Glib::ustring &data)
 {
-	if (_conn && _status == statConnected)
-		gnet_conn_write(_conn, (char*)(data.c_str()), data.length());
+	return write(data.data(), data.bytes());
+}
+
+
+Gnet::Conn&
+Gnet::Conn::write(const gchar *data, unsigned long count)
+{
+	if ((_conn || _detached) && _status == statConnected)
+	{
+		evt_written(data, count);
+		if (_binary_output)
+			encode_output(data, count, &_output);
+		else
+			_output.append(data, count);
+		queue_flush();
+	}
 
 	return *this;
 }
 
 
+// GNet copies whatever it's given, so there's no sharing with it
 Gnet::Conn&
-Gnet::Conn::write(gchar *data, unsigned long count)
+Gnet::Conn::write(const SharedData& data, const SharedData& frames)
 {
-	if (_conn && _status == statConnected)
-		gnet_conn_write(_conn, data, count);
+	if (_binary_output && frames && _partial_line.empty())
+	{
+		if ((_conn || _detached) && _status == statConnected)
+		{
+			evt_written(data->data(), data->length());
+			_output += *frames;
+			queue_flush();
+		}
+		return *this;
+	}
 
-	return *this;
+	return write(data->data(), data->length());
+}
+
+
+void
+Gnet::Conn::encode_output(const gchar *data, unsigned long count,
+						  std::string *frames)
+{
+	const gchar *end = data + count;
+
+	while (data < end)
+	{
+		const gchar *newline = (const gchar*)memchr(data, '\n', end - data);
+		if (!newline)
+		{
+			_partial_line.append(data, end - data);
+			return;
+		}
+
+		if (_partial_line.empty())
+			ProtoCodec::encode_line(data, newline - data, frames);
+		else
+		{
+			_partial_line.append(data, newline - data);
+			ProtoCodec::encode_line(_partial_line.data(),
+									_partial_line.length(), frames);
+			_partial_line.clear();
+		}
+		data = newline + 1;
+	}
+}
+
+
+bool
+Gnet::Conn::read_frame(const gchar *data, unsigned long count)
+{
+	if (!_frame_length)
+	{
+		if (count < ProtoCodec::HEADER_SIZE)
+			return false;
+		_frame_length = ProtoCodec::get_body_length(data);
+		return (_frame_length > 0);
+	}
+
+	std::string line;
+
+	_frame_length = 0;
+	if (!ProtoCodec::decode_line(data, count, &line))
+		return false;
+
+	evt_data_available(line);
+	_read_count++;
+	return true;
+}
+
+
+void
+Gnet::Conn::flush()
+{
+	if (_conn && _status == statConnected && !_output.empty())
+	{
+		gnet_conn_write(_conn, (gchar*)_output.data(), _output.length());
+		_output.clear();
+	}
+}
+
+
+// At the main loop's usual priority, rather than an idle one, so output
+// isn't held up while there's other work about
+void
+Gnet::Conn::queue_flush()
+{
+	if (_flush_queued)
+		return;
+
+	_flush_queued = true;
+	_flush_idle = Glib::wrap(_context, true)->signal_idle().connect(
+		sigc::mem_fun(*this, &Gnet::Conn::flush_queued), Glib::PRIORITY_DEFAULT);
+}
+
+
+bool
+Gnet::Conn::flush_queued()
+{
+	_flush_queued = false;
+	flush();
+	return false;
 }
@@ -23,10 +23,13 @@
 #ifndef INCL_GNET_CONN_HH
 #define INCL_GNET_CONN_HH
 
+#include <string>
 #include <glibmm/ustring.h>
 #include <sigc++/sigc++.h>
 #include "gnet-2.0/gnet.h"
 
+#include "output_queue.hh"
+
 
 namespace Gnet {
 	class Conn;
@@ -48,32 +51,86 @@ class Gnet::Conn : public sigc::trackable
 	
 		void connect(const Glib::ustring& host, unsigned int port);
 		Status get_status() const;
-		Glib::ustring get_host_name() const;
-		unsigned int get_port() const;
+		virtual Glib::ustring get_host_name() const;
+		virtual unsigned int get_port() const;
 		virtual bool get_buffered() const;
-		void close();
+		virtual void close();
+
+		// Stops watching the socket, without closing it, so it can be
+		// handed to another thread.  Anything still waiting to be read is
+		// dropped.  Returns false if there's no connection to detach.
+		virtual bool detach();
+		// Carries on after detach(), watching the socket from context's
+		// main loop.  Call from that main loop's thread.
+		virtual void attach(GMainContext* context);
+
+		// Sends everything written so far.  Writes are held until this is
+		// called, or the main loop has finished what it's doing, so a
+		// message built up from many writes goes out in one piece.
+		virtual void flush();
 
 		// Number of times evt_data_available has been called
 		unsigned int get_read_count() const;
 
+		// Once binary input is set, what comes in is read as protocol v10
+		// frames (see ProtoCodec), which are turned back into lines for
+		// evt_data_available.  Once binary output is set, whole lines
+		// written go out as frames.  Either can be set from within a
+		// handler, taking effect from the next line.  Only for buffered
+		// connections; closing goes back to text.
+		void set_binary_input(bool binary);
+		void set_binary_output(bool binary);
+		bool get_binary_input() const;
+		bool get_binary_output() const;
+
 		sigc::signal<void>					evt_connected;
 		sigc::signal<void>					evt_cancelled;
 		sigc::signal<void, Glib::ustring>	evt_data_available;
 		sigc::signal<void>					evt_closed;
 		sigc::signal<void, Error>			evt_error;   
+		// Everything written while connected, as text, before any framing
+		sigc::signal<void, const gchar*, unsigned long>	evt_written;
 	
 		Conn& operator<<(const Glib::ustring& data);
-		Conn& write(gchar *data, unsigned long count);
+		virtual Conn& write(const gchar *data, unsigned long count);
+		// For the same message to many connections, encoded just once.
+		// frames, if there are any, are data's lines already framed, for
+		// binary connections to use instead.
+		virtual Conn& write(const SharedData& data,
+							const SharedData& frames = SharedData());
 	
 	protected:
 		virtual void do_read();
 		static void handle_event_static(GConn *conn, GConnEvent *event,
 										gpointer data);
 		void handle_event(GConn *conn, GConnEvent *event);
+
+		// Arranges for flush() to be called once the main loop is idle
+		virtual void queue_flush();
+		bool flush_queued();
+
+		// Frames the whole lines in data, keeping any partial line until
+		// the rest of it is written
+		void encode_output(const gchar *data, unsigned long count,
+						   std::string *frames);
+		// Takes in one of GNet's reads in binary input, the length or
+		// the body of a frame, returning false if it's not a proper one
+		bool read_frame(const gchar *data, unsigned long count);
+		void reset_binary();
 	
 		GConn*						_conn;
+		GTcpSocket*					_detached;
+		GMainContext*				_context;
 		Status						_status;
 		unsigned int				_read_count;
+		std::string					_output;
+		bool						_flush_queued;
+		sigc::connection			_flush_idle;
+		bool						_binary_input;
+		bool						_binary_output;
+		// The length of the frame being read, once its header's in
+		unsigned int				_frame_length;
+		std::string					_partial_line;
 };
 
 
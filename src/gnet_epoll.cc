@@ -0,0 +1,536 @@
+/*
+ *  A Gnet::Conn for accepted sockets that does its own I/O with Linux's
+ *  epoll, instead of through GNet.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include "gnet_epoll.hh"
+
+#ifdef HAVE_SYS_EPOLL_H
+
+#include <map>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <glibmm/thread.h>
+
+#include "proto_codec.hh"
+
+
+Gnet::EpollLoop* Gnet::EpollLoop::get(GMainContext *context)
+{
+	static Glib::Mutex mutex;
+	static std::map<GMainContext*, EpollLoop*> loops;
+
+	Glib::Mutex::Lock lock(mutex);
+
+	EpollLoop *&loop = loops[context];
+	if (!loop)
+		loop = new EpollLoop(context);
+
+	return loop;
+}
+
+
+Gnet::EpollLoop::EpollLoop(GMainContext *context)
+	:_dispatching(false)
+{
+	_fd = epoll_create1(EPOLL_CLOEXEC);
+	Glib::wrap(context, true)->signal_io().connect(sigc::mem_fun(*this,
+		&EpollLoop::dispatch), _fd, Glib::IO_IN);
+}
+
+
+bool Gnet::EpollLoop::add(int fd, EpollHandler *handler, unsigned int events)
+{
+	epoll_event event;
+	event.events = events;
+	event.data.ptr = handler;
+
+	return (epoll_ctl(_fd, EPOLL_CTL_ADD, fd, &event) == 0);
+}
+
+
+void Gnet::EpollLoop::remove(int fd, EpollHandler *handler)
+{
+	epoll_event event;
+	epoll_ctl(_fd, EPOLL_CTL_DEL, fd, &event);
+
+	// Its flush is dropped here rather than skipped by address, as a
+	// handler made meanwhile at the same address may queue its own
+	if (_dispatching)
+	{
+		_removed.insert(handler);
+		std::replace(_flushes.begin(), _flushes.end(), handler,
+					 (EpollHandler*)NULL);
+	}
+}
+
+
+bool Gnet::EpollLoop::queue_flush(EpollHandler *handler)
+{
+	if (!_dispatching)
+		return false;
+
+	_flushes.push_back(handler);
+	return true;
+}
+
+
+// Called by the main loop when there are events waiting.  Takes up to
+// MAX_EVENTS of them at a time; if there are more, the main loop calls
+// again after seeing to everything else.  Whatever the handlers wrote in
+// reply is sent at the end, so replies to many clients' messages go out
+// one send each.
+bool Gnet::EpollLoop::dispatch(Glib::IOCondition condition)
+{
+	epoll_event events[MAX_EVENTS];
+	int num_events = epoll_wait(_fd, events, MAX_EVENTS, 0);
+
+	_dispatching = true;
+	for (int e = 0; e < num_events; e++)
+	{
+		EpollHandler *handler = (EpollHandler*)events[e].data.ptr;
+		if (!_removed.count(handler))
+			handler->handle_events(events[e].events);
+	}
+	for (unsigned int f = 0; f < _flushes.size(); f++)
+		if (_flushes[f])
+			_flushes[f]->handle_flush();
+	_flushes.clear();
+	_dispatching = false;
+	_removed.clear();
+
+	return true;
+}
+
+
+Gnet::EpollConn::EpollConn(int fd, bool buffered, GMainContext *context)
+	:_fd(fd),
+	 _buffered(buffered),
+	 _loop(NULL),
+	 _port(0),
+	 _failed(false),
+	 _alive(NULL)
+{
+	_status = statConnected;
+
+	fcntl(_fd, F_SETFL, fcntl(_fd, F_GETFL) | O_NONBLOCK);
+	// Moves are small and someone's waiting on each one
+	int flag = 1;
+	setsockopt(_fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+
+	sockaddr_storage address;
+	socklen_t length = sizeof(address);
+	char host[INET6_ADDRSTRLEN];
+
+	if (getpeername(_fd, (sockaddr*)&address, &length) == 0)
+	{
+		if (address.ss_family == AF_INET6)
+		{
+			sockaddr_in6 *address6 = (sockaddr_in6*)&address;
+			if (IN6_IS_ADDR_V4MAPPED(&address6->sin6_addr))
+				inet_ntop(AF_INET, &address6->sin6_addr.s6_addr[12],
+						  host, sizeof(host));
+			else
+				inet_ntop(AF_INET6, &address6->sin6_addr, host, sizeof(host));
+			_port = ntohs(address6->sin6_port);
+		}
+		else
+		{
+			sockaddr_in *address4 = (sockaddr_in*)&address;
+			inet_ntop(AF_INET, &address4->sin_addr, host, sizeof(host));
+			_port = ntohs(address4->sin_port);
+		}
+		_host_name = host;
+	}
+
+	attach(context);
+}
+
+
+Gnet::EpollConn::~EpollConn()
+{
+	if (_alive)
+		*_alive = false;
+
+	close();
+}
+
+
+Glib::ustring Gnet::EpollConn::get_host_name() const
+{
+	return _host_name;
+}
+
+
+unsigned int Gnet::EpollConn::get_port() const
+{
+	return _port;
+}
+
+
+bool Gnet::EpollConn::get_buffered() const
+{
+	return _buffered;
+}
+
+
+// Sends what it can of anything still waiting, without waiting itself
+void Gnet::EpollConn::close()
+{
+	if (_fd >= 0)
+	{
+		if (_loop)
+		{
+			send_output();
+			_loop->remove(_fd, this);
+			_loop = NULL;
+		}
+		::close(_fd);
+		_fd = -1;
+	}
+
+	_in.clear();
+	_out.clear();
+
+	if (_status == statConnected)
+	{
+		_status = statIdle;
+		evt_closed();
+	}
+}
+
+
+bool Gnet::EpollConn::detach()
+{
+	if (_fd < 0 || !_loop || _status != statConnected)
+		return false;
+
+	send_output();
+	_loop->remove(_fd, this);
+	_loop = NULL;
+	_in.clear();
+	_flush_idle.disconnect();
+	_flush_queued = false;
+
+	return true;
+}
+
+
+// Anything that came in while detached is still waiting in the socket,
+// and adding it to the new epoll set reports it straight away, along
+// with its being writable, for anything left to send.
+void Gnet::EpollConn::attach(GMainContext *context)
+{
+	if (_fd < 0 || _loop)
+		return;
+
+	_context = context;
+	_loop = EpollLoop::get(context);
+	if (!_loop->add(_fd, this, EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET))
+	{
+		_loop = NULL;
+		fail();
+	}
+}
+
+
+Gnet::Conn& Gnet::EpollConn::write(const gchar *data, unsigned long count)
+{
+	if (_fd < 0 || _status != statConnected)
+		return *this;
+
+	evt_written(data, count);
+	if (_binary_output)
+	{
+		std::string frames;
+		encode_output(data, count, &frames);
+		_out.append(frames.data(), frames.length());
+	}
+	else
+		_out.append(data, count);
+	queue_flush();
+
+	return *this;
+}
+
+
+Gnet::Conn& Gnet::EpollConn::write(const SharedData& data,
+								   const SharedData& frames)
+{
+	if (_fd < 0 || _status != statConnected)
+		return *this;
+
+	if (_binary_output && (!frames || !_partial_line.empty()))
+		return write(data->data(), data->length());
+
+	evt_written(data->data(), data->length());
+	if (_binary_output)
+		_out.append(frames);
+	else
+		_out.append(data);
+	queue_flush();
+
+	return *this;
+}
+
+
+void Gnet::EpollConn::flush()
+{
+	if (_loop && !send_output())
+		fail();
+}
+
+
+void Gnet::EpollConn::handle_flush()
+{
+	_flush_queued = false;
+	flush();
+}
+
+
+// At the end of the dispatch if we're in one, as when answering a
+// client, or else on the next idle, as from a timeout
+void Gnet::EpollConn::queue_flush()
+{
+	if (_flush_queued || !_loop)
+		return;
+
+	if (_loop->queue_flush(this))
+		_flush_queued = true;
+	else
+		Conn::queue_flush();
+}
+
+
+void Gnet::EpollConn::handle_events(unsigned int events)
+{
+	bool alive = true;
+	bool open = true;
+
+	_alive = &alive;
+
+	if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+		open = read_socket(&alive);
+	if (!alive)
+		return;
+
+	if (open && _loop && (events & EPOLLOUT) && !send_output())
+	{
+		_failed = true;
+		open = false;
+	}
+
+	// Closed or detached by a signal handler, or still going
+	if (open || !_loop)
+	{
+		_alive = NULL;
+		return;
+	}
+
+	if (_failed)
+	{
+		evt_error(errIO);
+		if (!alive)
+			return;
+	}
+
+	_alive = NULL;
+	close();
+}
+
+
+// Reads until the socket's empty, returning false once it's closed or
+// broken
+bool Gnet::EpollConn::read_socket(bool *alive)
+{
+	for (;;)
+	{
+		unsigned int space;
+		char *back = _in.reserve(&space);
+		ssize_t received = recv(_fd, back, space, 0);
+
+		if (received > 0)
+		{
+			_in.commit(received);
+			if (!deliver(alive))
+				return false;
+			if (!*alive || !_loop)
+				return true;
+		}
+		else if (received == 0)
+			return false;
+		else if (errno == EAGAIN || errno == EWOULDBLOCK)
+			return true;
+		else if (errno != EINTR)
+		{
+			_failed = true;
+			return false;
+		}
+	}
+}
+
+
+bool Gnet::EpollConn::deliver(bool *alive)
+{
+	if (!_buffered)
+	{
+		evt_data_available(_in.take(_in.size()));
+		if (*alive)
+			_read_count++;
+		return true;
+	}
+
+	for (;;)
+	{
+		std::string line;
+		int taken = _binary_input ? take_frame(&line) : take_line(&line);
+
+		if (taken < 0)
+		{
+			_failed = true;
+			return false;
+		}
+		if (!taken)
+			return true;
+
+		evt_data_available(line);
+		if (!*alive)
+			return true;
+		_read_count++;
+		if (!_loop)
+			return true;
+	}
+}
+
+
+// Lines end with \n, \r\n, \r or \0, which are left off, as with GNet.
+// A \r at the end of what's come in waits to see if a \n follows.
+// Returns 1 for a line, 0 if there isn't a whole one yet, or -1 if
+// there's too much without an end.
+int Gnet::EpollConn::take_line(std::string *line)
+{
+	int end = _in.find_first_of("\n\r\0", 3);
+	if (end < 0)
+		return (_in.size() <= MAX_LINE) ? 0 : -1;
+
+	unsigned int length = 1;
+	if (_in.at(end) == '\r')
+	{
+		if ((unsigned int)end + 1 == _in.size())
+			return 0;
+		if (_in.at(end + 1) == '\n')
+			length = 2;
+	}
+
+	*line = _in.take(end);
+	_in.consume(length);
+	return 1;
+}
+
+
+// The same, for a frame of binary input, turned back into its line
+int Gnet::EpollConn::take_frame(std::string *line)
+{
+	if (_in.size() < ProtoCodec::HEADER_SIZE)
+		return 0;
+
+	char header[ProtoCodec::HEADER_SIZE];
+	for (unsigned int h = 0; h < ProtoCodec::HEADER_SIZE; h++)
+		header[h] = _in.at(h);
+
+	unsigned int length = ProtoCodec::get_body_length(header);
+	if (!length)
+		return -1;
+	if (_in.size() < ProtoCodec::HEADER_SIZE + length)
+		return 0;
+
+	_in.consume(ProtoCodec::HEADER_SIZE);
+	std::string body = _in.take(length);
+
+	return ProtoCodec::decode_line(body.data(), body.length(), line) ? 1 : -1;
+}
+
+
+// Sends as much of the queue as the socket will take, up to MAX_PARTS
+// pieces of it at once, returning false if it's broken
+bool Gnet::EpollConn::send_output()
+{
+	while (!_out.empty())
+	{
+		const char *parts[MAX_PARTS];
+		unsigned long lengths[MAX_PARTS];
+		iovec vector[MAX_PARTS];
+		msghdr message;
+		unsigned int num_parts = _out.get_parts(parts, lengths, MAX_PARTS);
+
+		for (unsigned int p = 0; p < num_parts; p++)
+		{
+			vector[p].iov_base = (void*)parts[p];
+			vector[p].iov_len = lengths[p];
+		}
+		memset(&message, 0, sizeof(message));
+		message.msg_iov = vector;
+		message.msg_iovlen = num_parts;
+
+		// Like writev(), but without a SIGPIPE if the client's gone
+		ssize_t sent = sendmsg(_fd, &message, MSG_NOSIGNAL);
+
+		if (sent > 0)
+			_out.consume(sent);
+		else if (sent < 0 && errno == EINTR)
+			continue;
+		else if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return true;
+		else
+			return false;
+	}
+
+	return true;
+}
+
+
+// Writes can fail in the middle of a signal handler, which mightn't
+// expect the socket to close under it, so that waits for the main loop
+void Gnet::EpollConn::fail()
+{
+	if (_failed)
+		return;
+
+	_failed = true;
+	Glib::wrap(_context, true)->signal_idle().connect(sigc::mem_fun(*this,
+		&EpollConn::report_failure));
+}
+
+
+bool Gnet::EpollConn::report_failure()
+{
+	evt_error(errIO);
+	close();
+	return false;
+}
+
+#endif   // #ifdef HAVE_SYS_EPOLL_H
@@ -0,0 +1,151 @@
+/*
+ *  A Gnet::Conn for accepted sockets that does its own I/O with Linux's
+ *  epoll, instead of through GNet.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef INCL_GNET_EPOLL_HH
+#define INCL_GNET_EPOLL_HH
+
+#include "config.h"
+
+#ifdef HAVE_SYS_EPOLL_H
+
+#include <set>
+#include <vector>
+#include <glibmm/main.h>
+
+#include "gnet_conn.hh"
+#include "ring_buffer.hh"
+#include "output_queue.hh"
+
+
+namespace Gnet {
+	class EpollHandler;
+	class EpollLoop;
+	class EpollConn;
+}
+
+
+// Something with a file descriptor in an EpollLoop
+class Gnet::EpollHandler
+{
+	public:
+		virtual ~EpollHandler() {}
+		virtual void handle_events(unsigned int events) = 0;
+		// For EpollLoop::queue_flush()
+		virtual void handle_flush() {}
+};
+
+
+// One epoll set per main loop, which the main loop watches like any
+// other file descriptor, so however many sockets there are, the main
+// loop only polls the one.  Sockets are edge-triggered: handlers are only
+// told when something changes, so they must read or write until they'd
+// block.  Only use a loop from its main loop's thread.
+class Gnet::EpollLoop : public sigc::trackable
+{
+	public:
+		// The loop for context, made the first time it's asked for
+		static EpollLoop* get(GMainContext *context);
+
+		bool add(int fd, EpollHandler *handler, unsigned int events);
+		void remove(int fd, EpollHandler *handler);
+
+		// While dispatching, has handler's handle_flush() called once
+		// every handler has had its events, and returns true.  Returns
+		// false otherwise.
+		bool queue_flush(EpollHandler *handler);
+
+	private:
+		const static int MAX_EVENTS = 64;
+
+		EpollLoop(GMainContext *context);
+		EpollLoop(const EpollLoop& loop);
+		EpollLoop& operator=(const EpollLoop& loop);
+
+		bool dispatch(Glib::IOCondition condition);
+
+		int							_fd;
+		// Handlers removed while dispatching, whose events are skipped
+		std::set<EpollHandler*>		_removed;
+		// NULL where the handler's been removed since
+		std::vector<EpollHandler*>	_flushes;
+		bool						_dispatching;
+};
+
+
+// Reads go straight from the socket into a ring, and writes are queued
+// until the end of the EpollLoop's dispatch, or the main loop's next
+// idle, when they go out together, as much as the socket will take.
+// Shared writes are queued as they are, so a broadcast to many clients
+// isn't copied for each.
+// Buffered connections split what comes in into lines the way GNet's
+// readline does, so it can stand in for ConnBuffered as well as Conn.
+// There's no connect(); these only come from Gnet::Server.
+class Gnet::EpollConn
+	: public Gnet::Conn, public Gnet::EpollHandler
+{
+	public:
+		EpollConn(int fd, bool buffered, GMainContext *context);
+		virtual ~EpollConn();
+
+		virtual Glib::ustring get_host_name() const;
+		virtual unsigned int get_port() const;
+		virtual bool get_buffered() const;
+		virtual void close();
+		virtual bool detach();
+		virtual void attach(GMainContext *context);
+
+		virtual Conn& write(const gchar *data, unsigned long count);
+		virtual Conn& write(const SharedData& data,
+							const SharedData& frames = SharedData());
+		virtual void flush();
+
+		virtual void handle_events(unsigned int events);
+		virtual void handle_flush();
+
+	private:
+		// A line this long with no end is an error
+		const static unsigned int MAX_LINE = 65536;
+		// Most pieces of the output queue to send in one go
+		const static unsigned int MAX_PARTS = 16;
+
+		bool read_socket(bool *alive);
+		bool deliver(bool *alive);
+		int take_line(std::string *line);
+		int take_frame(std::string *line);
+		virtual void queue_flush();
+		bool send_output();
+		void fail();
+		bool report_failure();
+
+		int					_fd;
+		bool				_buffered;
+		EpollLoop			*_loop;
+		RingBuffer			_in;
+		OutputQueue			_out;
+		Glib::ustring		_host_name;
+		unsigned int		_port;
+		bool				_failed;
+		// Set to false if we're deleted from within a signal handler
+		bool				*_alive;
+};
+
+#endif   // #ifdef HAVE_SYS_EPOLL_H
+
+#endif   // #ifndef INCL_GNET_EPOLL_HH
@@ -1,6 +1,7 @@
 /*
  *  Implements a server socket with an aditional signal for
- *  incoming connections, using the GNet library.
+ *  incoming connections, using the GNet library, or epoll where there is
+ *  one.
  *
  *  This program is free software; you can redistribute it and/or modify
  *  it under the terms of the GNU General Public License as published by
@@ -22,6 +23,15 @@
 
 #include "gnet_server.hh"
 
+#ifdef HAVE_SYS_EPOLL_H
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#endif
+
 // #define DEBUG_SOCKET 1
 
 
@@ -29,7 +39,13 @@ using namespace std;
 
 Gnet::Server::Server() 
 	:_server(NULL),
-	 _buffered(false)
+	 _buffered(false),
+#ifdef HAVE_SYS_EPOLL_H
+	 _native(true),
+#else
+	 _native(false),
+#endif
+	 _fd(-1)
 {
 }
 
@@ -43,7 +59,23 @@ Gnet::Server::~Server()
 bool 
 Gnet::Server::ready() const
 {
-	return (_server != NULL); 
+	return (_server != NULL || _fd >= 0); 
+}
+
+
+void
+Gnet::Server::set_native(bool native)
+{
+#ifdef HAVE_SYS_EPOLL_H
+	_native = native;
+#endif
+}
+
+
+bool
+Gnet::Server::get_native() const
+{
+	return _native;
 }
 
 
@@ -51,6 +83,10 @@ bool
 Gnet::Server::listen(unsigned int port, bool buffered)
 {
 	_buffered = buffered;
+#ifdef HAVE_SYS_EPOLL_H
+	if (_native)
+		return listen_native(port);
+#endif
 	_server = gnet_server_new(NULL, port, &Gnet::Server::handle_accept_static, this);
 	if (!_server)
 	{
@@ -65,7 +101,21 @@ Gnet::Server::listen(unsigned int port, bool buffered)
 void 
 Gnet::Server::close()
 {
-	gnet_server_delete(_server);
+	if (_server)
+	{
+		gnet_server_delete(_server);
+		_server = NULL;
+	}
+
+#ifdef HAVE_SYS_EPOLL_H
+	_accept_retry.disconnect();
+	if (_fd >= 0)
+	{
+		EpollLoop::get(g_main_context_default())->remove(_fd, this);
+		::close(_fd);
+		_fd = -1;
+	}
+#endif
 }
 
 
@@ -96,3 +146,123 @@ Gnet::Server::handle_accept(GServer* server, GConn* client)
 
 	evt_connection_available(client_conn);
 }
+
+
+#ifdef HAVE_SYS_EPOLL_H
+
+// Listens on IPv6 and IPv4 both if it can, or just IPv4
+bool
+Gnet::Server::listen_native(unsigned int port)
+{
+	int flag = 1;
+	int no_flag = 0;
+	sockaddr_in6 address6;
+	sockaddr_in address4;
+
+	memset(&address6, 0, sizeof(address6));
+	address6.sin6_family = AF_INET6;
+	address6.sin6_addr = in6addr_any;
+	address6.sin6_port = htons(port);
+
+	memset(&address4, 0, sizeof(address4));
+	address4.sin_family = AF_INET;
+	address4.sin_addr.s_addr = htonl(INADDR_ANY);
+	address4.sin_port = htons(port);
+
+	_fd = socket(AF_INET6, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (_fd >= 0)
+	{
+		setsockopt(_fd, IPPROTO_IPV6, IPV6_V6ONLY, &no_flag, sizeof(no_flag));
+		setsockopt(_fd, SOL_SOCKET, SO_REUSEADDR, &flag, sizeof(flag));
+		if (bind(_fd, (sockaddr*)&address6, sizeof(address6)) < 0)
+		{
+			::close(_fd);
+			_fd = -1;
+		}
+	}
+
+	if (_fd < 0)
+	{
+		_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		if (_fd >= 0)
+		{
+			setsockopt(_fd, SOL_SOCKET, SO_REUSEADDR, &flag, sizeof(flag));
+			if (bind(_fd, (sockaddr*)&address4, sizeof(address4)) < 0)
+			{
+				::close(_fd);
+				_fd = -1;
+			}
+		}
+	}
+
+	if (_fd < 0 || ::listen(_fd, SOMAXCONN) < 0 ||
+		!EpollLoop::get(g_main_context_default())->add(_fd, this,
+													   EPOLLIN | EPOLLET))
+	{
+		if (_fd >= 0)
+			::close(_fd);
+		_fd = -1;
+#ifdef DEBUG_SOCKET
+		cerr << "* ERROR * " << "Server failed." << endl;
+#endif
+		evt_error();
+		return false;
+	}
+
+	return true;
+}
+
+
+// Accepts everyone waiting, as epoll won't say again until someone new
+// turns up.  So if it runs out of descriptors or memory with clients
+// still waiting, it tries again itself a little later.
+void
+Gnet::Server::handle_events(unsigned int events)
+{
+	while (_fd >= 0)
+	{
+		int client = accept4(_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (client < 0)
+		{
+			// A client that gave up while waiting, which says nothing
+			// about the ones behind it
+			if (errno == EINTR || errno == ECONNABORTED || errno == EPROTO)
+				continue;
+
+			if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS ||
+				errno == ENOMEM)
+			{
+#ifdef DEBUG_SOCKET
+				cerr << "* ERROR * " << "accept out of resources, retrying."
+					<< endl;
+#endif
+				if (!_accept_retry.connected())
+					_accept_retry = Glib::signal_timeout().connect(
+						sigc::mem_fun(*this, &Gnet::Server::retry_accept),
+						ACCEPT_RETRY_TIME);
+				return;
+			}
+
+#ifdef DEBUG_SOCKET
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				cerr << "* ERROR * " << "accept failed." << endl;
+#endif
+			return;
+		}
+
+		evt_connection_available(new EpollConn(client, _buffered,
+											   g_main_context_default()));
+	}
+}
+
+
+// Let go of first, so handle_events() can set up another if it's needed
+bool
+Gnet::Server::retry_accept()
+{
+	_accept_retry.disconnect();
+	handle_events(EPOLLIN);
+	return false;
+}
+
+#endif   // #ifdef HAVE_SYS_EPOLL_H
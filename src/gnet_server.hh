@@ -1,6 +1,7 @@
 /*
  *  Implements a server socket with an aditional signal for
- *  incoming connections, using the GNet library.
+ *  incoming connections, using the GNet library, or epoll where there is
+ *  one.
  *
  *  This program is free software; you can redistribute it and/or modify
  *  it under the terms of the GNU General Public License as published by
@@ -23,17 +24,25 @@
 #define INCL_SOCKET_SERVER_HH
 
 #include <glibmm/ustring.h>
+#include <glibmm/main.h>
 #include <sigc++/sigc++.h>
 #include "gnet-2.0/gnet.h"
 
 #include "gnet_conn.hh"
+#include "gnet_epoll.hh"
 
 
 namespace Gnet {
 		class Server;
 }
 
+// With epoll, connections are accepted and served with EpollConns in the
+// default main loop, unless set_native(false) asks for GNet's.  Either
+// way they have the same signals, so the rest of the server can't tell.
 class Gnet::Server : public sigc::trackable
+#ifdef HAVE_SYS_EPOLL_H
+	, public Gnet::EpollHandler
+#endif
 {
 public:
 	Server();
@@ -42,6 +51,10 @@ public:
 	sigc::signal<void, Conn*>			evt_connection_available;
 	sigc::signal<void>					evt_error;   
 
+	// Call before listen()
+	void set_native(bool native);
+	bool get_native() const;
+
 	bool listen(unsigned int port, bool buffered = false);
 	bool ready() const;
 	void close();
@@ -50,8 +63,20 @@ private:
 	static void handle_accept_static(GServer* server, GConn* client, gpointer data);
 	void handle_accept(GServer* server, GConn* client);
 
-	GServer*		_server;
-	bool			_buffered;
+#ifdef HAVE_SYS_EPOLL_H
+	// Milliseconds to wait before accepting again when out of descriptors
+	const static unsigned int ACCEPT_RETRY_TIME = 100;
+
+	bool listen_native(unsigned int port);
+	virtual void handle_events(unsigned int events);
+	bool retry_accept();
+#endif
+
+	GServer*			_server;
+	bool				_buffered;
+	bool				_native;
+	int					_fd;
+	sigc::connection	_accept_retry;
 };
 
 #endif   // #ifndef INCL_SOCKET_SERVER_HH
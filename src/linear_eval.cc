@@ -0,0 +1,244 @@
+/*
+ *  A linear evaluation of the whole board, with a weight for each player's
+ *  pegs in each hole, as seen by each player.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <glibmm.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "linear_eval.hh"
+#include "game_hole.hh"
+#include "utility.hh"
+
+
+static const gint32 ZERO_ROW[LinearEval::LANES] = {0, 0, 0, 0, 0, 0, 0, 0};
+
+
+// next = acc + add - sub, for all lanes at once
+static inline void update_lanes(const gint32 *acc, const gint32 *add,
+								const gint32 *sub, gint32 *next)
+{
+#if defined(__AVX2__)
+	__m256i lanes = _mm256_loadu_si256((const __m256i *)acc);
+	lanes = _mm256_add_epi32(lanes, _mm256_loadu_si256((const __m256i *)add));
+	lanes = _mm256_sub_epi32(lanes, _mm256_loadu_si256((const __m256i *)sub));
+	_mm256_storeu_si256((__m256i *)next, lanes);
+#elif defined(__SSE2__)
+	__m128i low = _mm_loadu_si128((const __m128i *)acc);
+	__m128i high = _mm_loadu_si128((const __m128i *)(acc + 4));
+	low = _mm_add_epi32(low, _mm_loadu_si128((const __m128i *)add));
+	high = _mm_add_epi32(high, _mm_loadu_si128((const __m128i *)(add + 4)));
+	low = _mm_sub_epi32(low, _mm_loadu_si128((const __m128i *)sub));
+	high = _mm_sub_epi32(high, _mm_loadu_si128((const __m128i *)(sub + 4)));
+	_mm_storeu_si128((__m128i *)next, low);
+	_mm_storeu_si128((__m128i *)(next + 4), high);
+#else
+	for (unsigned int l = 0; l < LinearEval::LANES; l++)
+		next[l] = acc[l] + add[l] - sub[l];
+#endif
+}
+
+
+LinearEval::LinearEval()
+{
+	_weights.resize(6 * 6 * GameBoard::SIZE * LANES, 0);
+	set_defaults(50);
+}
+
+
+void LinearEval::set_defaults(long distance_weight)
+{
+	std::fill(_weights.begin(), _weights.end(), 0);
+
+	for (unsigned int n = 1; n <= 6; n++)
+	{
+		GameBoard board(n, false, false, false);
+
+		for (unsigned int p = 1; p <= n; p++)
+		{
+			unsigned int goal = board.get_goal(p);
+
+			for (unsigned int h = 0; h < GameBoard::SIZE; h++)
+				if (board[h])
+					set_weight(n, p, p, h, -(gint32)(distance_weight *
+						board.get_distance(h, goal) + 0.5));
+		}
+	}
+}
+
+
+gint32 LinearEval::get_weight(unsigned int num_players, unsigned int player,
+							  unsigned int owner, unsigned int hole) const
+{
+	return get_row(num_players, owner, hole)[player - 1];
+}
+
+
+void LinearEval::set_weight(unsigned int num_players, unsigned int player,
+							unsigned int owner, unsigned int hole,
+							gint32 weight)
+{
+	_weights[(((num_players - 1) * 6 + owner - 1) * GameBoard::SIZE + hole) *
+			 LANES + player - 1] = weight;
+}
+
+
+bool LinearEval::read(const Glib::ustring& filename)
+{
+	Glib::RefPtr<Glib::IOChannel> pfile;
+
+	try
+	{
+		pfile = Glib::IOChannel::create_from_file(filename, "r");
+	}
+	catch (Glib::FileError)
+	{
+		return false;
+	}
+
+	Glib::ustring line;
+
+	while (pfile->read_line(line) == Glib::IO_STATUS_NORMAL)
+	{
+		util::trim(line);
+		if (line.empty() || line[0] == '#')
+			continue;
+
+		std::istringstream stream(line);
+		unsigned int n, player, owner, hole;
+		gint32 weight;
+
+		stream >> n >> player >> owner >> hole >> weight;
+
+		if (stream && n >= 1 && n <= 6 && player >= 1 && player <= n &&
+			owner >= 1 && owner <= n && hole < GameBoard::SIZE)
+			set_weight(n, player, owner, hole, weight);
+	}
+
+	pfile->close();
+
+	return true;
+}
+
+
+bool LinearEval::write(const Glib::ustring& filename) const
+{
+	Glib::RefPtr<Glib::IOChannel> pfile;
+
+	try
+	{
+		pfile = Glib::IOChannel::create_from_file(filename, "w");
+	}
+	catch (Glib::FileError)
+	{
+		std::cerr << "Can't write linear weights to '"
+			<< filename << "'." << std::endl;
+		return false;
+	}
+
+	pfile->write("# cheech linear evaluation weights: "
+				 "num_players player owner hole weight\n");
+
+	for (unsigned int n = 1; n <= 6; n++)
+		for (unsigned int player = 1; player <= n; player++)
+			for (unsigned int owner = 1; owner <= n; owner++)
+				for (unsigned int h = 0; h < GameBoard::SIZE; h++)
+				{
+					gint32 weight = get_weight(n, player, owner, h);
+
+					if (weight)
+						pfile->write(util::to_str(n) + " " +
+									 util::to_str(player) + " " +
+									 util::to_str(owner) + " " +
+									 util::to_str(h) + " " +
+									 util::to_str(weight) + "\n");
+				}
+
+	pfile->close();
+
+	return true;
+}
+
+
+void LinearEval::refresh(const GameBoard& board, Accumulator *acc) const
+{
+	unsigned int n = board.get_num_players();
+
+	std::fill(acc->values, acc->values + LANES, 0);
+
+	for (unsigned int owner = 1; owner <= n; owner++)
+	{
+		const unsigned int *pegs = board.get_pegs(owner);
+
+		for (unsigned int i = 0; i < 10; i++)
+			update_lanes(acc->values, get_row(n, owner, pegs[i]), ZERO_ROW,
+						 acc->values);
+	}
+}
+
+
+void LinearEval::move_peg(unsigned int num_players, const Accumulator& acc,
+						  unsigned int owner, unsigned int from,
+						  unsigned int to, Accumulator *next) const
+{
+	update_lanes(acc.values, get_row(num_players, owner, to),
+				 get_row(num_players, owner, from), next->values);
+}
+
+
+long LinearEval::get_score(unsigned int num_players, unsigned int player,
+						   const Accumulator& acc) const
+{
+	if (num_players < 2)
+		return acc.values[player - 1];
+
+	long others = 0;
+	for (unsigned int p = 1; p <= num_players; p++)
+		if (p != player)
+			others += acc.values[p - 1];
+
+	return acc.values[player - 1] - others / (long)(num_players - 1);
+}
+
+
+const char *LinearEval::get_simd_name()
+{
+#if defined(__AVX2__)
+	return "AVX2";
+#elif defined(__SSE2__)
+	return "SSE2";
+#else
+	return "scalar";
+#endif
+}
+
+
+const gint32 *LinearEval::get_row(unsigned int num_players,
+								  unsigned int owner, unsigned int hole) const
+{
+	return &_weights[(((num_players - 1) * 6 + owner - 1) *
+					  GameBoard::SIZE + hole) * LANES];
+}
@@ -0,0 +1,86 @@
+/*
+ *  A linear evaluation of the whole board, with a weight for each player's
+ *  pegs in each hole, as seen by each player.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef INCL_LINEAR_EVAL_HH
+#define INCL_LINEAR_EVAL_HH
+
+#include <vector>
+#include <glibmm/ustring.h>
+
+#include "game_board.hh"
+
+
+// Each player's value of a position is the sum of the weights of every
+// occupied hole, where a weight depends on the number of players, whose
+// view it is, whose peg is in the hole, and the hole.  The values for all
+// players are kept together in an Accumulator, one lane per player, so
+// moving a peg updates them all with one vector add (AVX2 or SSE2 when
+// compiled for them, plain C++ otherwise).
+class LinearEval
+{
+public:
+	const static unsigned int LANES = 8;
+
+	class Accumulator
+	{
+	public:
+		gint32	values[LANES];
+	};
+
+	LinearEval();
+
+	// Weights that score each player's own pegs by their distance from
+	// its goal, the same as BotLookAhead's usual evaluation
+	void set_defaults(long distance_weight);
+
+	gint32 get_weight(unsigned int num_players, unsigned int player,
+					  unsigned int owner, unsigned int hole) const;
+	void set_weight(unsigned int num_players, unsigned int player,
+					unsigned int owner, unsigned int hole, gint32 weight);
+
+	// Weights files have one "<num players> <player> <owner> <hole>
+	// <weight>" line per weight.  Weights that aren't in the file keep
+	// their current values.
+	bool read(const Glib::ustring& filename);
+	bool write(const Glib::ustring& filename) const;
+
+	// Sums the weights of the whole board from scratch
+	void refresh(const GameBoard& board, Accumulator *acc) const;
+
+	// Sets next to acc after owner's peg moves from one hole to another
+	void move_peg(unsigned int num_players, const Accumulator& acc,
+				  unsigned int owner, unsigned int from, unsigned int to,
+				  Accumulator *next) const;
+
+	// Player's value less the average of the other players' values
+	long get_score(unsigned int num_players, unsigned int player,
+				   const Accumulator& acc) const;
+
+	static const char *get_simd_name();
+
+private:
+	const gint32 *get_row(unsigned int num_players, unsigned int owner,
+						  unsigned int hole) const;
+
+	// Indexed by [num players - 1][owner - 1][hole][player - 1]
+	std::vector<gint32>	_weights;
+};
+
+#endif   // #ifndef INCL_LINEAR_EVAL_HH
@@ -35,6 +35,10 @@ main_win::main_win() : main_win_glade()
 	_current_player = 0;
 	_move_count = 1;
 	_game_status = GameServer::End;
+	_hint_bot = NULL;
+	_hint_board = NULL;
+	_hint_player = 0;
+	_hint_thread = NULL;
 
 	_player_name[0]=player_name1;
 	_player_name[1]=player_name2;
@@ -63,6 +67,7 @@ main_win::main_win() : main_win_glade()
 		&main_win::append_to_chat_entry));
 	game_view->evt_user_action.connect(sigc::bind(sigc::mem_fun(*this,
 		&Gtk::Window::set_urgency_hint), false));
+	_hint_ready.connect(sigc::mem_fun(*this, &main_win::on_hint_ready));
 
 	update_menus();
 
@@ -88,6 +93,13 @@ main_win::main_win() : main_win_glade()
 
 main_win::~main_win()
 {
+	if (_hint_thread)
+	{
+		_hint_bot->abort_search();
+		_hint_thread->join();
+		delete _hint_bot;
+		delete _hint_board;
+	}
 	if (_server)
 		stop_server();
 	if (_client)
@@ -402,6 +414,7 @@ void main_win::update_menus()
 		add_computer_player->set_sensitive(_game_status == GameServer::WaitingForPlayers);
 		remove_computer_players->set_sensitive(_bots.size() > 0);
 		show_last_move->set_sensitive(true);
+		show_hint->set_sensitive(_hint_thread == NULL);
 		undo->set_sensitive(true);
 		redo->set_sensitive(true);
 	}
@@ -421,6 +434,7 @@ void main_win::update_menus()
 		add_computer_player->set_sensitive(false);
 		remove_computer_players->set_sensitive(false);
 		show_last_move->set_sensitive(false);
+		show_hint->set_sensitive(false);
 		undo->set_sensitive(false);
 		redo->set_sensitive(false);
 	}
@@ -469,6 +483,65 @@ void main_win::on_show_last_move_activate()
 }
 
 
+void main_win::on_show_hint_activate()
+{
+	if (!_client || !_client->get_board() || _hint_thread ||
+		_client->is_spectator() ||
+		_current_player != _client->get_my_player_number())
+			return;
+
+	Prefs prefs;
+	prefs.read();
+
+	_hint_bot = BotBase::new_bot_of_type(prefs.bot_type);
+	if (!_hint_bot)
+		return;
+
+	// The hint is worked out in its own thread, on a copy of the board,
+	// so the bot has to keep away from the main loop
+	_hint_bot->set_pump_events(false);
+	_hint_board = new GameBoard(*_client->get_board());
+	_hint_player = _current_player;
+
+	_hint_thread = Glib::Thread::create(sigc::mem_fun(*this,
+		&main_win::think_of_hint), true);
+	update_menus();
+}
+
+
+void main_win::think_of_hint()
+{
+	_hint_bot->analyze(_hint_board, _hint_player, 1, &_hint);
+	_hint_ready();
+}
+
+
+void main_win::on_hint_ready()
+{
+	_hint_thread->join();
+	_hint_thread = NULL;
+
+	// Don't show it if someone has moved since
+	if (_client && _client->get_board() && !_hint.empty() &&
+		_current_player == _hint_player &&
+		_client->get_board()->get_hash() == _hint_board->get_hash())
+	{
+		game_view->show_move(&_hint[0].move);
+		game_view->queue_draw();
+		util::delay_ms(1500);
+		game_view->hide_move();
+		game_view->queue_draw();
+	}
+
+	delete _hint_bot;
+	delete _hint_board;
+	_hint_bot = NULL;
+	_hint_board = NULL;
+
+	update_menus();
+}
+
+
 void main_win::on_add_computer_player_activate()
 {
 	if (_client)
@@ -21,6 +21,9 @@
 #  include "main_win_glade.hh"
 #  define _MAIN_WIN_HH
 
+#include <glibmm/thread.h>
+#include <glibmm/dispatcher.h>
+
 #include "about_win.hh"
 #include "help_win.hh"
 #include "new_game_win.hh"
@@ -77,6 +80,9 @@ class main_win : public main_win_glade
 		void on_paste_activate();
 		void on_delete_activate();
 		void on_show_last_move_activate();
+		void on_show_hint_activate();
+		void think_of_hint();
+		void on_hint_ready();
 
 		void add_join_hostname(Glib::ustring host);
 		void stop_server();
@@ -119,6 +125,13 @@ class main_win : public main_win_glade
 		MoveList		_last_move;
 		unsigned int	_finished_in_moves[6];
 
+		BotBase			*_hint_bot;
+		GameBoard		*_hint_board;
+		unsigned int	_hint_player;
+		std::vector<BotBase::MoveAnalysis>	_hint;
+		Glib::Thread	*_hint_thread;
+		Glib::Dispatcher	_hint_ready;
+
 		about_win		_about_win;
 		help_win		_help_win;
 		new_game_win	_new_game_win;
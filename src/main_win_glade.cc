@@ -87,6 +87,7 @@ main_win_glade::main_win_glade(
    Gtk::Image *image47 = Gtk::manage(new class Gtk::Image(Gtk::StockID("gtk-redo"), Gtk::IconSize(1)));
    redo = NULL;
    show_last_move = NULL;
+   show_hint = NULL;
    Gtk::MenuItem *separator5 = NULL;
    Gtk::ImageMenuItem *cut = NULL;
    Gtk::ImageMenuItem *copy = NULL;
@@ -199,6 +200,9 @@ main_win_glade::main_win_glade(
    edit_menu->items().push_back(Gtk::Menu_Helpers::MenuElem(_("S_how Last Move"), Gtk::GMM_GTKMM_22_24(Menu_Helpers::,)AccelKey(GDK_H, Gdk::CONTROL_MASK)));
    show_last_move = (Gtk::MenuItem *)&edit_menu->items().back();
 
+   edit_menu->items().push_back(Gtk::Menu_Helpers::MenuElem(_("Show H_int"), Gtk::GMM_GTKMM_22_24(Menu_Helpers::,)AccelKey(GDK_I, Gdk::CONTROL_MASK)));
+   show_hint = (Gtk::MenuItem *)&edit_menu->items().back();
+
    edit_menu->items().push_back(Gtk::Menu_Helpers::SeparatorElem());
    separator5 = (Gtk::MenuItem *)&edit_menu->items().back();
 
@@ -426,6 +430,7 @@ main_win_glade::main_win_glade(
    image47->show();
    redo->show();
    show_last_move->show();
+   show_hint->show();
    separator5->show();
    cut->show();
    copy->show();
@@ -493,6 +498,7 @@ main_win_glade::main_win_glade(
    undo->signal_activate().connect(sigc::mem_fun(this, &main_win_glade::on_undo_activate), false);
    redo->signal_activate().connect(sigc::mem_fun(this, &main_win_glade::on_redo_activate), false);
    show_last_move->signal_activate().connect(sigc::mem_fun(this, &main_win_glade::on_show_last_move_activate), false);
+   show_hint->signal_activate().connect(sigc::mem_fun(this, &main_win_glade::on_show_hint_activate), false);
    cut->signal_activate().connect(sigc::mem_fun(this, &main_win_glade::on_cut_activate), false);
    copy->signal_activate().connect(sigc::mem_fun(this, &main_win_glade::on_copy_activate), false);
    paste->signal_activate().connect(sigc::mem_fun(this, &main_win_glade::on_paste_activate), false);
@@ -57,6 +57,7 @@ protected:
         class Gtk::ImageMenuItem * undo;
         class Gtk::ImageMenuItem * redo;
         class Gtk::MenuItem * show_last_move;
+        class Gtk::MenuItem * show_hint;
         class Gtk::MenuItem * change_name;
         class Gtk::MenuItem * change_color;
         class Gtk::MenuItem * add_computer_player;
@@ -97,6 +98,7 @@ private:
         virtual void on_undo_activate() = 0;
         virtual void on_redo_activate() = 0;
         virtual void on_show_last_move_activate() = 0;
+        virtual void on_show_hint_activate() = 0;
         virtual void on_cut_activate() = 0;
         virtual void on_copy_activate() = 0;
         virtual void on_paste_activate() = 0;
@@ -0,0 +1,226 @@
+/*
+ *  Remembers each peg's moves during a bot's search, so only the pegs a
+ *  move could have affected need their moves found again.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include <glibmm/thread.h>
+
+#include "move_cache.hh"
+#include "game_hole.hh"
+
+
+guint64 MoveCache::LINES[GameBoard::SIZE][2][MoveCache::WORDS];
+bool MoveCache::_lines_ready = false;
+
+
+static inline void set_bit(guint64 *bits, unsigned int hole)
+{
+	bits[hole / 64] |= (guint64)1 << (hole % 64);
+}
+
+
+static inline bool get_bit(const guint64 *bits, unsigned int hole)
+{
+	return (bits[hole / 64] >> (hole % 64)) & 1;
+}
+
+
+MoveCache::MoveCache()
+{
+	// Rooms on different threads add bots at the same time
+	{
+		static Glib::Mutex mutex;
+		Glib::Mutex::Lock lock(mutex);
+
+		if (!_lines_ready)
+			_lines_ready = init_lines();
+	}
+
+	reset();
+}
+
+
+void MoveCache::reset()
+{
+	for (unsigned int s = 0; s < 60; s++)
+		_pegs[s].valid = false;
+
+	_holes.clear();
+	_undo.clear();
+	_marks.clear();
+}
+
+
+bool MoveCache::has_moves(unsigned int player, unsigned int peg) const
+{
+	return _pegs[(player - 1) * 10 + peg].valid;
+}
+
+
+unsigned int MoveCache::get_moves(unsigned int player, unsigned int peg,
+								  unsigned int *num_moves) const
+{
+	const PegMoves& moves = _pegs[(player - 1) * 10 + peg];
+
+	*num_moves = moves.num_moves;
+	return moves.first;
+}
+
+
+// Sets move to the move at posn, and moves posn on to the next one
+void MoveCache::get_move(unsigned int *posn, MoveList *move) const
+{
+	unsigned int length = _holes[*posn];
+
+	move->assign(_holes.begin() + *posn + 1,
+				 _holes.begin() + *posn + 1 + length);
+	*posn += length + 1;
+}
+
+
+void MoveCache::start_peg(unsigned int player, unsigned int peg,
+						  unsigned int hole)
+{
+	_filling = (player - 1) * 10 + peg;
+	save(_filling);
+
+	PegMoves& moves = _pegs[_filling];
+
+	moves.valid = false;
+	moves.first = _holes.size();
+	moves.num_moves = 0;
+	for (unsigned int w = 0; w < WORDS; w++)
+		moves.depends[w] = 0;
+
+	set_bit(moves.depends, hole);
+}
+
+
+void MoveCache::add_move(const MoveList& move)
+{
+	_holes.push_back(move.size());
+	_holes.insert(_holes.end(), move.begin(), move.end());
+	_pegs[_filling].num_moves++;
+}
+
+
+// The peg's moves from hole depend on the holes along its lines.  This
+// is a few more holes than GameBoard::find_valid_jump() really looks at,
+// but much quicker to work out.
+void MoveCache::add_lines(unsigned int hole, bool long_jumps)
+{
+	guint64 *depends = _pegs[_filling].depends;
+	const guint64 *lines = LINES[hole][long_jumps ? 1 : 0];
+
+	for (unsigned int w = 0; w < WORDS; w++)
+		depends[w] |= lines[w];
+}
+
+
+void MoveCache::finish_peg()
+{
+	_pegs[_filling].valid = true;
+}
+
+
+void MoveCache::make_move(unsigned int from, unsigned int to)
+{
+	Mark mark;
+	mark.undo = _undo.size();
+	mark.holes = _holes.size();
+	_marks.push_back(mark);
+
+	for (unsigned int s = 0; s < 60; s++)
+	{
+		PegMoves& moves = _pegs[s];
+
+		if (moves.valid && (get_bit(moves.depends, from) ||
+							get_bit(moves.depends, to)))
+		{
+			save(s);
+			moves.valid = false;
+		}
+	}
+}
+
+
+void MoveCache::unmake_move()
+{
+	if (_marks.empty())
+		return;
+
+	Mark& mark = _marks.back();
+
+	while (_undo.size() > mark.undo)
+	{
+		_pegs[_undo.back().slot] = _undo.back().moves;
+		_undo.pop_back();
+	}
+
+	_holes.resize(mark.holes);
+	_marks.pop_back();
+}
+
+
+// Remembers a slot before it changes, so unmaking the last move can put
+// it back.  Changes at the top of the search never need undoing.
+void MoveCache::save(unsigned int slot)
+{
+	if (_marks.empty())
+		return;
+
+	Undo undo;
+	undo.slot = slot;
+	undo.moves = _pegs[slot];
+	_undo.push_back(undo);
+}
+
+
+bool MoveCache::init_lines()
+{
+	// A long jump can cross up to 6 empty holes, a peg, and 6 more empty
+	// holes before landing
+	const unsigned int REACH[2] = {2, 14};
+
+	GameBoard board(2, false, false, false);
+
+	for (unsigned int h = 0; h < GameBoard::SIZE; h++)
+		for (unsigned int j = 0; j < 2; j++)
+		{
+			for (unsigned int w = 0; w < WORDS; w++)
+				LINES[h][j][w] = 0;
+
+			if (!board[h])
+				continue;
+
+			for (unsigned int dir = 0; dir < 6; dir++)
+			{
+				GameHole *hole = board[h];
+
+				for (unsigned int r = 0; r < REACH[j]; r++)
+				{
+					hole = hole->get_neighbor(dir);
+					if (!hole)
+						break;
+					set_bit(LINES[h][j], hole->get_id());
+				}
+			}
+		}
+
+	return true;
+}
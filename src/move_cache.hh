@@ -0,0 +1,106 @@
+/*
+ *  Remembers each peg's moves during a bot's search, so only the pegs a
+ *  move could have affected need their moves found again.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef INCL_MOVE_CACHE_HH
+#define INCL_MOVE_CACHE_HH
+
+#include <vector>
+
+#include "game_board.hh"
+
+
+// Each peg's moves are kept with the set of holes they depend on: the
+// peg's own hole and the holes along the lines it could step or jump
+// from.  Making a move forgets the moves of only those pegs that depend
+// on the holes it emptied or filled, and unmaking it puts back what was
+// there before, so the cache always matches the search board.
+class MoveCache
+{
+public:
+	MoveCache();
+
+	// Forgets everything, for a new search
+	void reset();
+
+	bool has_moves(unsigned int player, unsigned int peg) const;
+
+	// Returns where the peg's moves start, for get_move()
+	unsigned int get_moves(unsigned int player, unsigned int peg,
+						   unsigned int *num_moves) const;
+	void get_move(unsigned int *posn, MoveList *move) const;
+
+	// Filling in one peg's moves, found on the current board
+	void start_peg(unsigned int player, unsigned int peg, unsigned int hole);
+	void add_move(const MoveList& move);
+	void add_lines(unsigned int hole, bool long_jumps);
+	void finish_peg();
+
+	// Call after moving a peg on the search board, and before moving it
+	// back
+	void make_move(unsigned int from, unsigned int to);
+	void unmake_move();
+
+private:
+	const static unsigned int WORDS = (GameBoard::SIZE + 63) / 64;
+
+	class PegMoves
+	{
+	public:
+		bool			valid;
+		unsigned int	first;
+		unsigned int	num_moves;
+		guint64			depends[WORDS];
+	};
+
+	class Undo
+	{
+	public:
+		unsigned int	slot;
+		PegMoves		moves;
+	};
+
+	class Mark
+	{
+	public:
+		unsigned int	undo;
+		unsigned int	holes;
+	};
+
+	void save(unsigned int slot);
+
+	static bool init_lines();
+
+	// The holes within stepping or jumping distance of each hole along
+	// its six lines, with short jumps (0) and long jumps (1)
+	static guint64 LINES[GameBoard::SIZE][2][WORDS];
+	static bool _lines_ready;
+
+	// One slot for each of each player's pegs
+	PegMoves	_pegs[60];
+	unsigned int	_filling;
+
+	// The moves, each as its number of holes followed by the holes
+	std::vector<unsigned int>	_holes;
+
+	std::vector<Undo>	_undo;
+	std::vector<Mark>	_marks;
+};
+
+#endif   // #ifndef INCL_MOVE_CACHE_HH
@@ -0,0 +1,223 @@
+/*
+ *  A book of precomputed opening moves, keyed by position hash and game
+ *  variant, so that bots don't have to search the well-known first moves.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <glibmm.h>
+
+#include "opening_book.hh"
+#include "bot_base.hh"
+#include "board_symmetry.hh"
+#include "utility.hh"
+
+
+OpeningBook::OpeningBook()
+{
+}
+
+
+// The book is a text file with one move per line:
+//   <rules key> <position hash> <number of holes> <hole> <hole> ...
+// where positions and moves are in their canonical orientation.
+bool OpeningBook::load(const Glib::ustring& filename)
+{
+	Glib::RefPtr<Glib::IOChannel> pfile;
+
+	try
+	{
+		pfile = Glib::IOChannel::create_from_file(filename, "r");
+	}
+	catch (Glib::FileError)
+	{
+		return false;
+	}
+
+	Glib::ustring line;
+
+	while (pfile->read_line(line) == Glib::IO_STATUS_NORMAL)
+	{
+		if (line.empty() || line[0] == '#')
+			continue;
+
+		std::istringstream line_stream(line);
+		unsigned int rules, num_holes;
+		guint64 hash;
+		MoveList move;
+
+		line_stream >> rules >> hash >> num_holes;
+		for (unsigned int i = 0; i < num_holes && line_stream; i++)
+		{
+			unsigned int hole;
+			line_stream >> hole;
+			move.push_back(hole);
+		}
+
+		if (!line_stream || move.size() < 2)
+			continue;
+
+		std::vector<MoveList>& moves = _entries[Key(rules, hash)];
+		if (std::find(moves.begin(), moves.end(), move) == moves.end())
+			moves.push_back(move);
+	}
+
+	pfile->close();
+
+	return true;
+}
+
+
+bool OpeningBook::save(const Glib::ustring& filename) const
+{
+	Glib::RefPtr<Glib::IOChannel> pfile;
+
+	try
+	{
+		pfile = Glib::IOChannel::create_from_file(filename, "w");
+	}
+	catch (Glib::FileError)
+	{
+		std::cerr << "Can't write opening book to '"
+			<< filename << "'." << std::endl;
+		return false;
+	}
+
+	pfile->write("# cheech opening book\n");
+
+	for (std::map<Key, std::vector<MoveList> >::const_iterator e =
+		 _entries.begin(); e != _entries.end(); e++)
+	{
+		for (std::vector<MoveList>::const_iterator m = e->second.begin();
+			 m != e->second.end(); m++)
+		{
+			Glib::ustring line = util::to_str(e->first.first) + " " +
+				util::to_str(e->first.second) + " " +
+				util::to_str(m->size());
+
+			for (MoveList::const_iterator h = m->begin(); h != m->end(); h++)
+				line += " " + util::to_str(*h);
+
+			pfile->write(line + "\n");
+		}
+	}
+
+	pfile->close();
+
+	return true;
+}
+
+
+unsigned int OpeningBook::size() const
+{
+	return _entries.size();
+}
+
+
+bool OpeningBook::lookup(GameBoard *board, unsigned int player,
+						 std::vector<MoveList> *moves) const
+{
+	guint64 hash;
+	unsigned int sym = BoardSymmetry::canonicalize(*board, player, &hash);
+
+	std::map<Key, std::vector<MoveList> >::const_iterator e =
+		_entries.find(Key(board->get_rules_key(), hash));
+
+	if (e == _entries.end())
+		return false;
+
+	moves->clear();
+
+	// Book moves are stored for the canonical position, so map them back,
+	// and double check them in case of a hash collision
+	for (std::vector<MoveList>::const_iterator m = e->second.begin();
+		 m != e->second.end(); m++)
+	{
+		MoveList move = *m;
+		BoardSymmetry::map_move(BoardSymmetry::get_inverse(sym), &move);
+
+		if ((*board)[move.front()] &&
+			(*board)[move.front()]->get_current_player() == player &&
+			board->valid_move_list(move, true))
+				moves->push_back(move);
+	}
+
+	return !moves->empty();
+}
+
+
+void OpeningBook::add(GameBoard *board, unsigned int player,
+					  const std::vector<MoveList>& moves)
+{
+	guint64 hash;
+	unsigned int sym = BoardSymmetry::canonicalize(*board, player, &hash);
+
+	std::vector<MoveList>& entry =
+		_entries[Key(board->get_rules_key(), hash)];
+
+	for (std::vector<MoveList>::const_iterator m = moves.begin();
+		 m != moves.end(); m++)
+	{
+		MoveList move = *m;
+		BoardSymmetry::map_move(sym, &move);
+
+		if (std::find(entry.begin(), entry.end(), move) == entry.end())
+			entry.push_back(move);
+	}
+}
+
+
+void OpeningBook::generate(BotBase *bot, GameBoard *board,
+						   unsigned int num_plies, unsigned int num_games)
+{
+	Glib::Rand rand;
+
+	for (unsigned int game = 0; game < num_games; game++)
+	{
+		unsigned int player = 1;
+
+		board->reset_board();
+
+		for (unsigned int ply = 0; ply < num_plies; ply++)
+		{
+			std::vector<MoveList> best_moves;
+			long best_score = LONG_MIN;
+
+			// Positions reached by earlier games don't need searching again;
+			// picking randomly among their tied moves spreads the games out.
+			if (!lookup(board, player, &best_moves))
+			{
+				bot->think(board, player, &best_moves, &best_score);
+				if (best_moves.empty())
+					break;
+				add(board, player, best_moves);
+			}
+
+			MoveList& move =
+				best_moves[rand.get_int_range(0, best_moves.size())];
+			board->move_peg(move.front(), move.back());
+
+			if (board->game_finished())
+				break;
+			player = board->get_next_player(player);
+		}
+	}
+
+	board->reset_board();
+}
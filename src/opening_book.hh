@@ -0,0 +1,61 @@
+/*
+ *  A book of precomputed opening moves, keyed by position hash and game
+ *  variant, so that bots don't have to search the well-known first moves.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef INCL_OPENING_BOOK_HH
+#define INCL_OPENING_BOOK_HH
+
+#include <map>
+#include <vector>
+#include <utility>
+#include <glibmm/ustring.h>
+
+#include "game_board.hh"
+
+class BotBase;
+
+
+class OpeningBook
+{
+public:
+	OpeningBook();
+
+	bool load(const Glib::ustring& filename);
+	bool save(const Glib::ustring& filename) const;
+
+	unsigned int size() const;
+
+	// Symmetric positions share one entry (see BoardSymmetry)
+	bool lookup(GameBoard *board, unsigned int player,
+				std::vector<MoveList> *moves) const;
+	void add(GameBoard *board, unsigned int player,
+			 const std::vector<MoveList>& moves);
+
+	// Plays num_games games of self-play with bot from the starting
+	// position of board's variant, recording the first num_plies moves
+	void generate(BotBase *bot, GameBoard *board, unsigned int num_plies,
+				  unsigned int num_games);
+
+private:
+	typedef std::pair<unsigned int, guint64> Key;
+
+	std::map<Key, std::vector<MoveList> >	_entries;
+};
+
+#endif   // #ifndef INCL_OPENING_BOOK_HH
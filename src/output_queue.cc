@@ -0,0 +1,121 @@
+/*
+ *  Bytes waiting to be sent on a socket, kept as a list of buffers that
+ *  can be shared with other sockets' queues.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include "output_queue.hh"
+
+
+OutputQueue::OutputQueue()
+	:_size(0)
+{
+}
+
+
+unsigned long OutputQueue::size() const
+{
+	return _size;
+}
+
+
+bool OutputQueue::empty() const
+{
+	return (_size == 0);
+}
+
+
+void OutputQueue::clear()
+{
+	_chunks.clear();
+	_tail.reset();
+	_size = 0;
+}
+
+
+void OutputQueue::append(const char *data, unsigned long length)
+{
+	if (!length)
+		return;
+
+	if (!_tail)
+	{
+		Chunk chunk;
+		_tail = std::make_shared<std::string>();
+		chunk.data = _tail;
+		chunk.start = 0;
+		_chunks.push_back(chunk);
+	}
+
+	_tail->append(data, length);
+	_size += length;
+}
+
+
+void OutputQueue::append(const SharedData& data)
+{
+	if (!data || data->empty())
+		return;
+
+	Chunk chunk;
+	chunk.data = data;
+	chunk.start = 0;
+	_chunks.push_back(chunk);
+
+	_tail.reset();
+	_size += data->length();
+}
+
+
+unsigned int OutputQueue::get_parts(const char **parts, unsigned long *lengths,
+									unsigned int max_parts) const
+{
+	unsigned int num_parts = 0;
+
+	for (std::deque<Chunk>::const_iterator c = _chunks.begin();
+		 c != _chunks.end() && num_parts < max_parts; c++, num_parts++)
+	{
+		parts[num_parts] = c->data->data() + c->start;
+		lengths[num_parts] = c->data->length() - c->start;
+	}
+
+	return num_parts;
+}
+
+
+void OutputQueue::consume(unsigned long length)
+{
+	_size -= length;
+
+	while (length)
+	{
+		Chunk& chunk = _chunks.front();
+		unsigned long left = chunk.data->length() - chunk.start;
+
+		if (length < left)
+		{
+			chunk.start += length;
+			return;
+		}
+
+		length -= left;
+		_chunks.pop_front();
+	}
+
+	if (_chunks.empty())
+		_tail.reset();
+}
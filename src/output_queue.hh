@@ -0,0 +1,72 @@
+/*
+ *  Bytes waiting to be sent on a socket, kept as a list of buffers that
+ *  can be shared with other sockets' queues.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef INCL_OUTPUT_QUEUE_HH
+#define INCL_OUTPUT_QUEUE_HH
+
+#include <deque>
+#include <memory>
+#include <string>
+
+
+// A message encoded once, which any number of queues can hold on to
+// without copying it.  It's freed once the last of them has sent it.
+typedef std::shared_ptr<const std::string> SharedData;
+
+
+// Ordinary writes are copied into a buffer of the queue's own, which
+// keeps growing until something shared is queued after it.  The pieces
+// come out in order with get_parts(), ready for writev().
+class OutputQueue
+{
+public:
+	OutputQueue();
+
+	unsigned long size() const;
+	bool empty() const;
+	void clear();
+
+	void append(const char *data, unsigned long length);
+	void append(const SharedData& data);
+
+	// Fills in up to max_parts of the first pieces waiting, returning how
+	// many there were
+	unsigned int get_parts(const char **parts, unsigned long *lengths,
+						   unsigned int max_parts) const;
+
+	// Forgets the first length bytes, once they've been sent
+	void consume(unsigned long length);
+
+private:
+	class Chunk
+	{
+	public:
+		SharedData		data;
+		// How much of data has been sent already
+		unsigned long	start;
+	};
+
+	std::deque<Chunk>				_chunks;
+	// The last chunk, when it's our own to add to
+	std::shared_ptr<std::string>	_tail;
+	unsigned long					_size;
+};
+
+#endif   // #ifndef INCL_OUTPUT_QUEUE_HH
@@ -0,0 +1,323 @@
+/*
+ *  The binary form of the game protocol, version 10, in which each
+ *  message is a length-prefixed frame.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include <map>
+#include <cstring>
+
+#include "proto_codec.hh"
+
+
+// The opcodes are places in this table, so new commands only ever go on
+// the end
+static const char *commands[] = {
+	NULL,
+	"HELLO",
+	"PROTO_BINARY",
+	"CLIENT_MESSAGE",
+	"CLIENT_HEARTBEAT",
+	"SERVER_HEARTBEAT",
+	"SERVER_SYNC",
+	"SET_PLAYER_NUMBER",
+	"PLAYER_ADD",
+	"SPECTATOR_ADD",
+	"PLAYER_REMOVE",
+	"PLAYER_NAME",
+	"PLAYER_COLOR",
+	"PLAYER_CHAT",
+	"PLAYER_FINISH",
+	"PLAYER_CHOOSE_NAME",
+	"PLAYER_CHOOSE_COLOR",
+	"GAME_SETUP",
+	"GAME_BOARD",
+	"GAME_TURN",
+	"GAME_SHOWMOVE",
+	"GAME_HIDEMOVE",
+	"GAME_MAKEMOVE",
+	"GAME_UNDOMOVE",
+	"GAME_REDOMOVE",
+	"GAME_RESTART",
+	"GAME_ROTATE",
+	"GAME_SHUFFLE",
+	"GAME_RECONFIG",
+	"GAME_ADDBOT",
+	"GAME_REMOVEBOTS",
+	"ROOM_LIST",
+	"ROOM_INFO",
+	"ROOM_LIST_END",
+	"ROOM_CREATE",
+	"ROOM_CREATED",
+	"ROOM_JOIN",
+	"ROOM_JOINED",
+	"ROOM_ERROR",
+	"GAME_VERSION",
+	"SESSION",
+	"RESUME",
+	"RESUMED",
+	"RESUME_FAILED"
+};
+
+static const unsigned int NUM_COMMANDS = sizeof(commands) / sizeof(commands[0]);
+
+
+ProtoCodec::Message::Message()
+	:opcode(0)
+{
+}
+
+
+void ProtoCodec::Message::clear()
+{
+	opcode = 0;
+	command.clear();
+	numbers.clear();
+	rest.clear();
+}
+
+
+std::string ProtoCodec::Message::to_line() const
+{
+	std::string line = command;
+	char digits[10];
+
+	for (unsigned int n = 0; n < numbers.size(); n++)
+	{
+		unsigned int number = numbers[n];
+		unsigned int d = sizeof(digits);
+
+		do
+		{
+			digits[--d] = '0' + number % 10;
+			number /= 10;
+		} while (number);
+
+		line += ' ';
+		line.append(digits + d, sizeof(digits) - d);
+	}
+
+	return line + rest;
+}
+
+
+void ProtoCodec::parse_line(const char *line, unsigned int length,
+							Message *message)
+{
+	const char *end = line + length;
+	const char *posn = (const char*)memchr(line, ' ', length);
+	unsigned int number;
+
+	if (!posn)
+		posn = end;
+
+	message->command.assign(line, posn - line);
+	message->opcode = get_opcode(message->command);
+	message->numbers.clear();
+
+	// Takes numbers while they're each a whole argument
+	while (posn < end && message->numbers.size() < MAX_NUMBERS)
+	{
+		const char *start = posn + 1;
+		const char *next = (const char*)memchr(start, ' ', end - start);
+
+		if (!next)
+			next = end;
+		if (!parse_number(start, next - start, &number))
+			break;
+
+		message->numbers.push_back(number);
+		posn = next;
+	}
+
+	message->rest.assign(posn, end - posn);
+}
+
+
+void ProtoCodec::encode(const Message& message, std::string *frames)
+{
+	std::string::size_type start = frames->length();
+
+	frames->append(HEADER_SIZE, '\0');
+	*frames += (char)message.opcode;
+	*frames += (char)message.numbers.size();
+
+	for (unsigned int n = 0; n < message.numbers.size(); n++)
+	{
+		unsigned int number = message.numbers[n];
+
+		while (number >= 0x80)
+		{
+			*frames += (char)(0x80 | (number & 0x7f));
+			number >>= 7;
+		}
+		*frames += (char)number;
+	}
+
+	if (!message.opcode)
+		*frames += message.command;
+
+	std::string::size_type length = frames->length() - start - HEADER_SIZE;
+	std::string::size_type rest = message.rest.length();
+
+	if (length + rest > MAX_BODY)
+		rest = (length < MAX_BODY) ? MAX_BODY - length : 0;
+	frames->append(message.rest, 0, rest);
+	length += rest;
+
+	(*frames)[start] = (char)(length >> 8);
+	(*frames)[start + 1] = (char)(length & 0xff);
+}
+
+
+bool ProtoCodec::decode(const char *body, unsigned int length,
+						Message *message)
+{
+	const unsigned char *posn = (const unsigned char*)body;
+	const unsigned char *end = posn + length;
+
+	if (length < 2 || *posn >= NUM_COMMANDS)
+		return false;
+
+	message->opcode = *posn++;
+	unsigned int count = *posn++;
+
+	message->numbers.resize(count);
+	for (unsigned int n = 0; n < count; n++)
+	{
+		unsigned int number = 0;
+		unsigned int shift = 0;
+
+		do
+		{
+			if (posn == end || shift > 28)
+				return false;
+			number |= (unsigned int)(*posn & 0x7f) << shift;
+			shift += 7;
+		} while (*posn++ & 0x80);
+
+		message->numbers[n] = number;
+	}
+
+	const char *text = (const char*)posn;
+	const char *text_end = (const char*)end;
+
+	if (message->opcode)
+		message->command = commands[message->opcode];
+	else
+	{
+		const char *space = (const char*)memchr(text, ' ', text_end - text);
+		if (!space)
+			space = text_end;
+		message->command.assign(text, space - text);
+		text = space;
+	}
+
+	message->rest.assign(text, text_end - text);
+	return true;
+}
+
+
+unsigned int ProtoCodec::get_body_length(const char *header)
+{
+	return ((unsigned char)header[0] << 8) | (unsigned char)header[1];
+}
+
+
+void ProtoCodec::encode_line(const char *line, unsigned int length,
+							 std::string *frames)
+{
+	Message message;
+
+	parse_line(line, length, &message);
+	encode(message, frames);
+}
+
+
+bool ProtoCodec::decode_line(const char *body, unsigned int length,
+							 std::string *line)
+{
+	Message message;
+
+	if (!decode(body, length, &message))
+		return false;
+
+	*line = message.to_line();
+	return true;
+}
+
+
+static std::map<std::string, unsigned int> make_opcodes()
+{
+	std::map<std::string, unsigned int> opcodes;
+
+	for (unsigned int c = 1; c < NUM_COMMANDS; c++)
+		opcodes[commands[c]] = c;
+
+	return opcodes;
+}
+
+
+unsigned int ProtoCodec::get_opcode(const std::string& command)
+{
+	// Filled in just the once, whichever thread gets here first
+	static const std::map<std::string, unsigned int> opcodes = make_opcodes();
+
+	std::map<std::string, unsigned int>::const_iterator opcode =
+		opcodes.find(command);
+
+	return (opcode != opcodes.end()) ? opcode->second : 0;
+}
+
+
+const char* ProtoCodec::get_command(unsigned int opcode)
+{
+	return (opcode < NUM_COMMANDS) ? commands[opcode] : NULL;
+}
+
+
+bool ProtoCodec::session_command(const StrView& command)
+{
+	return command == StrView("SESSION") || command == StrView("RESUMED") ||
+		command == StrView("RESUME_FAILED") ||
+		command == StrView("PROTO_BINARY") ||
+		command == StrView("SERVER_HEARTBEAT") ||
+		command == StrView("CLIENT_HEARTBEAT");
+}
+
+
+// Only numbers that print back the same, so the line comes back as it was
+bool ProtoCodec::parse_number(const char *text, unsigned int length,
+							  unsigned int *number)
+{
+	if (length == 0 || length > 10 || (text[0] == '0' && length > 1))
+		return false;
+
+	unsigned long long value = 0;
+	for (unsigned int c = 0; c < length; c++)
+	{
+		if (text[c] < '0' || text[c] > '9')
+			return false;
+		value = value * 10 + (text[c] - '0');
+	}
+
+	if (value > 0xffffffffULL)
+		return false;
+
+	*number = (unsigned int)value;
+	return true;
+}
@@ -0,0 +1,106 @@
+/*
+ *  The binary form of the game protocol, version 10, in which each
+ *  message is a length-prefixed frame.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef INCL_PROTO_CODEC_HH
+#define INCL_PROTO_CODEC_HH
+
+#include <string>
+#include <vector>
+
+#include "str_view.hh"
+
+#define PROTO_BINARY_VERSION "10"
+
+
+// A frame carries exactly what one line of the text protocol does:
+//
+//   length   2 bytes, big-endian, counting the bytes after it
+//   opcode   1 byte, the command's place in the table, or 0 for one
+//            that isn't there, whose name then starts the rest
+//   count    1 byte, how many numbers follow
+//   numbers  count unsigned numbers, 7 bits to a byte, low bits first,
+//            with the top bit set on all but the last byte, so holes
+//            and players take a byte each
+//   rest     the rest of the line, after the numbers, as it was
+//
+// The numbers are the arguments at the start of the line that are plain
+// unsigned numbers, so "PLAYER_ADD 2 5 Fred" is PLAYER_ADD, 2 and 5, and
+// " Fred".  Any line can be framed and turned back into just the same
+// line, so both ends can go on handling lines while the bytes between
+// them are frames.
+class ProtoCodec
+{
+public:
+	const static unsigned int HEADER_SIZE = 2;
+	const static unsigned int MAX_BODY = 65535;
+	const static unsigned int MAX_NUMBERS = 255;
+
+	class Message
+	{
+	public:
+		Message();
+		void clear();
+
+		// Back into a line of the text protocol, without its newline
+		std::string to_line() const;
+
+		unsigned int				opcode;
+		std::string					command;
+		std::vector<unsigned int>	numbers;
+		std::string					rest;
+	};
+
+	// Splits a line of the text protocol, without its newline, into a
+	// message
+	static void parse_line(const char *line, unsigned int length,
+						   Message *message);
+
+	// Appends message to frames, cutting the rest short if it wouldn't
+	// fit in a frame
+	static void encode(const Message& message, std::string *frames);
+
+	// Reads a frame's body, the bytes after its length, returning false
+	// if it isn't a proper one
+	static bool decode(const char *body, unsigned int length,
+					   Message *message);
+
+	// A frame's length, from its first HEADER_SIZE bytes
+	static unsigned int get_body_length(const char *header);
+
+	// Lines in and out of frames, for sockets
+	static void encode_line(const char *line, unsigned int length,
+							std::string *frames);
+	static bool decode_line(const char *body, unsigned int length,
+							std::string *line);
+
+	static unsigned int get_opcode(const std::string& command);
+	// NULL for opcodes that aren't in the table
+	static const char* get_command(unsigned int opcode);
+
+	// Lines of these commands are about a connection rather than the
+	// game, so neither end counts them in a session
+	static bool session_command(const StrView& command);
+
+private:
+	static bool parse_number(const char *text, unsigned int length,
+							 unsigned int *number);
+};
+
+#endif   // #ifndef INCL_PROTO_CODEC_HH
@@ -0,0 +1,164 @@
+/*
+ *  A byte queue kept in a ring that grows as needed, for sockets' input
+ *  and output.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include <cstring>
+#include <algorithm>
+
+#include "ring_buffer.hh"
+
+
+RingBuffer::RingBuffer(unsigned int capacity)
+	:_data(NULL),
+	 _capacity(1),
+	 _head(0),
+	 _size(0)
+{
+	while (_capacity < capacity)
+		_capacity *= 2;
+	_data = new char[_capacity];
+}
+
+
+RingBuffer::~RingBuffer()
+{
+	delete[] _data;
+}
+
+
+unsigned int RingBuffer::size() const
+{
+	return _size;
+}
+
+
+bool RingBuffer::empty() const
+{
+	return (_size == 0);
+}
+
+
+void RingBuffer::clear()
+{
+	_head = 0;
+	_size = 0;
+}
+
+
+void RingBuffer::append(const char *data, unsigned int length)
+{
+	while (length)
+	{
+		unsigned int space;
+		char *back = reserve(&space);
+		unsigned int count = std::min(space, length);
+
+		memcpy(back, data, count);
+		commit(count);
+		data += count;
+		length -= count;
+	}
+}
+
+
+char* RingBuffer::reserve(unsigned int *length)
+{
+	if (_size == _capacity)
+		grow(_capacity * 2);
+
+	unsigned int back = (_head + _size) & (_capacity - 1);
+
+	*length = std::min(_capacity - _size, _capacity - back);
+	return _data + back;
+}
+
+
+void RingBuffer::commit(unsigned int length)
+{
+	_size += length;
+}
+
+
+const char* RingBuffer::peek(unsigned int *length, unsigned int offset) const
+{
+	unsigned int start = (_head + offset) & (_capacity - 1);
+
+	*length = std::min(_size - offset, _capacity - start);
+	return _data + start;
+}
+
+
+void RingBuffer::consume(unsigned int length)
+{
+	_size -= length;
+	_head = _size ? (_head + length) & (_capacity - 1) : 0;
+}
+
+
+char RingBuffer::at(unsigned int offset) const
+{
+	return _data[(_head + offset) & (_capacity - 1)];
+}
+
+
+int RingBuffer::find_first_of(const char *chars, unsigned int num_chars,
+							  unsigned int offset) const
+{
+	for (unsigned int i = offset; i < _size; i++)
+		if (memchr(chars, at(i), num_chars))
+			return i;
+
+	return -1;
+}
+
+
+std::string RingBuffer::take(unsigned int length)
+{
+	std::string data;
+	data.reserve(length);
+
+	while (length)
+	{
+		unsigned int count;
+		const char *front = peek(&count);
+
+		count = std::min(count, length);
+		data.append(front, count);
+		consume(count);
+		length -= count;
+	}
+
+	return data;
+}
+
+
+// Straightens the data out at the start of the new memory
+void RingBuffer::grow(unsigned int capacity)
+{
+	char *data = new char[capacity];
+	unsigned int first = std::min(_size, _capacity - _head);
+
+	memcpy(data, _data + _head, first);
+	memcpy(data + first, _data, _size - first);
+
+	delete[] _data;
+	_data = data;
+	_capacity = capacity;
+	_head = 0;
+}
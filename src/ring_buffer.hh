@@ -0,0 +1,76 @@
+/*
+ *  A byte queue kept in a ring that grows as needed, for sockets' input
+ *  and output.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef INCL_RING_BUFFER_HH
+#define INCL_RING_BUFFER_HH
+
+#include <string>
+
+
+// Bytes go in at the back and come out at the front.  The capacity is
+// always a power of two, and only doubles when the ring is full, so a
+// connection that keeps up never copies its data more than once.  Reads
+// and writes can go straight to and from the ring's memory with
+// reserve()/commit() and peek()/consume(), which may take two goes when
+// the data wraps around the end.
+class RingBuffer
+{
+public:
+	RingBuffer(unsigned int capacity = 4096);
+	~RingBuffer();
+
+	unsigned int size() const;
+	bool empty() const;
+	void clear();
+
+	void append(const char *data, unsigned int length);
+
+	// Space after the back to fill, with its length; grows the ring if
+	// it's full.  Call commit() with how much was filled.
+	char* reserve(unsigned int *length);
+	void commit(unsigned int length);
+
+	// The bytes from offset on that are together in memory, with their
+	// length.  Call consume() with how many were used.
+	const char* peek(unsigned int *length, unsigned int offset = 0) const;
+	void consume(unsigned int length);
+
+	char at(unsigned int offset) const;
+
+	// Offset of the first byte from offset on that's one of chars, or -1
+	int find_first_of(const char *chars, unsigned int num_chars,
+					  unsigned int offset = 0) const;
+
+	// Removes length bytes from the front, returning them
+	std::string take(unsigned int length);
+
+private:
+	RingBuffer(const RingBuffer& ring);
+	RingBuffer& operator=(const RingBuffer& ring);
+
+	void grow(unsigned int capacity);
+
+	char			*_data;
+	unsigned int	_capacity;
+	unsigned int	_head;
+	unsigned int	_size;
+};
+
+#endif   // #ifndef INCL_RING_BUFFER_HH
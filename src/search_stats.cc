@@ -0,0 +1,266 @@
+/*
+ *  Timings and counts from bots' searches, with a histogram of how long
+ *  they took to think.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include <cmath>
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <signal.h>
+#include <sigc++/bind.h>
+
+#include "search_stats.hh"
+
+
+static volatile sig_atomic_t stats_signalled = 0;
+static volatile sig_atomic_t quit_signalled = 0;
+
+
+SearchRecord::SearchRecord()
+	:depth(0),
+	 nodes(0),
+	 seconds(0),
+	 cache_hits(0),
+	 cache_misses(0),
+	 passes(0),
+	 best_move_changes(0)
+{
+}
+
+
+double SearchRecord::get_nodes_per_sec() const
+{
+	return (seconds > 0) ? nodes / seconds : 0;
+}
+
+
+double SearchRecord::get_cache_hit_rate() const
+{
+	unsigned long lookups = cache_hits + cache_misses;
+
+	return lookups ? (double)cache_hits / lookups : 0;
+}
+
+
+// The share of passes after the first that kept the last pass's best move
+double SearchRecord::get_stability() const
+{
+	if (passes < 2)
+		return 1;
+
+	return 1 - (double)best_move_changes / (passes - 1);
+}
+
+
+Glib::ustring SearchRecord::to_str() const
+{
+	std::ostringstream stream;
+
+	stream << std::fixed << std::setprecision(1)
+		<< "depth " << depth << ", " << nodes << " nodes, "
+		<< (unsigned long)get_nodes_per_sec() << " nodes/sec, "
+		<< 100 * get_cache_hit_rate() << "% cached, "
+		<< 1000 * seconds << " ms, "
+		<< 100 * get_stability() << "% stable";
+
+	return stream.str();
+}
+
+
+SearchStats::SearchStats()
+	:_log(false)
+{
+	clear();
+}
+
+
+void SearchStats::add(const SearchRecord& record)
+{
+	Glib::Mutex::Lock lock(_mutex);
+
+	_num_searches++;
+	_total_depth += record.depth;
+	_total_nodes += record.nodes;
+	_total_seconds += record.seconds;
+	if (record.seconds > _max_seconds)
+		_max_seconds = record.seconds;
+	_cache_hits += record.cache_hits;
+	_cache_misses += record.cache_misses;
+	if (record.passes > 1)
+		_later_passes += record.passes - 1;
+	_best_move_changes += record.best_move_changes;
+
+	unsigned int b;
+	for (b = 0; b < BUCKETS - 1 && record.seconds > get_bucket_limit(b); b++);
+	_buckets[b]++;
+
+	if (_log)
+		std::cout << "Search: " << record.to_str() << std::endl;
+}
+
+
+void SearchStats::clear()
+{
+	Glib::Mutex::Lock lock(_mutex);
+
+	_num_searches = 0;
+	_total_depth = 0;
+	_total_nodes = 0;
+	_total_seconds = 0;
+	_max_seconds = 0;
+	_cache_hits = 0;
+	_cache_misses = 0;
+	_later_passes = 0;
+	_best_move_changes = 0;
+
+	for (unsigned int b = 0; b < BUCKETS; b++)
+		_buckets[b] = 0;
+}
+
+
+void SearchStats::set_log(bool log)
+{
+	_log = log;
+}
+
+
+unsigned long SearchStats::get_num_searches()
+{
+	Glib::Mutex::Lock lock(_mutex);
+	return _num_searches;
+}
+
+
+double SearchStats::get_percentile(double fraction)
+{
+	Glib::Mutex::Lock lock(_mutex);
+	return find_percentile(fraction);
+}
+
+
+void SearchStats::print(std::ostream& out)
+{
+	Glib::Mutex::Lock lock(_mutex);
+
+	if (!_num_searches)
+	{
+		out << "No searches." << std::endl;
+		return;
+	}
+
+	unsigned long lookups = _cache_hits + _cache_misses;
+	std::ios::fmtflags flags = out.flags();
+	std::streamsize precision = out.precision();
+
+	out << std::fixed << std::setprecision(1)
+		<< _num_searches << " searches, mean depth "
+		<< (double)_total_depth / _num_searches << ", "
+		<< (unsigned long)(_total_seconds ? _total_nodes / _total_seconds : 0)
+		<< " nodes/sec, "
+		<< (lookups ? 100.0 * _cache_hits / lookups : 0) << "% cached, "
+		<< (_later_passes ?
+			100.0 - 100.0 * _best_move_changes / _later_passes : 100.0)
+		<< "% stable" << std::endl;
+
+	out << "Think time: mean " << 1000 * _total_seconds / _num_searches
+		<< " ms, p50 " << 1000 * find_percentile(0.50)
+		<< " ms, p95 " << 1000 * find_percentile(0.95)
+		<< " ms, p99 " << 1000 * find_percentile(0.99)
+		<< " ms, max " << 1000 * _max_seconds << " ms" << std::endl;
+
+	unsigned long most = 0;
+	for (unsigned int b = 0; b < BUCKETS; b++)
+		if (_buckets[b] > most)
+			most = _buckets[b];
+
+	for (unsigned int b = 0; b < BUCKETS; b++)
+		if (_buckets[b])
+			out << "  <= " << std::setw(9) << 1000 * get_bucket_limit(b)
+				<< " ms " << std::setw(8) << _buckets[b] << " "
+				<< std::string((40 * _buckets[b] + most - 1) / most, '#')
+				<< std::endl;
+
+	out.flags(flags);
+	out.precision(precision);
+}
+
+
+double SearchStats::get_bucket_limit(unsigned int bucket)
+{
+	return 0.0001 * pow(1.25, (double)bucket);
+}
+
+
+// Called with the lock held
+double SearchStats::find_percentile(double fraction) const
+{
+	unsigned long wanted = (unsigned long)ceil(fraction * _num_searches);
+	unsigned long count = 0;
+
+	for (unsigned int b = 0; b < BUCKETS; b++)
+	{
+		count += _buckets[b];
+		if (count >= wanted && count)
+			return std::min(get_bucket_limit(b), _max_seconds);
+	}
+
+	return _max_seconds;
+}
+
+
+static void on_signal(int signal)
+{
+#ifndef WIN32
+	if (signal == SIGUSR1)
+	{
+		stats_signalled = 1;
+		return;
+	}
+#endif
+	quit_signalled = 1;
+}
+
+
+static bool check_signals(Glib::RefPtr<Glib::MainLoop> loop,
+						  sigc::slot<void, std::ostream&> print)
+{
+	if (stats_signalled)
+	{
+		stats_signalled = 0;
+		print(std::cout);
+	}
+
+	if (quit_signalled)
+		loop->quit();
+
+	return true;
+}
+
+
+void watch_stats_signals(Glib::RefPtr<Glib::MainLoop> loop,
+						 const sigc::slot<void, std::ostream&>& print)
+{
+	Glib::signal_timeout().connect(sigc::bind(
+		sigc::ptr_fun(check_signals), loop, print), 250);
+#ifndef WIN32
+	signal(SIGUSR1, on_signal);
+#endif
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+}
@@ -0,0 +1,108 @@
+/*
+ *  Timings and counts from bots' searches, with a histogram of how long
+ *  they took to think.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef INCL_SEARCH_STATS_HH
+#define INCL_SEARCH_STATS_HH
+
+#include <iostream>
+#include <sigc++/sigc++.h>
+#include <glibmm/ustring.h>
+#include <glibmm/thread.h>
+#include <glibmm/main.h>
+
+
+// What one call of BotBase::think() did.  The bots have no transposition
+// table, so the hit rate is of pegs whose moves came out of the MoveCache.
+class SearchRecord
+{
+public:
+	SearchRecord();
+
+	unsigned int	depth;
+	unsigned long	nodes;
+	double			seconds;
+	unsigned long	cache_hits;
+	unsigned long	cache_misses;
+
+	// Passes of iterative deepening completed, and how many of them
+	// changed their mind about the best move
+	unsigned int	passes;
+	unsigned int	best_move_changes;
+
+	double get_nodes_per_sec() const;
+	double get_cache_hit_rate() const;
+	double get_stability() const;
+
+	Glib::ustring to_str() const;
+};
+
+
+// Totals over many searches.  Think times go in buckets 25% wider than
+// the last, from 0.1ms up to about two minutes, so percentiles are good
+// to within a bucket however long a bot fleet runs.  Bots searching in
+// other threads can share one.
+class SearchStats
+{
+public:
+	SearchStats();
+
+	void add(const SearchRecord& record);
+	void clear();
+
+	// Writes each search to std::cout as it's added
+	void set_log(bool log);
+
+	unsigned long get_num_searches();
+
+	// The think time, in seconds, within which fraction of the searches
+	// finished
+	double get_percentile(double fraction);
+
+	void print(std::ostream& out);
+
+private:
+	const static unsigned int BUCKETS = 64;
+
+	static double get_bucket_limit(unsigned int bucket);
+	double find_percentile(double fraction) const;
+
+	Glib::Mutex		_mutex;
+	bool			_log;
+
+	unsigned long	_num_searches;
+	unsigned long	_total_depth;
+	unsigned long	_total_nodes;
+	double			_total_seconds;
+	double			_max_seconds;
+	unsigned long	_cache_hits;
+	unsigned long	_cache_misses;
+	unsigned long	_later_passes;
+	unsigned long	_best_move_changes;
+	unsigned long	_buckets[BUCKETS];
+};
+
+
+// For the bot programs: SIGUSR1 has print write the statistics to
+// std::cout, and SIGINT or SIGTERM quits loop.  The handler only notes
+// the signal, which loop picks up every quarter of a second.
+void watch_stats_signals(Glib::RefPtr<Glib::MainLoop> loop,
+						 const sigc::slot<void, std::ostream&>& print);
+
+#endif   // #ifndef INCL_SEARCH_STATS_HH
@@ -0,0 +1,320 @@
+/*
+ *  Plays bots against themselves in several threads at once, writing the
+ *  positions reached to a file of training records.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include <iostream>
+#include <climits>
+
+#include "self_play.hh"
+#include "bot_base.hh"
+
+
+SelfPlay::SelfPlay(const Glib::ustring& bot_type, unsigned int num_players,
+				   bool long_jumps, bool hop_others, bool stop_others)
+	:_bot_type(bot_type),
+	 _num_players(num_players),
+	 _long_jumps(long_jumps),
+	 _hop_others(hop_others),
+	 _stop_others(stop_others),
+	 _node_limit(0),
+	 _linear_eval(NULL),
+	 _random_plies(4),
+	 _max_plies(1000),
+	 _offset(0),
+	 _games_left(0),
+	 _num_games(0),
+	 _num_records(0),
+	 _write_failed(false)
+{
+}
+
+
+void SelfPlay::set_node_limit(unsigned long nodes)
+{
+	_node_limit = nodes;
+}
+
+
+void SelfPlay::set_weights(const EvalWeights& weights)
+{
+	_weights = weights;
+}
+
+
+// The bots' linear evaluation is shared among all the threads
+void SelfPlay::set_linear_eval(const LinearEval *eval)
+{
+	_linear_eval = eval;
+}
+
+
+// Playing the first few moves of each game at random keeps the games
+// from all being the same
+void SelfPlay::set_random_plies(unsigned int plies)
+{
+	_random_plies = plies;
+}
+
+
+// Stops games that go on this long without being finished
+void SelfPlay::set_max_plies(unsigned int plies)
+{
+	_max_plies = plies;
+}
+
+
+unsigned long SelfPlay::get_num_records() const
+{
+	return _num_records;
+}
+
+
+unsigned int SelfPlay::get_num_games() const
+{
+	return _num_games;
+}
+
+
+bool SelfPlay::run(const Glib::ustring& filename, unsigned int num_games,
+				   unsigned int num_jobs)
+{
+	_data.open(filename.c_str(), std::ios::out | std::ios::binary);
+	_index.open((filename + ".idx").c_str(), std::ios::out);
+
+	if (!_data || !_index)
+	{
+		std::cerr << "Can't write training data to '"
+			<< filename << "'." << std::endl;
+		return false;
+	}
+
+	unsigned char header[HEADER_SIZE] = {'C', 'H', 'E', 'E', 'C', 'H', 'T', 'D',
+		FORMAT_VERSION, 0, 0, 0, RECORD_SIZE, 0, 0, 0};
+	_data.write((const char *)header, HEADER_SIZE);
+	_index << "# cheech training data chunks: offset records games"
+		<< std::endl;
+
+	_offset = HEADER_SIZE;
+	_games_left = num_games;
+	_num_games = 0;
+	_num_records = 0;
+	_write_failed = false;
+
+	// Bots are made here rather than in their threads, since they set up
+	// (unused) network connections
+	std::vector<BotBase*> bots;
+	std::vector<Glib::Thread*> threads;
+
+	for (unsigned int j = 0; j < num_jobs; j++)
+	{
+		BotBase *bot = BotBase::new_bot_of_type(_bot_type);
+		BotBase *random_bot = BotBase::new_bot_of_type("random");
+
+		if (!bot)
+			break;
+
+		bot->set_pump_events(false);
+		bot->set_node_limit(_node_limit);
+		bot->set_weights(_weights);
+		bot->set_linear_eval(_linear_eval);
+		random_bot->set_pump_events(false);
+
+		bots.push_back(bot);
+		bots.push_back(random_bot);
+		threads.push_back(Glib::Thread::create(sigc::bind(sigc::mem_fun(
+			*this, &SelfPlay::play_games), bot, random_bot), true));
+	}
+
+	for (unsigned int j = 0; j < threads.size(); j++)
+		threads[j]->join();
+
+	for (unsigned int j = 0; j < bots.size(); j++)
+		delete bots[j];
+
+	_data.close();
+	_index.close();
+
+	return !threads.empty() && !_write_failed;
+}
+
+
+void SelfPlay::play_games(BotBase *bot, BotBase *random_bot)
+{
+	std::vector<unsigned char> records;
+	unsigned int num_games = 0;
+	Glib::Rand rand;
+
+	for (;;)
+	{
+		{
+			Glib::Mutex::Lock lock(_mutex);
+			if (!_games_left)
+				break;
+			_games_left--;
+		}
+
+		play_game(bot, random_bot, &rand, &records);
+		num_games++;
+
+		if (records.size() >= CHUNK_RECORDS * RECORD_SIZE)
+		{
+			write_chunk(&records, num_games);
+			num_games = 0;
+		}
+	}
+
+	if (num_games)
+		write_chunk(&records, num_games);
+}
+
+
+void SelfPlay::play_game(BotBase *bot, BotBase *random_bot, Glib::Rand *rand,
+						 std::vector<unsigned char> *records)
+{
+	GameBoard board(_num_players, _long_jumps, _hop_others, _stop_others);
+	unsigned int places[7] = {0, 0, 0, 0, 0, 0, 0};
+	unsigned int num_finished = 0;
+	unsigned int player = 1;
+	std::vector<unsigned char>::size_type first = records->size();
+
+	// The game is over once only one player is left
+	unsigned int last_place = (_num_players > 1) ? _num_players - 1 : 1;
+
+	for (unsigned int ply = 0; ply < _max_plies && num_finished < last_place;
+		 ply++)
+	{
+		BotBase *mover = (ply < _random_plies) ? random_bot : bot;
+		std::vector<MoveList> best_moves;
+		long best_score = LONG_MIN;
+
+		mover->think(&board, player, &best_moves, &best_score);
+		if (best_moves.empty())
+			break;
+
+		if (mover == bot)
+			add_record(board, player, best_score, ply, records);
+
+		MoveList& move =
+			best_moves[rand->get_int_range(0, best_moves.size())];
+		board.move_peg(move.front(), move.back());
+
+		if (board.player_finished(player) && !places[player])
+			places[player] = ++num_finished;
+
+		player = board.get_next_player(player);
+	}
+
+	if (num_finished == last_place)
+		for (unsigned int p = 1; p <= _num_players; p++)
+			if (!places[p])
+				places[p] = _num_players;
+
+	// Now the outcome is known, fill it in
+	for (std::vector<unsigned char>::size_type r = first;
+		 r < records->size(); r += RECORD_SIZE)
+		(*records)[r + 54] = places[(*records)[r + 1]];
+}
+
+
+void SelfPlay::add_record(const GameBoard& board, unsigned int player,
+						  long score, unsigned int ply,
+						  std::vector<unsigned char> *records)
+{
+	unsigned char record[RECORD_SIZE] = {0};
+
+	if (score > INT_MAX)
+		score = INT_MAX;
+	if (score < -INT_MAX)
+		score = -INT_MAX;
+
+	guint32 packed_score = (guint32)(gint32)score;
+
+	record[0] = board.get_rules_key();
+	record[1] = player;
+	pack_holes(board, record + 2);
+	record[48] = packed_score & 0xff;
+	record[49] = (packed_score >> 8) & 0xff;
+	record[50] = (packed_score >> 16) & 0xff;
+	record[51] = (packed_score >> 24) & 0xff;
+	record[52] = ply & 0xff;
+	record[53] = (ply >> 8) & 0xff;
+
+	records->insert(records->end(), record, record + RECORD_SIZE);
+}
+
+
+void SelfPlay::write_chunk(std::vector<unsigned char> *records,
+						   unsigned int num_games)
+{
+	Glib::Mutex::Lock lock(_mutex);
+
+	unsigned long num_records = records->size() / RECORD_SIZE;
+
+	if (!records->empty())
+		_data.write((const char *)&((*records)[0]), records->size());
+	_index << _offset << " " << num_records << " " << num_games << std::endl;
+
+	if (!_data || !_index)
+		_write_failed = true;
+
+	_offset += records->size();
+	_num_records += num_records;
+	_num_games += num_games;
+
+	records->clear();
+}
+
+
+void SelfPlay::pack_holes(const GameBoard& board, unsigned char *holes)
+{
+	unsigned int bit = 0;
+
+	for (unsigned int i = 0; i < 46; i++)
+		holes[i] = 0;
+
+	for (unsigned int i = 0; i < GameBoard::SIZE; i++)
+		if (board[i])
+		{
+			unsigned int player = board[i]->get_current_player();
+
+			holes[bit / 8] |= (player << (bit % 8)) & 0xff;
+			if (bit % 8 > 5)
+				holes[bit / 8 + 1] |= player >> (8 - bit % 8);
+			bit += 3;
+		}
+}
+
+
+void SelfPlay::unpack_holes(const unsigned char *holes, GameBoard *board)
+{
+	unsigned int bit = 0;
+
+	for (unsigned int i = 0; i < GameBoard::SIZE; i++)
+		if ((*board)[i])
+		{
+			unsigned int player = holes[bit / 8] >> (bit % 8);
+			if (bit % 8 > 5)
+				player |= holes[bit / 8 + 1] << (8 - bit % 8);
+
+			(*board)[i]->set_current_player(player & 7);
+			bit += 3;
+		}
+
+	board->reset_peg_lists();
+}
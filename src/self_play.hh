@@ -0,0 +1,105 @@
+/*
+ *  Plays bots against themselves in several threads at once, writing the
+ *  positions reached to a file of training records.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef INCL_SELF_PLAY_HH
+#define INCL_SELF_PLAY_HH
+
+#include <vector>
+#include <fstream>
+#include <glibmm/ustring.h>
+#include <glibmm/thread.h>
+#include <glibmm/random.h>
+
+#include "game_board.hh"
+#include "eval_weights.hh"
+
+class BotBase;
+class LinearEval;
+
+
+class SelfPlay
+{
+public:
+	// The data file starts with "CHEECHTD", then the format version and
+	// RECORD_SIZE as 4 byte little-endian numbers, then the records:
+	//   0      rules key (see GameBoard::get_rules_key())
+	//   1      player to move
+	//   2-47   each hole in board order, 3 bits each (player or 0)
+	//   48-51  the bot's score for the move it made (signed, little-endian)
+	//   52-53  the move number in the game (little-endian)
+	//   54     the place the player to move finished in, 0 if they didn't
+	//   55     unused
+	// Records are written a chunk of whole games at a time, and each chunk
+	// gets a line in the <file>.idx text file:
+	//   <byte offset> <number of records> <number of games>
+	const static unsigned int FORMAT_VERSION = 1;
+	const static unsigned int HEADER_SIZE = 16;
+	const static unsigned int RECORD_SIZE = 56;
+	const static unsigned int CHUNK_RECORDS = 4096;
+
+	SelfPlay(const Glib::ustring& bot_type, unsigned int num_players,
+			 bool long_jumps, bool hop_others, bool stop_others);
+
+	void set_node_limit(unsigned long nodes);
+	void set_weights(const EvalWeights& weights);
+	void set_linear_eval(const LinearEval *eval);
+	void set_random_plies(unsigned int plies);
+	void set_max_plies(unsigned int plies);
+
+	bool run(const Glib::ustring& filename, unsigned int num_games,
+			 unsigned int num_jobs);
+
+	unsigned long get_num_records() const;
+	unsigned int get_num_games() const;
+
+	static void pack_holes(const GameBoard& board, unsigned char *holes);
+	static void unpack_holes(const unsigned char *holes, GameBoard *board);
+
+private:
+	void play_games(BotBase *bot, BotBase *random_bot);
+	void play_game(BotBase *bot, BotBase *random_bot, Glib::Rand *rand,
+				   std::vector<unsigned char> *records);
+	void add_record(const GameBoard& board, unsigned int player, long score,
+					unsigned int ply, std::vector<unsigned char> *records);
+	void write_chunk(std::vector<unsigned char> *records,
+					 unsigned int num_games);
+
+	Glib::ustring	_bot_type;
+	unsigned int	_num_players;
+	bool			_long_jumps;
+	bool			_hop_others;
+	bool			_stop_others;
+	unsigned long	_node_limit;
+	EvalWeights		_weights;
+	const LinearEval	*_linear_eval;
+	unsigned int	_random_plies;
+	unsigned int	_max_plies;
+
+	Glib::Mutex		_mutex;
+	std::ofstream	_data;
+	std::ofstream	_index;
+	unsigned long	_offset;
+	unsigned int	_games_left;
+	unsigned int	_num_games;
+	unsigned long	_num_records;
+	bool			_write_failed;
+};
+
+#endif   // #ifndef INCL_SELF_PLAY_HH
@@ -0,0 +1,239 @@
+/*
+ *  A run of bytes inside a buffer that belongs to someone else, for
+ *  looking at messages without copying them.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include <cctype>
+#include <climits>
+#include <cstring>
+#include <glib.h>
+
+#include "str_view.hh"
+
+
+StrView::StrView()
+	:_data(""),
+	 _length(0)
+{
+}
+
+
+StrView::StrView(const char *data, unsigned int length)
+	:_data(data),
+	 _length(length)
+{
+}
+
+
+StrView::StrView(const char *text)
+	:_data(text),
+	 _length(strlen(text))
+{
+}
+
+
+StrView::StrView(const std::string& text)
+	:_data(text.data()),
+	 _length(text.length())
+{
+}
+
+
+const char* StrView::data() const
+{
+	return _data;
+}
+
+
+unsigned int StrView::length() const
+{
+	return _length;
+}
+
+
+bool StrView::empty() const
+{
+	return (_length == 0);
+}
+
+
+char StrView::operator[](unsigned int i) const
+{
+	return _data[i];
+}
+
+
+const char* StrView::begin() const
+{
+	return _data;
+}
+
+
+const char* StrView::end() const
+{
+	return _data + _length;
+}
+
+
+std::string StrView::str() const
+{
+	return std::string(_data, _length);
+}
+
+
+StrView StrView::trim() const
+{
+	unsigned int start = 0, stop = _length;
+
+	while (start < stop && isspace((unsigned char)_data[start]))
+		start++;
+	while (stop > start && isspace((unsigned char)_data[stop - 1]))
+		stop--;
+
+	return StrView(_data + start, stop - start);
+}
+
+
+void StrView::split(char c, StrView *head, StrView *tail) const
+{
+	const char *found = (const char*)memchr(_data, c, _length);
+
+	if (!found)
+	{
+		*head = *this;
+		*tail = StrView();
+		return;
+	}
+
+	*head = StrView(_data, found - _data);
+	*tail = StrView(found + 1, end() - found - 1);
+}
+
+
+bool StrView::take_token(StrView *token)
+{
+	unsigned int start = 0;
+	while (start < _length && _data[start] == ' ')
+		start++;
+	if (start == _length)
+		return false;
+
+	StrView rest(_data + start, _length - start);
+	rest.split(' ', token, this);
+	return true;
+}
+
+
+bool StrView::take_uint(unsigned int *value)
+{
+	StrView rest = *this;
+	StrView token;
+
+	if (!rest.take_token(&token) || !token.to_uint(value))
+		return false;
+
+	*this = rest;
+	return true;
+}
+
+
+bool StrView::take_int(int *value)
+{
+	StrView rest = *this;
+	StrView token;
+
+	if (!rest.take_token(&token) || !token.to_int(value))
+		return false;
+
+	*this = rest;
+	return true;
+}
+
+
+bool StrView::to_uint(unsigned int *value) const
+{
+	if (_length == 0)
+		return false;
+
+	unsigned int number = 0;
+	for (unsigned int c = 0; c < _length; c++)
+	{
+		unsigned int digit = (unsigned char)_data[c] - '0';
+
+		if (digit > 9 || number > (UINT_MAX - digit) / 10)
+			return false;
+		number = number * 10 + digit;
+	}
+
+	*value = number;
+	return true;
+}
+
+
+bool StrView::to_int(int *value) const
+{
+	bool negative = (_length > 0 && _data[0] == '-');
+	StrView digits = negative ? StrView(_data + 1, _length - 1) : *this;
+	unsigned int number;
+
+	unsigned int most = negative ? (unsigned int)INT_MAX + 1 : INT_MAX;
+
+	if (!digits.to_uint(&number) || number > most)
+		return false;
+
+	*value = negative ? (int)(0 - number) : (int)number;
+	return true;
+}
+
+
+bool StrView::valid_utf8() const
+{
+	return g_utf8_validate(_data, _length, NULL);
+}
+
+
+int StrView::compare(const StrView& other) const
+{
+	unsigned int common = (_length < other._length) ? _length : other._length;
+	int result = memcmp(_data, other._data, common);
+
+	if (result != 0)
+		return result;
+	if (_length == other._length)
+		return 0;
+	return (_length < other._length) ? -1 : 1;
+}
+
+
+bool StrView::operator==(const StrView& other) const
+{
+	return _length == other._length &&
+		memcmp(_data, other._data, _length) == 0;
+}
+
+
+bool StrView::operator!=(const StrView& other) const
+{
+	return !(*this == other);
+}
+
+
+bool StrView::operator<(const StrView& other) const
+{
+	return compare(other) < 0;
+}
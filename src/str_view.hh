@@ -0,0 +1,84 @@
+/*
+ *  A run of bytes inside a buffer that belongs to someone else, for
+ *  looking at messages without copying them.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef INCL_STR_VIEW_HH
+#define INCL_STR_VIEW_HH
+
+#include <string>
+
+
+// Only as good as the buffer it points into, so it mustn't outlive it.
+// Everything's done in bytes, so a Glib::ustring's raw() can be looked
+// at without its character indexing.
+class StrView
+{
+public:
+	StrView();
+	StrView(const char *data, unsigned int length);
+	StrView(const char *text);
+	StrView(const std::string& text);
+
+	const char* data() const;
+	unsigned int length() const;
+	bool empty() const;
+	char operator[](unsigned int i) const;
+
+	const char* begin() const;
+	const char* end() const;
+
+	// A copy, for keeping
+	std::string str() const;
+
+	// Without any whitespace at either end
+	StrView trim() const;
+
+	// Puts what's before the first c in head and what's after it in tail,
+	// or all of it in head and nothing in tail if there's no c
+	void split(char c, StrView *head, StrView *tail) const;
+
+	// Takes the next argument off the front, skipping any spaces before
+	// it and the one after it, so what's left starts with the argument
+	// after.  False if there are none left.
+	bool take_token(StrView *token);
+	// The same, for a number, leaving everything as it was if the next
+	// argument isn't one
+	bool take_uint(unsigned int *value);
+	bool take_int(int *value);
+
+	// All of it as a number, in decimal with nothing else around it, as
+	// std::from_chars would read it.  False, leaving value alone, if it
+	// isn't one or is too big.
+	bool to_uint(unsigned int *value) const;
+	bool to_int(int *value) const;
+
+	// Only text from users needs checking before it's a Glib::ustring
+	bool valid_utf8() const;
+
+	int compare(const StrView& other) const;
+	bool operator==(const StrView& other) const;
+	bool operator!=(const StrView& other) const;
+	bool operator<(const StrView& other) const;
+
+private:
+	const char		*_data;
+	unsigned int	_length;
+};
+
+#endif   // #ifndef INCL_STR_VIEW_HH
@@ -18,16 +18,181 @@
  *
  */
 
+#include <climits>
+#include <cctype>
 #include <glibmm.h>
 
 #ifdef WIN32
 #include <windows.h>
 #include <shlwapi.h>
+#else
+#include <unistd.h>
 #endif
 
 #include "utility.hh"
 
 
+template <>
+Glib::ustring util::to_str<int>(const int& value)
+{
+	std::string text;
+	append_int(text, value);
+	return text;
+}
+
+
+template <>
+Glib::ustring util::to_str<unsigned int>(const unsigned int& value)
+{
+	std::string text;
+	append_uint(text, value);
+	return text;
+}
+
+
+template <>
+Glib::ustring util::to_str<long>(const long& value)
+{
+	std::string text;
+	append_int(text, value);
+	return text;
+}
+
+
+template <>
+Glib::ustring util::to_str<unsigned long>(const unsigned long& value)
+{
+	std::string text;
+	append_uint(text, value);
+	return text;
+}
+
+
+template <>
+int util::from_str<int>(const Glib::ustring& str)
+{
+	long value;
+	if (!parse_int(str, &value) || value < INT_MIN || value > INT_MAX)
+		return 0;
+	return value;
+}
+
+
+template <>
+unsigned int util::from_str<unsigned int>(const Glib::ustring& str)
+{
+	unsigned long value;
+	if (!parse_uint(str, &value) || value > UINT_MAX)
+		return 0;
+	return value;
+}
+
+
+template <>
+long util::from_str<long>(const Glib::ustring& str)
+{
+	long value;
+	if (!parse_int(str, &value))
+		return 0;
+	return value;
+}
+
+
+void util::append_int(std::string& buffer, long value)
+{
+	if (value < 0)
+	{
+		buffer += '-';
+		// Negated as unsigned, so LONG_MIN comes out right
+		append_uint(buffer, 0UL - (unsigned long)value);
+	}
+	else
+		append_uint(buffer, value);
+}
+
+
+void util::append_uint(std::string& buffer, unsigned long value)
+{
+	char digits[20];
+	unsigned int d = sizeof(digits);
+
+	do
+	{
+		digits[--d] = '0' + value % 10;
+		value /= 10;
+	} while (value);
+
+	buffer.append(digits + d, sizeof(digits) - d);
+}
+
+
+// Finds the digits at the start of str, after any whitespace and sign
+static StrView leading_digits(const Glib::ustring& str, bool *negative)
+{
+	const std::string& raw = str.raw();
+	unsigned int start = 0, end;
+
+	while (start < raw.length() && isspace((unsigned char)raw[start]))
+		start++;
+
+	*negative = (start < raw.length() && raw[start] == '-');
+	if (start < raw.length() && (raw[start] == '-' || raw[start] == '+'))
+		start++;
+
+	for (end = start; end < raw.length() && isdigit((unsigned char)raw[end]);
+		 end++);
+
+	return StrView(raw.data() + start, end - start);
+}
+
+
+bool util::parse_int(const Glib::ustring& str, long *value)
+{
+	bool negative;
+	StrView digits = leading_digits(str, &negative);
+	unsigned long number = 0;
+	unsigned long most = negative ? (unsigned long)LONG_MAX + 1 : LONG_MAX;
+
+	if (digits.empty())
+		return false;
+
+	for (unsigned int c = 0; c < digits.length(); c++)
+	{
+		unsigned long digit = digits[c] - '0';
+
+		if (number > (most - digit) / 10)
+			return false;
+		number = number * 10 + digit;
+	}
+
+	*value = negative ? (long)(0UL - number) : (long)number;
+	return true;
+}
+
+
+bool util::parse_uint(const Glib::ustring& str, unsigned long *value)
+{
+	bool negative;
+	StrView digits = leading_digits(str, &negative);
+	unsigned long number = 0;
+
+	if (digits.empty() || negative)
+		return false;
+
+	for (unsigned int c = 0; c < digits.length(); c++)
+	{
+		unsigned long digit = digits[c] - '0';
+
+		if (number > (ULONG_MAX - digit) / 10)
+			return false;
+		number = number * 10 + digit;
+	}
+
+	*value = number;
+	return true;
+}
+
+
 Glib::ustring& util::ltrim(Glib::ustring& str)
 {
 	if(!str.empty())
@@ -101,6 +266,40 @@ void util::delay_ms(int ms)
 }
 
 
+unsigned int util::get_num_cpus()
+{
+#ifndef WIN32
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+#else
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	long cpus = info.dwNumberOfProcessors;
+#endif
+	return (cpus > 0) ? cpus : 1;
+}
+
+
+Glib::ustring util::to_text(const StrView& text)
+{
+	if (text.valid_utf8())
+		return Glib::ustring(text.begin(), text.end());
+
+	std::string cleaned;
+	const gchar *posn = text.begin();
+	const gchar *bad;
+
+	while (!g_utf8_validate(posn, text.end() - posn, &bad))
+	{
+		cleaned.append(posn, bad);
+		cleaned += '?';
+		posn = bad + 1;
+	}
+	cleaned.append(posn, text.end());
+
+	return cleaned;
+}
+
+
 int util::hex_decode(char hex)
 {
 	if ((hex >= 'A') && (hex <= 'F'))
@@ -24,11 +24,34 @@
 #include <sstream>
 #include <glibmm/ustring.h>
 
+#include "str_view.hh"
+
 
 namespace util {
 	template <typename T> Glib::ustring to_str(const T& value);
 	template <typename T> T from_str(const Glib::ustring& str);
 
+	// Integers, which are in nearly every message, are done by hand rather
+	// than with a stream.  from_str reads the number at the start of str,
+	// after any whitespace, as the stream did, giving 0 if there isn't one.
+	template <> Glib::ustring to_str<int>(const int& value);
+	template <> Glib::ustring to_str<unsigned int>(const unsigned int& value);
+	template <> Glib::ustring to_str<long>(const long& value);
+	template <> Glib::ustring to_str<unsigned long>(const unsigned long& value);
+	template <> int from_str<int>(const Glib::ustring& str);
+	template <> unsigned int from_str<unsigned int>(const Glib::ustring& str);
+	template <> long from_str<long>(const Glib::ustring& str);
+
+	// Adds value's digits to the end of buffer, for building a message up
+	// in one string
+	void append_int(std::string& buffer, long value);
+	void append_uint(std::string& buffer, unsigned long value);
+
+	// The same as from_str, but saying whether there was a number, and
+	// never throwing
+	bool parse_int(const Glib::ustring& str, long *value);
+	bool parse_uint(const Glib::ustring& str, unsigned long *value);
+
 	Glib::ustring& ltrim(Glib::ustring& str);
 	Glib::ustring& rtrim(Glib::ustring& str);
 	Glib::ustring& trim(Glib::ustring& str);
@@ -39,6 +62,11 @@ namespace util {
 	bool odd(unsigned int number);
 
 	void delay_ms(int ms);
+	unsigned int get_num_cpus();
+
+	// Text from the network, for showing, with '?' for anything that
+	// isn't proper UTF-8
+	Glib::ustring to_text(const StrView& text);
 
 	int hex_decode(char hex);
 	Glib::ustring url_decode(Glib::ustring encoded);